@@ -11,6 +11,15 @@
 #include "muduo/protoc/dispatcher.h"
 #include "../common/protocol.pb.h"
 #include "../common/msg.pb.h"
+#include "../common/fast_frame.hpp"
+#include "../common/body_codec.hpp"
+#include "../common/shm_ring.hpp"
+#include "request_pipeline.hpp"
+#include <vector>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <algorithm>
 
 using namespace hz_mq;
 using muduo::net::TcpConnectionPtr;
@@ -23,13 +32,160 @@ ProtobufCodecPtr g_codec;
 ProtobufDispatcher g_dispatcher(std::bind([](const TcpConnectionPtr&, const MessagePtr&, muduo::Timestamp){} , 
                                          std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
 
+// 流水线请求：按数值 rid 关联响应，不经过下面按类型打印的 handler
+request_pipeline g_pipeline([](const google::protobuf::Message& req) {
+    TcpConnectionPtr conn = g_conn;
+    if (!conn || !g_codec) return false;
+    g_codec->send(conn, req);
+    return true;
+});
+
+// 共享内存传输（同机 broker）：附加后二进制帧优先走环，经 std::atomic_load / atomic_store 访问
+// 两个方向的环对象常驻：本端读写位置保存在对象内，不从共享区读回
+struct shm_link {
+    explicit shm_link(shm_region::ptr r)
+        : region(std::move(r)), out(region->ring(SHM_C2S)), in(region->ring(SHM_S2C)) {}
+    shm_region::ptr region;
+    shm_ring        out;   // C2S，受 g_shm_mtx 保护
+    shm_ring        in;    // S2C，仅读线程访问
+};
+std::shared_ptr<shm_link> g_shm;
+std::mutex g_shm_mtx;   // C2S 环的写锁：命令线程发 PUBLISH，读线程回 ACK
+
 void onConnection(const TcpConnectionPtr& conn)
 {
-    if (conn->connected()) g_conn = conn;
-    else                   g_conn.reset();
+    if (conn->connected()) {
+        g_conn = conn;
+    } else {
+        g_conn.reset();
+        g_pipeline.fail_all();
+        // 唤醒阻塞在门铃上的读线程，它发现共享区已换下后退出
+        if (auto shm = std::atomic_exchange(&g_shm, std::shared_ptr<shm_link>())) {
+            shm_region::notify(shm->region->event_fd(SHM_S2C));
+        }
+    }
+}
+// 已协商二进制热路径的 channel：cid → channel 号
+std::mutex g_fast_mtx;
+std::unordered_map<std::string, uint32_t> g_fast_channels;
+
+// open 时协商的网络压缩：cid → codec（客户端不带字典）
+std::unordered_map<std::string, body_codec> g_compression;
+
+body_codec channelCodec(const std::string& cid) {
+    std::lock_guard<std::mutex> lk(g_fast_mtx);
+    auto it = g_compression.find(cid);
+    return it == g_compression.end() ? body_codec{} : it->second;
+}
+
+// 按 content_encoding 还原消息体用于显示
+std::string plainBody(const std::string& cid, const std::string& encoding, const std::string& body) {
+    std::string raw;
+    if (encoding == ENCODING_DEFLATE && channelCodec(cid).decode(body, &raw)) return raw;
+    return body;
+}
+
+uint32_t fastChannel(const std::string& cid) {
+    std::lock_guard<std::mutex> lk(g_fast_mtx);
+    auto it = g_fast_channels.find(cid);
+    return it == g_fast_channels.end() ? 0 : it->second;
+}
+
+// 连接已断开或字段超长无法编码时丢弃并提示，返回 false
+bool sendFast(const fast_frame& f) {
+    std::string frame;
+    if (!encode_fast_frame(f, frame)) {
+        std::cout << "[Fast] frame field too long, dropped opcode="
+                  << static_cast<int>(f.opcode) << " tag=" << f.tag << std::endl;
+        return false;
+    }
+    if (auto shm = std::atomic_load(&g_shm)) {
+        shm_ring& ring = shm->out;
+        if (frame.size() <= ring.max_record()) {
+            // 环满说明 broker 读取跟不上或正处于背压：等它腾出空间再写，保持与已入环帧的顺序。
+            // 等待期间不持写锁（读线程还要回 ACK），退避睡眠而不是空转
+            bool pushed = false;
+            bool broken = false;
+            auto backoff = std::chrono::microseconds(50);
+            while (true) {
+                {
+                    std::lock_guard<std::mutex> lk(g_shm_mtx);
+                    pushed = ring.push(frame);
+                    broken = !pushed && ring.broken();
+                }
+                if (pushed || broken || !g_conn) break;
+                std::this_thread::sleep_for(backoff);
+                backoff = std::min<std::chrono::microseconds>(backoff * 2, std::chrono::milliseconds(5));
+            }
+            if (pushed) {
+                if (ring.reader_sleeping()) shm_region::notify(shm->region->event_fd(SHM_C2S));
+                return true;
+            }
+            if (broken) {
+                std::cout << "[Shm] ring corrupted, falling back to TCP" << std::endl;
+                std::shared_ptr<shm_link> expected = shm;
+                std::atomic_compare_exchange_strong(&g_shm, &expected, std::shared_ptr<shm_link>());
+            }
+        }
+    }
+    TcpConnectionPtr conn = g_conn;
+    if (!conn) {
+        std::cout << "[Fast] connection closed, dropped frame opcode=" << static_cast<int>(f.opcode)
+                  << " tag=" << f.tag << std::endl;
+        return false;
+    }
+    conn->send(frame.data(), static_cast<int>(frame.size()));
+    return true;
+}
+
+void onFastDeliver(const fast_frame& f) {
+    std::cout << "[Message Received] consumer_tag=" << f.name
+              << " delivery_tag=" << f.tag
+              << (f.has(FAST_FLAG_REDELIVERED) ? " (redelivered)" : "")
+              << " body=\"" << (f.has(FAST_FLAG_DEFLATE) ? plainBody("", ENCODING_DEFLATE, std::string(f.body))
+                                                          : std::string(f.body))
+              << "\"" << std::endl;
+    if (g_conn && f.tag != 0) {
+        fast_frame ack;
+        ack.opcode  = fast_op::ACK;
+        ack.channel = f.channel;
+        ack.tag     = f.tag;
+        sendFast(ack);
+    }
 }
+
+// S2C 环的读线程：读空后置空闲标记再阻塞在门铃上，持续投递时不进内核
+void shmReader(std::shared_ptr<shm_link> shm) {
+    shm_ring& ring = shm->in;
+    while (std::atomic_load(&g_shm) == shm) {
+        ring.drain([](const char* data, size_t len) {
+            fast_frame f;
+            if (decode_fast_frame(data, len, &f) == static_cast<long>(len) && f.opcode == fast_op::DELIVER)
+                onFastDeliver(f);
+        });
+        if (ring.broken()) {
+            std::cout << "[Shm] ring corrupted, falling back to TCP" << std::endl;
+            std::shared_ptr<shm_link> expected = shm;
+            std::atomic_compare_exchange_strong(&g_shm, &expected, std::shared_ptr<shm_link>());
+            return;
+        }
+        if (!ring.prepare_sleep()) continue;
+        shm_region::clear(shm->region->event_fd(SHM_S2C));   // 阻塞读
+        ring.wake_up();
+    }
+}
+
 void onMessage(const TcpConnectionPtr& conn, muduo::net::Buffer* buf, muduo::Timestamp ts) {
-    if (g_codec) g_codec->onMessage(conn, buf, ts);
+    // 二进制帧与 protobuf 帧可能交错到达：逐帧按首字节区分
+    while (buf->readableBytes() > 0 && is_fast_frame(buf->peek(), buf->readableBytes())) {
+        fast_frame f;
+        long n = decode_fast_frame(buf->peek(), buf->readableBytes(), &f);
+        if (n == 0) return;
+        if (n < 0) { conn->shutdown(); return; }
+        if (f.opcode == fast_op::DELIVER) onFastDeliver(f);
+        buf->retrieve(static_cast<size_t>(n));
+    }
+    if (g_codec && buf->readableBytes() > 0) g_codec->onMessage(conn, buf, ts);
 }
 
 // Handlers for responses from server
@@ -38,18 +194,91 @@ void onCommonResponse(const TcpConnectionPtr&, const std::shared_ptr<basicCommon
 }
 void onConsumeResponse(const TcpConnectionPtr&, const std::shared_ptr<basicConsumeResponse>& message, muduo::Timestamp) {
     std::cout << "[Message Received] consumer_tag=" << message->consumer_tag()
-              << " body=\"" << message->body() << "\"" << std::endl;
+              << " delivery_tag=" << message->properties().delivery_tag()
+              << (message->properties().redelivered() ? " (redelivered)" : "")
+              << " body=\"" << plainBody(message->cid(), message->properties().content_encoding(), message->body())
+              << "\"" << std::endl;
     // 自动发送ack
-    if (g_conn && g_codec && message->has_properties()) {
+    if (g_conn && g_codec && message->has_properties() && message->properties().delivery_tag() != 0) {
         basicAckRequest ack;
-        ack.set_rid(message->consumer_tag()+"-ack-"+message->properties().id());
+        ack.set_rid(message->consumer_tag() + "-ack-" + std::to_string(message->properties().delivery_tag()));
+        ack.set_cid(message->cid());
+        ack.set_delivery_tag(message->properties().delivery_tag());
+        ack.set_no_response(true);
+        g_codec->send(g_conn, ack);
+    } else if (g_conn && g_codec && message->has_properties()) {
+        basicAckRequest ack;
+        ack.set_rid(message->consumer_tag() + "-ack-" + std::to_string(message->properties().numeric_id()));
         ack.set_cid(message->cid());
         // 这里queue_name需要从业务侧传递，假设consumer_tag即queue_name（如有不同请调整）
         ack.set_queue_name(message->consumer_tag());
+        ack.set_numeric_id(message->properties().numeric_id());
         ack.set_message_id(message->properties().id());
         g_codec->send(g_conn, ack);
     }
 }
+void onDeliverBatch(const TcpConnectionPtr&, const std::shared_ptr<basicDeliverBatch>& message, muduo::Timestamp) {
+    if (message->encoding() == ENCODING_DEFLATE) {
+        // 整帧压缩：解压后 Merge 回原帧
+        std::string raw;
+        if (!channelCodec(message->cid()).decode(message->packed(), &raw, MAX_FRAME_BYTES) || !message->MergeFromString(raw)) {
+            std::cout << "[Batch Received] cannot decode " << message->encoding() << " frame" << std::endl;
+            return;
+        }
+    }
+    std::cout << "[Batch Received] consumer_tag=" << message->consumer_tag()
+              << " count=" << message->messages_size() << std::endl;
+    for (const auto& m : message->messages()) {
+        std::cout << "  delivery_tag=" << m.properties().delivery_tag()
+                  << " body=\"" << m.body() << "\"" << std::endl;
+    }
+    if (!g_conn || !g_codec || message->messages_size() == 0) return;
+
+    // 手动确认：对最后一个投递标签发一次 multiple ack，且不需要响应（auto_ack 无标签，无需确认）
+    uint64_t last_tag = message->messages(message->messages_size() - 1).properties().delivery_tag();
+    if (last_tag == 0) return;
+    basicAckRequest ack;
+    ack.set_rid(message->consumer_tag() + "-ack-" + std::to_string(last_tag));
+    ack.set_cid(message->cid());
+    ack.set_delivery_tag(last_tag);
+    ack.set_multiple(true);
+    ack.set_no_response(true);
+    g_codec->send(g_conn, ack);
+}
+void onConfirm(const TcpConnectionPtr&, const std::shared_ptr<basicConfirm>& message, muduo::Timestamp) {
+    std::cout << "[Confirm] (cid=" << message->cid() << ") "
+              << (message->nack() ? "nack" : "ack") << " delivery_tag="
+              << (message->multiple() ? "<=" : "") << message->delivery_tag() << std::endl;
+}
+void onFastPathResponse(const TcpConnectionPtr&, const std::shared_ptr<fastPathResponse>& message, muduo::Timestamp) {
+    std::cout << "[FastPath] (cid=" << message->cid() << ") OK=" << (message->ok() ? "true" : "false")
+              << " channel_no=" << message->channel_no() << std::endl;
+    if (!message->ok()) return;
+    std::lock_guard<std::mutex> lk(g_fast_mtx);
+    g_fast_channels[message->cid()] = message->channel_no();
+}
+void onShmAttachResponse(const TcpConnectionPtr&, const std::shared_ptr<shmAttachResponse>& message, muduo::Timestamp) {
+    std::cout << "[Shm] (cid=" << message->cid() << ") OK=" << (message->ok() ? "true" : "false")
+              << " channel_no=" << message->channel_no() << " ring_bytes=" << message->ring_bytes() << std::endl;
+    if (!message->ok()) return;
+    if (!message->socket_name().empty()) {
+        // 本连接第一次附加：去 broker 挂出的 Unix socket 取 memfd 与门铃
+        int fds[3] = {-1, -1, -1};
+        shm_region::ptr region;
+        if (shm_collect(message->socket_name(), message->token(), fds))
+            region = shm_region::attach(fds[0], fds[1], fds[2]);
+        if (region) {
+            auto shm = std::make_shared<shm_link>(std::move(region));
+            std::atomic_store(&g_shm, shm);
+            std::thread(shmReader, shm).detach();
+        } else {
+            // broker 只在客户端 attach 后才写环，这里失败时二进制帧仍走 TCP
+            std::cout << "[Shm] fd handoff failed, staying on TCP" << std::endl;
+        }
+    }
+    std::lock_guard<std::mutex> lk(g_fast_mtx);
+    g_fast_channels[message->cid()] = message->channel_no();
+}
 void onQueryResponse(const TcpConnectionPtr&, const std::shared_ptr<basicQueryResponse>& message, muduo::Timestamp) {
     std::string body = message->body();
     if (!body.empty()) {
@@ -58,6 +287,20 @@ void onQueryResponse(const TcpConnectionPtr&, const std::shared_ptr<basicQueryRe
         std::cout << "[Pulled Message] (none available)" << std::endl;
     }
 }
+void onGetResponse(const TcpConnectionPtr&, const std::shared_ptr<basicGetResponse>& message, muduo::Timestamp) {
+    if (!message->ok()) {
+        std::cout << "[Pulled Message] queue not found" << std::endl;
+        return;
+    }
+    if (message->messages_size() == 0) {
+        std::cout << "[Pulled Message] (none available)" << std::endl;
+        return;
+    }
+    for (const auto& m : message->messages()) {
+        std::cout << "[Pulled Message] "
+                  << plainBody(message->cid(), m.properties().content_encoding(), m.body()) << std::endl;
+    }
+}
 
 void onQueueStatusResponse(const TcpConnectionPtr&, const std::shared_ptr<queueStatusResponse>& message, muduo::Timestamp) {
     std::cout << "[Queue Status] exists=" << (message->exists() ? "true" : "false");
@@ -94,17 +337,26 @@ int main(int argc, char* argv[]) {
 
     g_dispatcher.registerMessageCallback<basicCommonResponse>(onCommonResponse);
     g_dispatcher.registerMessageCallback<basicConsumeResponse>(onConsumeResponse);
+    g_dispatcher.registerMessageCallback<basicDeliverBatch>(onDeliverBatch);
+    g_dispatcher.registerMessageCallback<basicConfirm>(onConfirm);
+    g_dispatcher.registerMessageCallback<fastPathResponse>(onFastPathResponse);
+    g_dispatcher.registerMessageCallback<shmAttachResponse>(onShmAttachResponse);
     g_dispatcher.registerMessageCallback<basicQueryResponse>(onQueryResponse);
+    g_dispatcher.registerMessageCallback<basicGetResponse>(onGetResponse);
     g_dispatcher.registerMessageCallback<queueStatusResponse>(onQueueStatusResponse);
     g_dispatcher.registerMessageCallback<heartbeatResponse>(onHeartbeatResponse);
 
     g_codec = std::make_shared<ProtobufCodec>(
-        std::bind(&ProtobufDispatcher::onProtobufMessage, &g_dispatcher,
-                  std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        [](const TcpConnectionPtr& conn, const MessagePtr& msg, muduo::Timestamp ts) {
+            if (!g_pipeline.on_response(msg)) g_dispatcher.onProtobufMessage(conn, msg, ts);
+        });
 
     client.setMessageCallback(onMessage);
     client.connect();
 
+    // 扫描超时未响应的流水线请求，释放窗口并让等待方拿到空响应
+    g_loop->runEvery(1.0, []() { g_pipeline.expire(); });
+
     std::thread hb([&](){
         while (true) {
             std::this_thread::sleep_for(std::chrono::seconds(5));
@@ -119,15 +371,22 @@ int main(int argc, char* argv[]) {
 
     std::cout << "Connected to message queue server at " << host << ":" << port << std::endl;
     std::cout << "Commands:\n"
-              << "open <cid>\n"
+              << "open <cid> [deflate] [min_bytes]\n"
               << "close <cid>\n"
               << "exchange_declare <name> <direct|fanout|topic|headers>\n"
               << "queue_declare <name>\n"
               << "queue_status <cid> <queue>\n"
               << "bind <exch> <queue> <binding_key> [binding_args]\n"
               << "publish <exch> <routing_key> <message> [headers]\n"
-              << "pull <cid>\n"
-              << "consume <cid> <queue> <consumer_tag>\n"
+              << "publish_batch <exch> <routing_key> <count> <message>\n"
+              << "publish_pipelined <exch> <routing_key> <count> <message>\n"
+              << "pull <cid> [queue] [max_count] [wait_ms]\n"
+              << "consume <cid> <queue> <consumer_tag> [prefetch] [batch_count] [linger_ms] [credit]\n"
+              << "credit <cid> <consumer_tag> <messages> [bytes]\n"
+              << "qos <cid> <prefetch_count> [global]\n"
+              << "confirm <cid>\n"
+              << "fast <cid>\n"
+              << "shm <cid> [ring_bytes]\n"
               << "cancel <cid> <consumer_tag> <queue>\n"
               << "exit\n";
 
@@ -143,11 +402,21 @@ int main(int argc, char* argv[]) {
         std::string cmd;
         iss >> cmd;
         if (cmd == "open") {
-            std::string cid;
-            iss >> cid;
+            std::string cid, compression;
+            uint32_t min_bytes = 0;
+            iss >> cid >> compression >> min_bytes;
             openChannelRequest req;
             req.set_rid("cli-open-" + cid);
             req.set_cid(cid);
+            if (compression == ENCODING_DEFLATE) {
+                req.set_compression(compression);
+                req.set_compress_min_bytes(min_bytes);
+                body_codec c;
+                c.enabled = true;
+                if (min_bytes) c.min_bytes = min_bytes;
+                std::lock_guard<std::mutex> lk(g_fast_mtx);
+                g_compression[cid] = c;
+            }
             g_codec->send(g_conn, req);
         } else if (cmd == "close") {
             std::string cid;
@@ -206,6 +475,20 @@ int main(int argc, char* argv[]) {
             iss >> exch >> rkey;
             std::getline(iss, msg);
             if (!msg.empty() && msg[0] == ' ') msg.erase(0, 1);
+            // channel 0 已协商热路径：发二进制 PUBLISH 帧，不带 headers，服务端不回响应；
+            // 交换机名 / 路由键超出帧头长度时改走 protobuf
+            if (uint32_t no = fastChannel("0")) {
+                fast_frame f;
+                f.opcode  = fast_op::PUBLISH;
+                f.channel = no;
+                f.name    = exch;
+                f.key     = rkey;
+                f.body    = msg;
+                if (fast_frame_fits(f)) {
+                    sendFast(f);
+                    continue;
+                }
+            }
             basicPublishRequest req;
             req.set_rid("cli-pub-" + exch);
             req.set_cid("0");
@@ -228,22 +511,155 @@ int main(int argc, char* argv[]) {
                 }
             }
             g_codec->send(g_conn, req);
+        } else if (cmd == "publish_batch") {
+            std::string exch, rkey, msg;
+            size_t count = 0;
+            iss >> exch >> rkey >> count;
+            std::getline(iss, msg);
+            if (!msg.empty() && msg[0] == ' ') msg.erase(0, 1);
+            // 同一条消息重复 count 次，合并为一帧发出
+            basicPublishBatchRequest req;
+            req.set_rid("cli-pubbatch-" + exch);
+            req.set_cid("0");
+            req.set_exchange_name(exch);
+            for (size_t i = 0; i < count; ++i) {
+                publishEntry* e = req.add_entries();
+                e->set_routing_key(rkey);
+                e->set_body(msg);
+                e->mutable_properties()->set_delivery_mode(DeliveryMode::UNDURABLE);
+            }
+            // channel 0 协商了压缩：整批压缩后放入 packed
+            body_codec zc = channelCodec("0");
+            if (zc.enabled) {
+                basicPublishBatchRequest entries_only;
+                entries_only.mutable_entries()->Swap(req.mutable_entries());
+                std::string packed;
+                if (zc.encode(entries_only.SerializeAsString(), &packed)) {
+                    req.set_encoding(ENCODING_DEFLATE);
+                    req.set_packed(std::move(packed));
+                } else {
+                    req.mutable_entries()->Swap(entries_only.mutable_entries());
+                }
+            }
+            g_codec->send(g_conn, req);
+        } else if (cmd == "publish_pipelined") {
+            std::string exch, rkey, msg;
+            size_t count = 0;
+            iss >> exch >> rkey >> count;
+            std::getline(iss, msg);
+            if (!msg.empty() && msg[0] == ' ') msg.erase(0, 1);
+            // 逐条发布但不等响应：窗口内的请求同时在途，最后统一收集结果
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::future<response_ptr>> results;
+            results.reserve(count);
+            for (size_t i = 0; i < count; ++i) {
+                basicPublishRequest req;
+                req.set_cid("0");
+                req.set_exchange_name(exch);
+                req.set_body(msg);
+                BasicProperties* props = req.mutable_properties();
+                props->set_routing_key(rkey);
+                props->set_delivery_mode(DeliveryMode::UNDURABLE);
+                results.push_back(g_pipeline.call(req));
+            }
+            size_t ok = 0;
+            for (auto& f : results) {
+                auto resp = std::dynamic_pointer_cast<basicCommonResponse>(f.get());
+                if (resp && resp->ok()) ++ok;
+            }
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::steady_clock::now() - start).count();
+            std::cout << "[Pipelined] " << ok << "/" << count << " published in " << ms << " ms" << std::endl;
         } else if (cmd == "pull") {
-            std::string cid;
-            iss >> cid;
-            basicQueryRequest req;
-            req.set_rid("cli-query-" + cid);
+            std::string cid, qname;
+            uint32_t max_count = 1, wait_ms = 0;
+            iss >> cid >> qname >> max_count >> wait_ms;
+            if (qname.empty()) {
+                basicQueryRequest req;
+                req.set_rid("cli-query-" + cid);
+                req.set_cid(cid);
+                g_codec->send(g_conn, req);
+                continue;
+            }
+            // 指定队列：批量拉取，队列为空时由服务端挂起至多 wait_ms
+            basicGetRequest req;
+            req.set_rid("cli-get-" + cid);
             req.set_cid(cid);
+            req.set_queue_name(qname);
+            req.set_max_count(max_count);
+            req.set_max_wait_ms(wait_ms);
+            req.set_auto_ack(true);
             g_codec->send(g_conn, req);
         } else if (cmd == "consume") {
             std::string cid, qname, tag;
-            iss >> cid >> qname >> tag;
+            uint32_t prefetch = 0, batch = 0, linger = 0, credit = 0;
+            iss >> cid >> qname >> tag >> prefetch >> batch >> linger >> credit;
             basicConsumeRequest req;
             req.set_rid("cli-consume-" + cid);
             req.set_cid(cid);
             req.set_queue_name(qname);
             req.set_consumer_tag(tag);
-            req.set_auto_ack(true);
+            // 指定预取数时使用手动确认，收到消息后由 onConsumeResponse 回 ack
+            req.set_auto_ack(prefetch == 0);
+            req.set_prefetch_count(prefetch);
+            req.set_batch_max_count(batch);
+            req.set_batch_linger_ms(linger);
+            // 指定 credit 时开启信用模式，并先授予 credit 条额度
+            req.set_credit_flow(credit > 0);
+            g_codec->send(g_conn, req);
+            if (credit > 0) {
+                basicCreditRequest grant;
+                grant.set_rid("cli-credit-" + tag);
+                grant.set_cid(cid);
+                grant.set_consumer_tag(tag);
+                grant.set_message_credit(credit);
+                grant.set_no_response(true);
+                g_codec->send(g_conn, grant);
+            }
+        } else if (cmd == "credit") {
+            std::string cid, tag;
+            uint32_t msgs = 0;
+            uint64_t bytes = 0;
+            iss >> cid >> tag >> msgs >> bytes;
+            basicCreditRequest req;
+            req.set_rid("cli-credit-" + tag);
+            req.set_cid(cid);
+            req.set_consumer_tag(tag);
+            req.set_message_credit(msgs);
+            req.set_byte_credit(bytes);
+            g_codec->send(g_conn, req);
+        } else if (cmd == "confirm") {
+            std::string cid;
+            iss >> cid;
+            confirmSelectRequest req;
+            req.set_rid("cli-confirm-" + cid);
+            req.set_cid(cid);
+            g_codec->send(g_conn, req);
+        } else if (cmd == "fast") {
+            std::string cid;
+            iss >> cid;
+            fastPathRequest req;
+            req.set_rid("cli-fast-" + cid);
+            req.set_cid(cid);
+            g_codec->send(g_conn, req);
+        } else if (cmd == "shm") {
+            std::string cid;
+            uint32_t ring_bytes = 0;
+            iss >> cid >> ring_bytes;
+            shmAttachRequest req;
+            req.set_rid("cli-shm-" + cid);
+            req.set_cid(cid);
+            req.set_ring_bytes(ring_bytes);
+            g_codec->send(g_conn, req);
+        } else if (cmd == "qos") {
+            std::string cid, scope;
+            uint32_t prefetch = 0;
+            iss >> cid >> prefetch >> scope;
+            basicQosRequest req;
+            req.set_rid("cli-qos-" + cid);
+            req.set_cid(cid);
+            req.set_prefetch_count(prefetch);
+            req.set_global(scope == "global");
             g_codec->send(g_conn, req);
         } else if (cmd == "cancel") {
             std::string cid, tag, qname;
@@ -0,0 +1,146 @@
+// ======================= request_pipeline.cpp =======================
+#include "request_pipeline.hpp"
+
+#include <charconv>
+#include <vector>
+
+#include <google/protobuf/descriptor.h>
+
+namespace hz_mq {
+
+namespace {
+
+// rid 字段按名字反射查找：所有请求 / 响应都以 string rid 作为关联字段
+const google::protobuf::FieldDescriptor* rid_field(const google::protobuf::Message& msg)
+{
+    const auto* f = msg.GetDescriptor()->FindFieldByName("rid");
+    if (!f || f->is_repeated() || f->cpp_type() != google::protobuf::FieldDescriptor::CPPTYPE_STRING)
+        return nullptr;
+    return f;
+}
+
+} // namespace
+
+request_pipeline::request_pipeline(send_fn send, size_t max_outstanding,
+                                   std::chrono::milliseconds timeout)
+    : __send(std::move(send)), __window(max_outstanding ? max_outstanding : 1), __timeout(timeout)
+{
+}
+
+bool request_pipeline::parse_rid(const std::string& rid, uint64_t* id)
+{
+    if (rid.empty()) return false;
+    const char* end = rid.data() + rid.size();
+    auto [ptr, ec] = std::from_chars(rid.data(), end, *id);
+    return ec == std::errc() && ptr == end && *id != 0;
+}
+
+uint64_t request_pipeline::submit(google::protobuf::Message& req, callback cb)
+{
+    const auto* f = rid_field(req);
+    if (!f) return 0;
+
+    uint64_t rid;
+    {
+        std::unique_lock<std::mutex> lk(__mtx);
+        __cv.wait(lk, [this] { return __pending.size() < __window; });
+        rid = ++__next_rid;
+        // 先登记再发送：响应可能在 send 返回前就到达
+        __pending.emplace(rid, pending{std::move(cb), std::chrono::steady_clock::now() + __timeout});
+    }
+    req.GetReflection()->SetString(&req, f, std::to_string(rid));
+
+    if (!__send(req)) {
+        callback failed;
+        {
+            std::lock_guard<std::mutex> lk(__mtx);
+            auto it = __pending.find(rid);
+            if (it != __pending.end()) {
+                failed = std::move(it->second.cb);
+                __pending.erase(it);
+            }
+        }
+        __cv.notify_one();
+        if (failed) failed(nullptr);
+        return 0;
+    }
+    return rid;
+}
+
+std::future<response_ptr> request_pipeline::call(google::protobuf::Message& req)
+{
+    auto promise = std::make_shared<std::promise<response_ptr>>();
+    std::future<response_ptr> fut = promise->get_future();
+    if (!rid_field(req)) {
+        promise->set_value(nullptr);   // 没有 rid 字段：不会有回调
+        return fut;
+    }
+    submit(req, [promise](const response_ptr& resp) { promise->set_value(resp); });
+    return fut;
+}
+
+bool request_pipeline::on_response(const response_ptr& resp)
+{
+    if (!resp) return false;
+    const auto* f = rid_field(*resp);
+    if (!f) return false;
+
+    uint64_t rid = 0;
+    if (!parse_rid(resp->GetReflection()->GetString(*resp, f), &rid)) return false;
+
+    callback cb;
+    {
+        std::lock_guard<std::mutex> lk(__mtx);
+        auto it = __pending.find(rid);
+        if (it == __pending.end()) return false;
+        cb = std::move(it->second.cb);
+        __pending.erase(it);
+    }
+    __cv.notify_one();
+    if (cb) cb(resp);
+    return true;
+}
+
+void request_pipeline::fail_all()
+{
+    std::unordered_map<uint64_t, pending> failed;
+    {
+        std::lock_guard<std::mutex> lk(__mtx);
+        failed.swap(__pending);
+    }
+    __cv.notify_all();
+    for (auto& [_, p] : failed) {
+        if (p.cb) p.cb(nullptr);
+    }
+}
+
+size_t request_pipeline::expire(std::chrono::steady_clock::time_point now)
+{
+    // 回调在锁外执行：回调里可能再次 submit
+    std::vector<callback> expired;
+    {
+        std::lock_guard<std::mutex> lk(__mtx);
+        for (auto it = __pending.begin(); it != __pending.end();) {
+            if (it->second.deadline <= now) {
+                expired.push_back(std::move(it->second.cb));
+                it = __pending.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    if (expired.empty()) return 0;
+    __cv.notify_all();
+    for (auto& cb : expired) {
+        if (cb) cb(nullptr);
+    }
+    return expired.size();
+}
+
+size_t request_pipeline::outstanding() const
+{
+    std::lock_guard<std::mutex> lk(__mtx);
+    return __pending.size();
+}
+
+} // namespace hz_mq
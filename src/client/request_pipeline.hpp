@@ -0,0 +1,74 @@
+// ======================= request_pipeline.hpp =======================
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <google/protobuf/message.h>
+
+namespace hz_mq {
+
+using response_ptr = std::shared_ptr<google::protobuf::Message>;
+
+// 单连接上允许的未完成请求数；到达上限时 submit 阻塞
+inline constexpr size_t DEFAULT_PIPELINE_WINDOW = 1024;
+// 请求发出后等待响应的时限，超时以空响应完成并释放窗口
+inline constexpr std::chrono::milliseconds DEFAULT_PIPELINE_TIMEOUT{30000};
+
+// -----------------------------------------------------------------
+// 客户端请求流水线：同一连接上可同时挂多个未完成请求，按 rid 关联乱序到达的响应
+//   · submit 为请求分配数值 rid（十进制写入 rid 字段）并登记回调，不等响应即返回
+//   · 收到的帧先交给 on_response：rid 匹配到未完成请求则回调，否则返回 false
+//     由调用方继续分发（投递、heartbeat、旧格式 rid 等）
+//   · 连接断开时 fail_all，所有未完成请求以空响应完成
+//   · 每个请求带截止时间，由调用方定期 expire（客户端在 EventLoop 上定时扫描）；
+//     超时请求以空响应完成，之后迟到的响应不再匹配
+// submit / call 在窗口满时会阻塞等待响应，不能在收响应的 EventLoop 线程中调用
+// -----------------------------------------------------------------
+class request_pipeline {
+public:
+    using send_fn  = std::function<bool(const google::protobuf::Message&)>;   // 未连接时返回 false
+    using callback = std::function<void(const response_ptr&)>;                // 失败时参数为空
+
+    explicit request_pipeline(send_fn send, size_t max_outstanding = DEFAULT_PIPELINE_WINDOW,
+                              std::chrono::milliseconds timeout = DEFAULT_PIPELINE_TIMEOUT);
+
+    // 返回分配的 rid；请求类型没有 string rid 字段时返回 0 且不发送；
+    // 发送失败时回调以空响应完成并返回 0
+    uint64_t submit(google::protobuf::Message& req, callback cb);
+    // submit 的 future 形式
+    std::future<response_ptr> call(google::protobuf::Message& req);
+
+    bool   on_response(const response_ptr& resp);
+    void   fail_all();
+    // 截止时间早于 now 的请求以空响应完成，返回完成的个数
+    size_t expire(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+    size_t outstanding() const;
+
+    // 只接受完整的十进制数；非流水线请求的 rid（如 "hb"、"cli-open-c1"）返回 false
+    static bool parse_rid(const std::string& rid, uint64_t* id);
+
+private:
+    struct pending {
+        callback                              cb;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    send_fn                               __send;
+    size_t                                __window;
+    std::chrono::milliseconds             __timeout;
+    mutable std::mutex                    __mtx;
+    std::condition_variable               __cv;
+    uint64_t                              __next_rid{0};
+    std::unordered_map<uint64_t, pending> __pending;
+};
+
+} // namespace hz_mq
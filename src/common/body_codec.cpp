@@ -0,0 +1,95 @@
+// ======================= body_codec.cpp =======================
+#include "body_codec.hpp"
+
+#include <stdexcept>
+
+#include <zlib.h>
+
+namespace hz_mq {
+
+bool body_codec::encode(std::string_view in, std::string* out) const
+{
+    if (!enabled || in.size() < min_bytes) return false;
+
+    z_stream zs{};
+    if (deflateInit(&zs, Z_DEFAULT_COMPRESSION) != Z_OK) return false;
+    if (!dict.empty() &&
+        deflateSetDictionary(&zs, reinterpret_cast<const Bytef*>(dict.data()),
+                             static_cast<uInt>(dict.size())) != Z_OK) {
+        deflateEnd(&zs);
+        return false;
+    }
+
+    std::string buf(deflateBound(&zs, static_cast<uLong>(in.size())), '\0');
+    zs.next_in   = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    zs.avail_in  = static_cast<uInt>(in.size());
+    zs.next_out  = reinterpret_cast<Bytef*>(&buf[0]);
+    zs.avail_out = static_cast<uInt>(buf.size());
+    int rc = ::deflate(&zs, Z_FINISH);
+    size_t n = zs.total_out;
+    deflateEnd(&zs);
+
+    if (rc != Z_STREAM_END || n >= in.size()) return false;   // 不可压缩：保持原样
+    buf.resize(n);
+    *out = std::move(buf);
+    return true;
+}
+
+bool body_codec::decode(std::string_view in, std::string* out, size_t max_out) const
+{
+    z_stream zs{};
+    if (inflateInit(&zs) != Z_OK) return false;
+    zs.next_in  = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    zs.avail_in = static_cast<uInt>(in.size());
+
+    std::string result;
+    char chunk[16 * 1024];
+    int rc = Z_OK;
+    while (rc != Z_STREAM_END) {
+        zs.next_out  = reinterpret_cast<Bytef*>(chunk);
+        zs.avail_out = sizeof(chunk);
+        rc = ::inflate(&zs, Z_NO_FLUSH);
+        if (rc == Z_NEED_DICT) {
+            if (dict.empty() ||
+                inflateSetDictionary(&zs, reinterpret_cast<const Bytef*>(dict.data()),
+                                     static_cast<uInt>(dict.size())) != Z_OK)
+                break;
+            rc = Z_OK;
+            continue;
+        }
+        if (rc != Z_OK && rc != Z_STREAM_END) break;
+        result.append(chunk, sizeof(chunk) - zs.avail_out);
+        if (result.size() > max_out) {   // 解压炸弹：到上限立即放弃
+            rc = Z_DATA_ERROR;
+            break;
+        }
+        if (rc == Z_OK && zs.avail_in == 0 && zs.avail_out != 0) break;   // 输入被截断
+    }
+    inflateEnd(&zs);
+
+    if (rc != Z_STREAM_END) return false;
+    *out = std::move(result);
+    return true;
+}
+
+body_codec body_codec::from_args(const std::unordered_map<std::string, std::string>& args)
+{
+    body_codec c;
+    auto it = args.find("x-compress");
+    c.enabled = it != args.end() && it->second == ENCODING_DEFLATE;
+
+    it = args.find("x-compress-min-bytes");
+    if (it != args.end()) {
+        try {
+            c.min_bytes = std::stoul(it->second);
+        } catch (const std::exception&) {
+            // 非法值：沿用默认阈值
+        }
+    }
+
+    it = args.find("x-compress-dict");
+    if (it != args.end()) c.dict = it->second;
+    return c;
+}
+
+} // namespace hz_mq
@@ -0,0 +1,39 @@
+// ======================= body_codec.hpp =======================
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace hz_mq {
+
+// -----------------------------------------------------------------
+// 消息体压缩（zlib deflate，可带预置字典）
+//   · 队列参数 x-compress=deflate 开启落盘压缩，
+//     x-compress-min-bytes 为阈值，x-compress-dict 为该队列的预置字典
+//   · channel 在 openChannelRequest 中协商网络压缩，作用于单条投递（content_encoding）
+//     与批量投递帧；批量发布帧由客户端自行压缩，服务端按 encoding 字段解压
+//   · 字典 id（adler32）写在 zlib 头里，解压时字典不匹配直接失败
+// -----------------------------------------------------------------
+inline constexpr const char* ENCODING_DEFLATE    = "deflate";
+inline constexpr size_t      COMPRESS_MIN_BYTES  = 256;   // 过小的消息体压缩收益抵不过开销
+// 解压输出上限：压缩数据来自客户端或磁盘，不设上限时几 KB 的输入就能解出数 GB
+inline constexpr size_t      MAX_FRAME_BYTES     = 64 * 1024 * 1024;   // 批量帧，与 ProtobufCodec 帧上限一致
+inline constexpr size_t      MAX_BODY_BYTES      = 64 * 1024 * 1024;   // 单条消息体，与 FAST_MAX_BODY 一致
+
+struct body_codec {
+    bool        enabled{false};
+    size_t      min_bytes{COMPRESS_MIN_BYTES};
+    std::string dict;
+
+    // 达到阈值且压缩后确实变小时写入 out 并返回 true；否则不压缩
+    bool encode(std::string_view in, std::string* out) const;
+    // 解压 encode 的输出；数据损坏、字典不匹配或解出超过 max_out 字节返回 false
+    bool decode(std::string_view in, std::string* out, size_t max_out = MAX_BODY_BYTES) const;
+
+    // 按队列参数构造：x-compress / x-compress-min-bytes / x-compress-dict
+    static body_codec from_args(const std::unordered_map<std::string, std::string>& args);
+};
+
+} // namespace hz_mq
@@ -0,0 +1,91 @@
+// ======================= fast_frame.cpp =======================
+#include "fast_frame.hpp"
+
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <endian.h>
+
+namespace hz_mq {
+
+namespace {
+
+void put16(char*& p, uint16_t v) { v = htons(v);   std::memcpy(p, &v, 2); p += 2; }
+void put32(char*& p, uint32_t v) { v = htonl(v);   std::memcpy(p, &v, 4); p += 4; }
+void put64(char*& p, uint64_t v) { v = htobe64(v); std::memcpy(p, &v, 8); p += 8; }
+
+uint16_t get16(const char*& p) { uint16_t v; std::memcpy(&v, p, 2); p += 2; return ntohs(v); }
+uint32_t get32(const char*& p) { uint32_t v; std::memcpy(&v, p, 4); p += 4; return ntohl(v); }
+uint64_t get64(const char*& p) { uint64_t v; std::memcpy(&v, p, 8); p += 8; return be64toh(v); }
+
+} // namespace
+
+bool fast_frame_fits(const fast_frame& f)
+{
+    return f.name.size() <= FAST_MAX_FIELD && f.key.size() <= FAST_MAX_FIELD &&
+           f.id.size() <= FAST_MAX_FIELD && f.body.size() <= FAST_MAX_BODY;
+}
+
+bool encode_fast_header(const fast_frame& f, std::string& out)
+{
+    // 截断成 16 位会让对端按错误的长度切分，后面的帧全部错位
+    if (!fast_frame_fits(f)) return false;
+    size_t start = out.size();
+    out.resize(start + FAST_HEADER_LEN);
+    char* p = &out[start];
+    *p++ = static_cast<char>(FAST_MAGIC);
+    *p++ = static_cast<char>(f.opcode);
+    put16(p, f.flags);
+    put32(p, f.channel);
+    put64(p, f.tag);
+    put16(p, static_cast<uint16_t>(f.name.size()));
+    put16(p, static_cast<uint16_t>(f.key.size()));
+    put16(p, static_cast<uint16_t>(f.id.size()));
+    put16(p, 0);
+    put32(p, static_cast<uint32_t>(f.body.size()));
+
+    out.append(f.name).append(f.key).append(f.id);
+    return true;
+}
+
+bool encode_fast_frame(const fast_frame& f, std::string& out)
+{
+    if (!encode_fast_header(f, out)) return false;
+    out.append(f.body);
+    return true;
+}
+
+long decode_fast_frame(const char* data, size_t len, fast_frame* out)
+{
+    if (len < FAST_HEADER_LEN) return 0;
+    if (static_cast<uint8_t>(data[0]) != FAST_MAGIC) return -1;
+
+    const char* p = data + 1;
+    uint8_t op = static_cast<uint8_t>(*p++);
+    if (op < static_cast<uint8_t>(fast_op::PUBLISH) || op > static_cast<uint8_t>(fast_op::ACK))
+        return -1;
+
+    fast_frame f;
+    f.opcode  = static_cast<fast_op>(op);
+    f.flags   = get16(p);
+    f.channel = get32(p);
+    f.tag     = get64(p);
+    uint16_t name_len = get16(p);
+    uint16_t key_len  = get16(p);
+    uint16_t id_len   = get16(p);
+    get16(p);   // reserved
+    uint32_t body_len = get32(p);
+    if (body_len > FAST_MAX_BODY) return -1;
+
+    size_t total = FAST_HEADER_LEN + name_len + key_len + id_len + size_t(body_len);
+    if (len < total) return 0;
+
+    f.name = std::string_view(p, name_len); p += name_len;
+    f.key  = std::string_view(p, key_len);  p += key_len;
+    f.id   = std::string_view(p, id_len);   p += id_len;
+    f.body = std::string_view(p, body_len);
+    *out = f;
+    return static_cast<long>(total);
+}
+
+} // namespace hz_mq
@@ -0,0 +1,71 @@
+// ======================= fast_frame.hpp =======================
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace hz_mq {
+
+// -----------------------------------------------------------------
+// 热路径二进制帧：publish / deliver / ack 不走 ProtobufCodec，
+// 省去类型名字符串、adler32 校验与按类型名反射分发。
+// 需先用 fastPathRequest 在 channel 上协商，得到数字 channel 号；
+// 控制帧（声明、绑定、订阅、确认模式等）仍走 protobuf。
+//
+// 帧头固定 FAST_HEADER_LEN 字节，多字节字段均为网络字节序：
+//   magic(1) opcode(1) flags(2) channel(4) tag(8)
+//   name_len(2) key_len(2) id_len(2) reserved(2) body_len(4)
+// 之后依次为 name / key / id / body 原始字节。
+//
+// ProtobufCodec 帧以长度字段开头，首字节 <= 0x04（上限 64 MB），
+// 因此首字节 FAST_MAGIC 足以区分两种帧，可在同一连接上混用。
+// -----------------------------------------------------------------
+inline constexpr uint8_t  FAST_MAGIC      = 0xFB;
+inline constexpr size_t   FAST_HEADER_LEN = 28;
+inline constexpr uint32_t FAST_MAX_BODY   = 64 * 1024 * 1024;
+inline constexpr size_t   FAST_MAX_FIELD  = 0xFFFF;   // name / key / id 的长度字段只有 16 位
+
+enum class fast_op : uint8_t {
+    PUBLISH = 1,   // name = exchange, key = routing key, id = 客户端自带的字符串 id（可空）
+    DELIVER = 2,   // name = consumer tag, key = routing key, id = 同上, tag = delivery tag
+    ACK     = 3,   // tag = delivery tag
+};
+
+// flags
+inline constexpr uint16_t FAST_FLAG_DURABLE     = 0x0001;   // PUBLISH / DELIVER
+inline constexpr uint16_t FAST_FLAG_REDELIVERED = 0x0002;   // DELIVER
+inline constexpr uint16_t FAST_FLAG_MULTIPLE    = 0x0004;   // ACK
+inline constexpr uint16_t FAST_FLAG_DEFLATE     = 0x0008;   // PUBLISH / DELIVER：body 为 deflate 压缩
+
+// 解码结果中的字符串均指向输入缓冲区，仅在回调期间有效
+struct fast_frame {
+    fast_op          opcode{fast_op::ACK};
+    uint16_t         flags{0};
+    uint32_t         channel{0};
+    uint64_t         tag{0};
+    std::string_view name;
+    std::string_view key;
+    std::string_view id;
+    std::string_view body;
+
+    bool has(uint16_t flag) const { return (flags & flag) != 0; }
+};
+
+// name / key / id / body 都在帧头可表示的范围内；超出时调用方改走 protobuf
+bool fast_frame_fits(const fast_frame& f);
+// 追加编码一帧到 out；字段超长时不写入并返回 false
+bool encode_fast_frame(const fast_frame& f, std::string& out);
+// 只编码帧头与 name / key / id（body_len 仍按 f.body 填写），消息体由调用方紧随其后单独发送
+bool encode_fast_header(const fast_frame& f, std::string& out);
+
+// 从 data 开头解码一帧：返回整帧长度；数据不足返回 0；帧非法返回 -1
+long decode_fast_frame(const char* data, size_t len, fast_frame* out);
+
+inline bool is_fast_frame(const char* data, size_t len)
+{
+    return len > 0 && static_cast<uint8_t>(data[0]) == FAST_MAGIC;
+}
+
+} // namespace hz_mq
@@ -0,0 +1,94 @@
+// ======================= mpsc_ring.hpp =======================
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+
+namespace hz_mq {
+
+// -----------------------------------------------------------------
+// mpsc_ring : 有界无锁多生产者 / 单消费者环形队列
+//   · 生产者：一次 CAS 抢占槽位，写入后以 release 发布序号
+//   · 消费者：同一时刻只允许一个线程 drain（由调用方保证，如持有队列锁）
+//   · 满时 try_push 返回 false，由调用方决定回退策略
+// -----------------------------------------------------------------
+template <typename T>
+class mpsc_ring {
+public:
+    explicit mpsc_ring(size_t capacity)
+    {
+        size_t cap = 2;
+        while (cap < capacity) cap <<= 1;
+        __mask  = cap - 1;
+        __cells = std::make_unique<cell[]>(cap);
+        for (size_t i = 0; i < cap; ++i)
+            __cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    mpsc_ring(const mpsc_ring&) = delete;
+    mpsc_ring& operator=(const mpsc_ring&) = delete;
+
+    bool try_push(T&& value)
+    {
+        size_t pos = __tail.load(std::memory_order_relaxed);
+        cell* c = nullptr;
+        while (true) {
+            c = &__cells[pos & __mask];
+            size_t seq = c->seq.load(std::memory_order_acquire);
+            intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (dif == 0) {
+                if (__tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0) {
+                return false;                       // 已满
+            } else {
+                pos = __tail.load(std::memory_order_relaxed);
+            }
+        }
+        c->value = std::move(value);
+        c->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 批量取出至多 max 个元素，按入队顺序交给 fn；返回取出个数
+    template <typename F>
+    size_t drain(F&& fn, size_t max = std::numeric_limits<size_t>::max())
+    {
+        size_t n = 0;
+        while (n < max) {
+            cell& c = __cells[__head & __mask];
+            if (c.seq.load(std::memory_order_acquire) != __head + 1) break;   // 空或生产者尚未写完
+            fn(std::move(c.value));
+            c.value = T{};
+            c.seq.store(__head + __mask + 1, std::memory_order_release);
+            ++__head;
+            ++n;
+        }
+        return n;
+    }
+
+    bool empty() const
+    {
+        const cell& c = __cells[__head & __mask];
+        return c.seq.load(std::memory_order_acquire) != __head + 1;
+    }
+
+    size_t capacity() const { return __mask + 1; }
+
+private:
+    struct cell {
+        std::atomic<size_t> seq{0};
+        T value{};
+    };
+
+    std::unique_ptr<cell[]>          __cells;
+    size_t                           __mask{0};
+    alignas(64) std::atomic<size_t>  __tail{0};   // 生产者竞争
+    alignas(64) size_t               __head{0};   // 仅消费者访问
+};
+
+} // namespace hz_mq
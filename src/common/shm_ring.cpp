@@ -0,0 +1,327 @@
+// ======================= shm_ring.cpp =======================
+#include "shm_ring.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <random>
+#include <thread>
+
+namespace hz_mq {
+
+namespace {
+
+constexpr size_t HEADER_BYTES = 4096;   // 控制页
+constexpr size_t TOKEN_BYTES  = 16;
+
+struct shm_header {
+    uint32_t     magic;
+    uint32_t     version;
+    uint64_t     ring_bytes;
+    std::atomic<uint32_t> attached;   // 客户端 attach 成功后置 1
+    shm_ring_ctl rings[2];
+};
+static_assert(sizeof(shm_header) <= HEADER_BYTES, "shm header must fit in the control page");
+
+size_t round_ring(size_t bytes)
+{
+    if (bytes < SHM_MIN_RING) bytes = SHM_MIN_RING;
+    if (bytes > SHM_MAX_RING) bytes = SHM_MAX_RING;
+    return (bytes + HEADER_BYTES - 1) / HEADER_BYTES * HEADER_BYTES;
+}
+
+void close_fd(int& fd)
+{
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+}
+
+socklen_t abstract_addr(const std::string& name, sockaddr_un* addr)
+{
+    std::memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    size_t n = std::min(name.size(), sizeof(addr->sun_path) - 1);
+    std::memcpy(addr->sun_path + 1, name.data(), n);   // sun_path[0] = '\0'：抽象命名空间
+    return static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + n);
+}
+
+bool read_full(int fd, char* buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = ::read(fd, buf, len);
+        if (n <= 0) return false;
+        buf += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// shm_ring
+// ---------------------------------------------------------------------------
+bool shm_ring::push(std::string_view a, std::string_view b)
+{
+    size_t len = a.size() + b.size();
+    if (__broken || len > max_record()) return false;
+    uint64_t need = (sizeof(uint32_t) + len + 7) & ~uint64_t(7);
+
+    // 对端的 head 只用来算剩余空间：必须对齐、不回退、不超过本端已发布的 tail
+    uint64_t head = __ctl->head.load(std::memory_order_acquire);
+    if ((head & 7) != 0 || head < __peer || head > __own) {
+        __broken = true;
+        return false;
+    }
+    __peer = head;
+
+    uint64_t tail = __own;
+    uint64_t pos  = tail % __cap;
+    uint64_t skip = (__cap - pos < need) ? __cap - pos : 0;   // 放不下就整段跳到环首
+    if (__cap - (tail - head) < skip + need) return false;
+
+    if (skip) {
+        std::memcpy(__data + pos, &SHM_WRAP, sizeof(SHM_WRAP));
+        tail += skip;
+        pos = 0;
+    }
+    uint32_t len32 = static_cast<uint32_t>(len);
+    char* p = __data + pos;
+    std::memcpy(p, &len32, sizeof(len32));
+    std::memcpy(p + sizeof(len32), a.data(), a.size());
+    if (!b.empty()) std::memcpy(p + sizeof(len32) + a.size(), b.data(), b.size());
+    __own = tail + need;
+    __ctl->tail.store(__own, std::memory_order_release);
+    return true;
+}
+
+bool shm_ring::empty() const
+{
+    return __ctl->tail.load(std::memory_order_acquire) == __own;
+}
+
+bool shm_ring::reader_sleeping() const
+{
+    // 与 prepare_sleep 配对的全屏障：要么读端看到新 tail，要么写端看到空闲标记
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return __ctl->reader_idle.load(std::memory_order_relaxed) != 0;
+}
+
+bool shm_ring::prepare_sleep()
+{
+    __ctl->reader_idle.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!empty()) {
+        __ctl->reader_idle.store(0, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// shm_region
+// ---------------------------------------------------------------------------
+shm_region::ptr shm_region::create(size_t ring_bytes)
+{
+    ptr r(new shm_region());
+    r->__ring_bytes = round_ring(ring_bytes);
+    r->__map_bytes  = HEADER_BYTES + 2 * r->__ring_bytes;
+
+    r->__memfd = ::memfd_create("hz_mq-shm", MFD_CLOEXEC);
+    if (r->__memfd < 0) return nullptr;
+    if (::ftruncate(r->__memfd, static_cast<off_t>(r->__map_bytes)) != 0) return nullptr;
+    for (int& efd : r->__efd) {
+        efd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (efd < 0) return nullptr;
+    }
+
+    void* base = ::mmap(nullptr, r->__map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, r->__memfd, 0);
+    if (base == MAP_FAILED) return nullptr;
+    r->__base = base;
+
+    auto* hdr = new (base) shm_header();
+    hdr->magic      = SHM_MAGIC;
+    hdr->version    = 1;
+    hdr->ring_bytes = r->__ring_bytes;
+    return r;
+}
+
+shm_region::ptr shm_region::attach(int memfd, int efd_c2s, int efd_s2c)
+{
+    ptr r(new shm_region());
+    r->__memfd  = memfd;
+    r->__efd[SHM_C2S] = efd_c2s;
+    r->__efd[SHM_S2C] = efd_s2c;
+    if (memfd < 0 || efd_c2s < 0 || efd_s2c < 0) return nullptr;
+
+    struct stat st;
+    if (::fstat(memfd, &st) != 0 || st.st_size < static_cast<off_t>(HEADER_BYTES)) return nullptr;
+    r->__map_bytes = static_cast<size_t>(st.st_size);
+
+    void* base = ::mmap(nullptr, r->__map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (base == MAP_FAILED) return nullptr;
+    r->__base = base;
+
+    auto* hdr = static_cast<shm_header*>(base);
+    if (hdr->magic != SHM_MAGIC || hdr->version != 1 ||
+        HEADER_BYTES + 2 * hdr->ring_bytes != r->__map_bytes)
+        return nullptr;
+    r->__ring_bytes = hdr->ring_bytes;
+    hdr->attached.store(1, std::memory_order_release);
+
+    // 客户端的门铃 fd 用阻塞读
+    ::fcntl(efd_s2c, F_SETFL, ::fcntl(efd_s2c, F_GETFL) & ~O_NONBLOCK);
+    return r;
+}
+
+shm_region::~shm_region()
+{
+    if (__base) ::munmap(__base, __map_bytes);
+    close_fd(__memfd);
+    close_fd(__efd[0]);
+    close_fd(__efd[1]);
+}
+
+bool shm_region::peer_attached() const
+{
+    return static_cast<const shm_header*>(__base)->attached.load(std::memory_order_acquire) != 0;
+}
+
+shm_ring shm_region::ring(shm_dir dir)
+{
+    auto* hdr  = static_cast<shm_header*>(__base);
+    char* data = static_cast<char*>(__base) + HEADER_BYTES + (dir == SHM_C2S ? 0 : __ring_bytes);
+    return shm_ring(&hdr->rings[dir], data, __ring_bytes);
+}
+
+void shm_region::notify(int efd)
+{
+    uint64_t one = 1;
+    ssize_t n = ::write(efd, &one, sizeof(one));
+    (void)n;   // 计数溢出（EAGAIN）时对方必然已有未读门铃
+}
+
+void shm_region::clear(int efd)
+{
+    uint64_t v;
+    ssize_t n = ::read(efd, &v, sizeof(v));
+    (void)n;
+}
+
+// ---------------------------------------------------------------------------
+// fd 交接
+// ---------------------------------------------------------------------------
+bool shm_offer(const shm_region& region, std::string* name, std::string* token)
+{
+    std::random_device rd;
+    std::string tok(TOKEN_BYTES, '\0');
+    for (auto& c : tok) c = static_cast<char>(rd() & 0xFF);
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "hz_mq.shm.%d.%08x%08x", static_cast<int>(::getpid()), rd(), rd());
+    std::string sock_name = buf;
+
+    int lfd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (lfd < 0) return false;
+    sockaddr_un addr;
+    socklen_t alen = abstract_addr(sock_name, &addr);
+    if (::bind(lfd, reinterpret_cast<sockaddr*>(&addr), alen) != 0 || ::listen(lfd, 1) != 0) {
+        ::close(lfd);
+        return false;
+    }
+
+    // 交出的是副本：共享区随后被关闭也不影响交接
+    int fds[3] = {::fcntl(region.memfd(), F_DUPFD_CLOEXEC, 0),
+                  ::fcntl(region.event_fd(SHM_C2S), F_DUPFD_CLOEXEC, 0),
+                  ::fcntl(region.event_fd(SHM_S2C), F_DUPFD_CLOEXEC, 0)};
+    if (fds[0] < 0 || fds[1] < 0 || fds[2] < 0) {
+        for (int& fd : fds) close_fd(fd);
+        ::close(lfd);
+        return false;
+    }
+
+    // 一次性：至多等一个合法客户端，超时或令牌不符即放弃
+    std::thread([lfd, fds, tok]() mutable {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SHM_HANDOFF_WAIT_MS);
+        while (true) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            deadline - std::chrono::steady_clock::now()).count();
+            pollfd pfd{lfd, POLLIN, 0};
+            if (left <= 0 || ::poll(&pfd, 1, static_cast<int>(left)) <= 0) break;
+
+            int cfd = ::accept4(lfd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (cfd < 0) continue;
+            ucred cred{};
+            socklen_t clen = sizeof(cred);
+            std::string got(TOKEN_BYTES, '\0');
+            bool ok = ::getsockopt(cfd, SOL_SOCKET, SO_PEERCRED, &cred, &clen) == 0 &&
+                      cred.uid == ::getuid() && read_full(cfd, &got[0], got.size()) && got == tok;
+            if (ok) {
+                char byte = 'F';
+                iovec iov{&byte, 1};
+                alignas(cmsghdr) char ctrl[CMSG_SPACE(sizeof(fds))];
+                msghdr msg{};
+                msg.msg_iov        = &iov;
+                msg.msg_iovlen     = 1;
+                msg.msg_control    = ctrl;
+                msg.msg_controllen = sizeof(ctrl);
+                cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+                cm->cmsg_level = SOL_SOCKET;
+                cm->cmsg_type  = SCM_RIGHTS;
+                cm->cmsg_len   = CMSG_LEN(sizeof(fds));
+                std::memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+                ok = ::sendmsg(cfd, &msg, MSG_NOSIGNAL) == 1;
+            }
+            ::close(cfd);
+            if (ok) break;
+        }
+        for (int& fd : fds) close_fd(fd);
+        ::close(lfd);
+    }).detach();
+
+    *name  = std::move(sock_name);
+    *token = std::move(tok);
+    return true;
+}
+
+bool shm_collect(const std::string& name, const std::string& token, int fds[3])
+{
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    sockaddr_un addr;
+    socklen_t alen = abstract_addr(name, &addr);
+    bool ok = ::connect(fd, reinterpret_cast<sockaddr*>(&addr), alen) == 0 &&
+              ::write(fd, token.data(), token.size()) == static_cast<ssize_t>(token.size());
+    if (ok) {
+        char byte;
+        iovec iov{&byte, 1};
+        int received[3];
+        alignas(cmsghdr) char ctrl[CMSG_SPACE(sizeof(received))];
+        msghdr msg{};
+        msg.msg_iov        = &iov;
+        msg.msg_iovlen     = 1;
+        msg.msg_control    = ctrl;
+        msg.msg_controllen = sizeof(ctrl);
+        ok = ::recvmsg(fd, &msg, MSG_CMSG_CLOEXEC) == 1;
+        cmsghdr* cm = ok ? CMSG_FIRSTHDR(&msg) : nullptr;
+        ok = cm && cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS &&
+             cm->cmsg_len == CMSG_LEN(sizeof(received));
+        if (ok) {
+            std::memcpy(received, CMSG_DATA(cm), sizeof(received));
+            for (int i = 0; i < 3; ++i) fds[i] = received[i];
+        }
+    }
+    ::close(fd);
+    return ok;
+}
+
+} // namespace hz_mq
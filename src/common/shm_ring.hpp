@@ -0,0 +1,161 @@
+// ======================= shm_ring.hpp =======================
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace hz_mq {
+
+// -----------------------------------------------------------------
+// 同机共享内存传输：每个客户端一块 memfd，内含一对单生产者 / 单消费者字节环
+//   · 环 SHM_C2S 由客户端写、broker 读（PUBLISH / ACK），SHM_S2C 反向（DELIVER）
+//   · 环内每条记录为 len(4) + 一个完整的热路径二进制帧（fast_frame），按 8 字节对齐，
+//     语义与 TCP 上的二进制帧完全相同；记录不跨环尾，放不下时写 SHM_WRAP 标记回到开头
+//   · 每个方向一个 eventfd 作门铃：读端准备休眠前置 reader_idle，
+//     写端发布后只在对方空闲时才 write(eventfd)，持续流量下不产生系统调用
+//   · memfd 与 eventfd 经 TCP 协商后，通过抽象命名空间 Unix socket（SCM_RIGHTS）交给客户端
+// -----------------------------------------------------------------
+inline constexpr uint32_t SHM_MAGIC          = 0x31514D48;   // "HMQ1"
+inline constexpr size_t   SHM_DEFAULT_RING   = 4 * 1024 * 1024;
+inline constexpr size_t   SHM_MIN_RING       = 64 * 1024;
+inline constexpr size_t   SHM_MAX_RING       = 64 * 1024 * 1024;
+inline constexpr uint32_t SHM_WRAP           = 0xFFFFFFFFu;
+inline constexpr int      SHM_HANDOFF_WAIT_MS = 5000;        // 等待客户端来取 fd 的时限
+
+enum shm_dir : int { SHM_C2S = 0, SHM_S2C = 1 };
+
+// 共享区内每个方向的控制字，读写位置各占一条缓存行
+struct shm_ring_ctl {
+    alignas(64) std::atomic<uint64_t> head;          // 读端已消费到的逻辑偏移（单调增长）
+    alignas(64) std::atomic<uint64_t> tail;          // 写端已发布到的逻辑偏移
+    alignas(64) std::atomic<uint32_t> reader_idle;   // 非 0：读端已（或即将）阻塞在 eventfd 上
+};
+
+// 对共享区中一个方向的视图，一个对象只用作读端或写端之一，写端需自行串行化（多线程写时加锁）。
+// 本端的读 / 写位置保存在对象内，只向共享区发布、从不读回：对端可以随意改写控制页，
+// 读到的对端位置不是 8 字节对齐、回退或越过本端位置时置 broken()，不会据此越界访问
+class shm_ring {
+public:
+    // capacity 须为 8 的倍数；两端都从偏移 0 开始
+    shm_ring(shm_ring_ctl* ctl, char* data, uint64_t capacity)
+        : __ctl(ctl), __data(data), __cap(capacity) {}
+
+    // 写入一条记录 a + b 并发布；空间不足或超过 max_record() 返回 false
+    bool push(std::string_view a, std::string_view b = {});
+    // 读出全部已发布记录，fn(const char* data, size_t len) 中的指针只在回调内有效；
+    // fn 返回 bool 时，返回 false 表示读完这条就停（其余记录留在环内，下次再读）；
+    // 长度字段越界（对端写坏了共享区）时停止读取并置 broken()
+    template <class F>
+    size_t drain(F&& fn);
+    bool broken() const { return __broken; }
+
+    bool   empty() const;   // 读端视角：是否已读到对端发布的位置
+    size_t max_record() const { return __cap / 2 - sizeof(uint32_t); }
+
+    // 门铃：写端发布后调用，返回是否需要唤醒读端
+    bool reader_sleeping() const;
+    // 读端准备阻塞前调用：置空闲标记后若又有数据则撤销标记并返回 false
+    bool prepare_sleep();
+    void wake_up() { __ctl->reader_idle.store(0, std::memory_order_relaxed); }
+
+private:
+    shm_ring_ctl* __ctl;
+    char*         __data;
+    uint64_t      __cap;
+    uint64_t      __own{0};    // 本端位置：读端为 head，写端为 tail
+    uint64_t      __peer{0};   // 上次读到的对端位置，用于单调性校验
+    bool          __broken{false};
+};
+
+// memfd 共享区：头部页放两个方向的控制字，之后依次是 C2S / S2C 两个数据区
+class shm_region {
+public:
+    using ptr = std::unique_ptr<shm_region>;
+
+    // broker 侧：创建 memfd 与两个 eventfd 并初始化；失败返回 nullptr
+    static ptr create(size_t ring_bytes);
+    // 客户端侧：接管收到的 fd（成功或失败都由本函数负责关闭），校验布局
+    static ptr attach(int memfd, int efd_c2s, int efd_s2c);
+    ~shm_region();
+
+    shm_ring ring(shm_dir dir);
+    int memfd() const { return __memfd; }
+    int event_fd(shm_dir dir) const { return __efd[dir]; }
+    size_t ring_bytes() const { return __ring_bytes; }
+    // 客户端已 attach：此前 broker 不往 S2C 环写，交接失败时投递不会落进无人读的环
+    bool peer_attached() const;
+
+    static void notify(int efd);   // 门铃 +1
+    static void clear(int efd);    // 读掉门铃计数（非阻塞 eventfd）
+
+private:
+    shm_region() = default;
+
+    int    __memfd{-1};
+    int    __efd[2]{-1, -1};
+    void*  __base{nullptr};
+    size_t __map_bytes{0};
+    size_t __ring_bytes{0};
+};
+
+// ---- fd 交接：抽象命名空间 Unix socket + 一次性令牌 --------------------------
+// broker 侧：监听一个一次性 socket，SHM_HANDOFF_WAIT_MS 内等客户端连接，
+// 核对同一 uid 与令牌后用 SCM_RIGHTS 发出 memfd 与两个 eventfd 的副本。
+// 返回 socket 名（不含开头的 '\0'）与令牌；失败返回 false
+bool shm_offer(const shm_region& region, std::string* name, std::string* token);
+// 客户端侧：连接 name、出示令牌并收下三个 fd（memfd, c2s, s2c）
+bool shm_collect(const std::string& name, const std::string& token, int fds[3]);
+
+// ==================== Implementation ====================
+template <class F>
+size_t shm_ring::drain(F&& fn)
+{
+    if (__broken) return 0;
+    uint64_t tail = __ctl->tail.load(std::memory_order_acquire);
+    if ((tail & 7) != 0 || tail < __peer || tail - __own > __cap) {
+        __broken = true;
+        return 0;
+    }
+    __peer = tail;
+
+    // head 始终 8 字节对齐，pos <= __cap - 8，下面的减法不会回绕
+    uint64_t head = __own;
+    size_t n = 0;
+    while (head != tail) {
+        uint64_t pos = head % __cap;
+        uint32_t len;
+        std::memcpy(&len, __data + pos, sizeof(len));
+        if (len == SHM_WRAP) {
+            if (tail - head < __cap - pos) {
+                __broken = true;
+                break;
+            }
+            head += __cap - pos;
+            continue;
+        }
+        if (len > __cap - pos - sizeof(len) || tail - head < sizeof(len) + len) {
+            __broken = true;
+            break;
+        }
+        const char* rec = __data + pos + sizeof(len);
+        bool more = true;
+        if constexpr (std::is_same_v<std::invoke_result_t<F&, const char*, size_t>, bool>)
+            more = fn(rec, static_cast<size_t>(len));
+        else
+            fn(rec, static_cast<size_t>(len));
+        head += (sizeof(len) + len + 7) & ~uint64_t(7);
+        ++n;
+        if (!more) break;
+    }
+    __own = head;
+    __ctl->head.store(head, std::memory_order_release);
+    return n;
+}
+
+} // namespace hz_mq
@@ -0,0 +1,210 @@
+// ======================= slab_pool.cpp =======================
+#include "slab_pool.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+namespace hz_mq::slab {
+
+namespace {
+
+constexpr size_t NUM_CLASSES = 4;   // 64 / 128 / 256 / 512
+constexpr size_t MIN_SHIFT   = 6;
+
+struct free_node {
+    free_node* next;
+};
+
+struct shard {
+    free_node*              local[NUM_CLASSES]{};
+    std::atomic<free_node*> remote[NUM_CLASSES]{};
+};
+
+struct slab_header {
+    shard* owner;
+};
+
+std::atomic<size_t> g_slab_count{0};
+
+// 退出线程留下的 shard，等待新线程接管
+std::mutex          g_abandoned_mtx;
+std::vector<shard*> g_abandoned;
+
+// 线程已析构本地缓存后（其他 thread_local 析构时）仍可能分配，退回到这个加锁的公共 shard
+std::mutex g_shared_mtx;
+shard      g_shared;
+
+int size_class(size_t bytes)
+{
+    if (bytes == 0 || bytes > SLAB_MAX_BLOCK) return -1;
+    int cls = 0;
+    while ((size_t(1) << (MIN_SHIFT + cls)) < bytes) ++cls;
+    return cls;
+}
+
+size_t block_size(int cls) { return size_t(1) << (MIN_SHIFT + cls); }
+
+shard* owner_of(void* p)
+{
+    auto base = reinterpret_cast<uintptr_t>(p) & ~(uintptr_t(SLAB_BYTES) - 1);
+    return reinterpret_cast<slab_header*>(base)->owner;
+}
+
+void push_remote(shard* owner, int cls, free_node* head, free_node* tail)
+{
+    free_node* old = owner->remote[cls].load(std::memory_order_relaxed);
+    do {
+        tail->next = old;
+    } while (!owner->remote[cls].compare_exchange_weak(old, head, std::memory_order_release,
+                                                       std::memory_order_relaxed));
+}
+
+// 切一块新 slab 全部挂到 s 的本地空闲链
+void carve(shard* s, int cls)
+{
+    void* mem = std::aligned_alloc(SLAB_BYTES, SLAB_BYTES);
+    if (!mem) throw std::bad_alloc();
+    g_slab_count.fetch_add(1, std::memory_order_relaxed);
+    static_cast<slab_header*>(mem)->owner = s;
+
+    size_t bs    = block_size(cls);
+    size_t first = (sizeof(slab_header) + bs - 1) / bs * bs;
+    char*  base  = static_cast<char*>(mem);
+    free_node* head = s->local[cls];
+    for (size_t off = SLAB_BYTES - bs; off >= first; off -= bs) {
+        auto* n = reinterpret_cast<free_node*>(base + off);
+        n->next = head;
+        head = n;
+        if (off == first) break;
+    }
+    s->local[cls] = head;
+}
+
+void* pop(shard* s, int cls)
+{
+    if (!s->local[cls]) {
+        s->local[cls] = s->remote[cls].exchange(nullptr, std::memory_order_acquire);
+        if (!s->local[cls]) carve(s, cls);
+    }
+    free_node* n = s->local[cls];
+    s->local[cls] = n->next;
+    return n;
+}
+
+// 跨线程释放的待归还批次：每档只攒同一个目标 shard
+struct pending {
+    shard*     owner{nullptr};
+    free_node* head{nullptr};
+    free_node* tail{nullptr};
+    size_t     count{0};
+
+    void flush(int cls)
+    {
+        if (head) push_remote(owner, cls, head, tail);
+        *this = pending{};
+    }
+};
+
+struct thread_cache {
+    shard*  own{nullptr};
+    pending out[NUM_CLASSES];
+
+    ~thread_cache();
+};
+
+thread_local thread_cache* t_cache = nullptr;
+thread_local bool          t_dead  = false;
+
+thread_cache::~thread_cache()
+{
+    for (size_t cls = 0; cls < NUM_CLASSES; ++cls) out[cls].flush(static_cast<int>(cls));
+    if (own) {
+        std::lock_guard<std::mutex> lk(g_abandoned_mtx);
+        g_abandoned.push_back(own);
+    }
+    t_cache = nullptr;
+    t_dead  = true;
+}
+
+thread_cache* cache()
+{
+    if (t_cache) return t_cache;
+    if (t_dead) return nullptr;
+    static thread_local thread_cache tc;
+    t_cache = &tc;
+    return t_cache;
+}
+
+shard* own_shard(thread_cache* tc)
+{
+    if (tc->own) return tc->own;
+    {
+        std::lock_guard<std::mutex> lk(g_abandoned_mtx);
+        if (!g_abandoned.empty()) {
+            tc->own = g_abandoned.back();
+            g_abandoned.pop_back();
+        }
+    }
+    if (!tc->own) tc->own = new shard();
+    return tc->own;
+}
+
+} // namespace
+
+void* allocate(size_t bytes)
+{
+    int cls = size_class(bytes);
+    if (cls < 0) return ::operator new(bytes);
+
+    thread_cache* tc = cache();
+    if (!tc) {
+        std::lock_guard<std::mutex> lk(g_shared_mtx);
+        return pop(&g_shared, cls);
+    }
+    return pop(own_shard(tc), cls);
+}
+
+void deallocate(void* p, size_t bytes) noexcept
+{
+    if (!p) return;
+    int cls = size_class(bytes);
+    if (cls < 0) {
+        ::operator delete(p);
+        return;
+    }
+
+    auto*  n     = static_cast<free_node*>(p);
+    shard* owner = owner_of(p);
+    thread_cache* tc = cache();
+    if (tc && owner == tc->own) {
+        n->next = owner->local[cls];
+        owner->local[cls] = n;
+        return;
+    }
+    if (!tc || owner == &g_shared) {
+        // 线程正在退出，或块来自公共 shard：逐块直接归还
+        n->next = nullptr;
+        push_remote(owner, cls, n, n);
+        return;
+    }
+
+    pending& b = tc->out[cls];
+    if (b.owner != owner) {
+        b.flush(cls);
+        b.owner = owner;
+    }
+    n->next = b.head;
+    b.head = n;
+    if (!b.tail) b.tail = n;
+    if (++b.count >= SLAB_REMOTE_BATCH) b.flush(cls);
+}
+
+size_t slab_count()
+{
+    return g_slab_count.load(std::memory_order_relaxed);
+}
+
+} // namespace hz_mq::slab
@@ -0,0 +1,54 @@
+// ======================= slab_pool.hpp =======================
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+namespace hz_mq {
+
+// -----------------------------------------------------------------
+// 按线程分片的定长块池（slab），用于消息对象与队列容器节点
+//   · 每线程一个 shard，块大小分 64 / 128 / 256 / 512 四档；
+//     超过 SLAB_MAX_BLOCK 或分档之外的请求直接走 ::operator new
+//   · slab 按 SLAB_BYTES 对齐，块地址向下取整即得 slab 头，找到所属 shard
+//   · 本线程释放直接挂回本地空闲链；跨线程释放先攒进线程本地批次，
+//     满 SLAB_REMOTE_BATCH 块（或换了目标 shard）时一次 CAS 挂到所属 shard 的远端链，
+//     所属线程本地链取空时整条收回
+//   · 线程退出时 shard 连同其 slab 交给下一个新线程接管，slab 不归还给系统
+// -----------------------------------------------------------------
+inline constexpr size_t SLAB_BYTES        = 64 * 1024;
+inline constexpr size_t SLAB_MAX_BLOCK    = 512;
+inline constexpr size_t SLAB_REMOTE_BATCH = 32;
+
+namespace slab {
+
+void* allocate(size_t bytes);
+void  deallocate(void* p, size_t bytes) noexcept;
+
+size_t slab_count();   // 已向系统申请的 slab 数（观测 / 测试用）
+
+} // namespace slab
+
+// STL 分配器：allocate_shared<Message>、std::deque 等容器节点走 slab 池
+template <class T>
+struct slab_allocator {
+    using value_type = T;
+
+    slab_allocator() noexcept = default;
+    template <class U>
+    slab_allocator(const slab_allocator<U>&) noexcept {}
+
+    T* allocate(size_t n)
+    {
+        if (n > static_cast<size_t>(-1) / sizeof(T)) throw std::bad_alloc();
+        return static_cast<T*>(slab::allocate(n * sizeof(T)));
+    }
+    void deallocate(T* p, size_t n) noexcept { slab::deallocate(p, n * sizeof(T)); }
+
+    template <class U>
+    bool operator==(const slab_allocator<U>&) const noexcept { return true; }
+    template <class U>
+    bool operator!=(const slab_allocator<U>&) const noexcept { return false; }
+};
+
+} // namespace hz_mq
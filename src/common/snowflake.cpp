@@ -0,0 +1,63 @@
+// ======================= snowflake.cpp =======================
+#include "snowflake.hpp"
+
+#include <chrono>
+
+namespace hz_mq {
+
+namespace {
+
+uint64_t now_ms()
+{
+    using namespace std::chrono;
+    uint64_t ms = static_cast<uint64_t>(
+        duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count());
+    return ms > SNOWFLAKE_EPOCH_MS ? ms - SNOWFLAKE_EPOCH_MS : 0;
+}
+
+} // namespace
+
+snowflake::snowflake(uint32_t node_id)
+    : __node(node_id & SNOWFLAKE_MAX_NODE)
+{
+}
+
+void snowflake::set_node(uint32_t node_id)
+{
+    __node.store(node_id & SNOWFLAKE_MAX_NODE, std::memory_order_relaxed);
+}
+
+uint64_t snowflake::next()
+{
+    uint64_t ts = now_ms() << SNOWFLAKE_SEQ_BITS;
+    uint64_t last = __last.load(std::memory_order_relaxed);
+    uint64_t cur;
+    do {
+        // 时钟前进则序号归零；否则（同一毫秒或时钟回拨）在上一个值上加一，序号溢出自然进位到毫秒
+        cur = ts > last ? ts : last + 1;
+    } while (!__last.compare_exchange_weak(last, cur, std::memory_order_relaxed));
+
+    uint64_t ms  = cur >> SNOWFLAKE_SEQ_BITS;
+    uint64_t seq = cur & ((1ULL << SNOWFLAKE_SEQ_BITS) - 1);
+    uint64_t id  = (ms << (SNOWFLAKE_NODE_BITS + SNOWFLAKE_SEQ_BITS)) |
+                   (uint64_t(node()) << SNOWFLAKE_SEQ_BITS) | seq;
+    return id != 0 ? id : next();   // 纪元起点的第一个值恰为 0，跳过
+}
+
+uint32_t snowflake::node_of(uint64_t id)
+{
+    return static_cast<uint32_t>((id >> SNOWFLAKE_SEQ_BITS) & SNOWFLAKE_MAX_NODE);
+}
+
+uint64_t snowflake::timestamp_of(uint64_t id)
+{
+    return (id >> (SNOWFLAKE_NODE_BITS + SNOWFLAKE_SEQ_BITS)) + SNOWFLAKE_EPOCH_MS;
+}
+
+snowflake& message_id_generator()
+{
+    static snowflake gen;
+    return gen;
+}
+
+} // namespace hz_mq
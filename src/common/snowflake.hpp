@@ -0,0 +1,42 @@
+// ======================= snowflake.hpp =======================
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace hz_mq {
+
+// -----------------------------------------------------------------
+// 64 位数值消息 id（snowflake 布局）：
+//   毫秒时间戳(41，自 SNOWFLAKE_EPOCH_MS 起) | 节点号(10) | 序号(12)
+//   · 时间戳进入 id 高位，进程重启后新 id 仍大于旧 id，持久化消息不会撞号
+//   · 同一毫秒内序号用尽时借用下一毫秒，id 始终单调递增
+//   · 节点号区分同时运行的多个 broker，取值 0 ~ SNOWFLAKE_MAX_NODE
+// 0 保留为"未分配"
+// -----------------------------------------------------------------
+inline constexpr int      SNOWFLAKE_NODE_BITS = 10;
+inline constexpr int      SNOWFLAKE_SEQ_BITS  = 12;
+inline constexpr uint32_t SNOWFLAKE_MAX_NODE  = (1u << SNOWFLAKE_NODE_BITS) - 1;
+inline constexpr uint64_t SNOWFLAKE_EPOCH_MS  = 1704067200000ULL;   // 2024-01-01 00:00:00 UTC
+
+class snowflake {
+public:
+    explicit snowflake(uint32_t node_id = 0);
+
+    uint64_t next();
+    void     set_node(uint32_t node_id);   // 超出范围时截断到低 SNOWFLAKE_NODE_BITS 位
+    uint32_t node() const { return __node.load(std::memory_order_relaxed); }
+
+    static uint32_t node_of(uint64_t id);
+    static uint64_t timestamp_of(uint64_t id);   // 毫秒，Unix 纪元
+
+private:
+    std::atomic<uint32_t> __node;
+    std::atomic<uint64_t> __last{0};   // (相对毫秒 << SEQ_BITS) | 序号
+};
+
+// 进程内共享的消息 id 生成器；节点号在启动时设置一次
+snowflake& message_id_generator();
+inline uint64_t next_message_id() { return message_id_generator().next(); }
+
+} // namespace hz_mq
@@ -0,0 +1,96 @@
+// ======================= thread_affinity.cpp =======================
+#include "thread_affinity.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+#include <dirent.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+
+namespace hz_mq::affinity {
+
+// 整段必须是非负十进制数
+static bool parse_cpu(const std::string& text, long* out)
+{
+    char* end = nullptr;
+    long v = std::strtol(text.c_str(), &end, 10);
+    if (end == text.c_str() || *end != '\0' || v < 0) return false;
+    *out = v;
+    return true;
+}
+
+std::vector<int> parse_cpu_list(const std::string& spec)
+{
+    std::vector<int> cpus;
+    size_t start = 0;
+    while (start < spec.size()) {
+        size_t pos = spec.find(',', start);
+        std::string part = spec.substr(start, pos - start);
+        size_t dash = part.find('-');
+        long lo = 0, hi = 0;
+        if (dash == std::string::npos) {
+            if (parse_cpu(part, &lo) && lo < CPU_SETSIZE)
+                cpus.push_back(static_cast<int>(lo));
+        } else if (parse_cpu(part.substr(0, dash), &lo) && parse_cpu(part.substr(dash + 1), &hi)) {
+            // 超出 cpu_set_t 的编号无法绑定，截断上界，防止 "0-2000000000" 之类撑爆内存
+            hi = std::min<long>(hi, CPU_SETSIZE - 1);
+            for (long v = lo; v <= hi; ++v)
+                cpus.push_back(static_cast<int>(v));
+        }
+        if (pos == std::string::npos) break;
+        start = pos + 1;
+    }
+    return cpus;
+}
+
+bool pin_current_thread(int cpu)
+{
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+void set_current_thread_name(const std::string& name)
+{
+    pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+}
+
+int numa_node_of_cpu(int cpu)
+{
+    // /sys/devices/system/cpu/cpuN/ 下存在 nodeM 目录项
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* dir = ::opendir(path.c_str());
+    if (!dir) return -1;
+    int node = -1;
+    while (dirent* ent = ::readdir(dir)) {
+        std::string n = ent->d_name;
+        if (n.size() > 4 && n.compare(0, 4, "node") == 0) {
+            node = std::atoi(n.c_str() + 4);
+            break;
+        }
+    }
+    ::closedir(dir);
+    return node;
+}
+
+bool spans_numa_nodes(const std::vector<int>& cpus)
+{
+    std::set<int> nodes;
+    for (int c : cpus) nodes.insert(numa_node_of_cpu(c));
+    return nodes.size() > 1;
+}
+
+std::vector<int> group_by_numa(const std::vector<int>& cpus)
+{
+    std::vector<int> sorted = cpus;
+    std::stable_sort(sorted.begin(), sorted.end(), [](int a, int b) {
+        return numa_node_of_cpu(a) < numa_node_of_cpu(b);
+    });
+    return sorted;
+}
+
+} // namespace hz_mq::affinity
@@ -0,0 +1,41 @@
+// ======================= thread_affinity.hpp =======================
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace hz_mq {
+
+// ---------- 线程放置配置 ----------
+// io_cores     : 第 i 个 I/O 事件循环绑定到 io_cores[i]，线程名 mq-io-<i>
+// worker_cores : 第 i 个工作线程绑定到 worker_cores[i % n]，线程名 mq-wk-<i>
+// 为空表示不绑核，由内核自由调度
+struct cpu_placement {
+    std::vector<int> io_cores;
+    std::vector<int> worker_cores;
+
+    bool empty() const { return io_cores.empty() && worker_cores.empty(); }
+};
+
+namespace affinity {
+
+// "0-3,8,10-11" → {0,1,2,3,8,10,11}；非法片段被忽略，编号不超过 CPU_SETSIZE - 1
+std::vector<int> parse_cpu_list(const std::string& spec);
+
+// 将当前线程绑定到指定 CPU，失败返回 false
+bool pin_current_thread(int cpu);
+
+// 设置当前线程名（内核限制 15 字节，超出部分截断），便于 perf / top -H 观察
+void set_current_thread_name(const std::string& name);
+
+// 查询 CPU 所属 NUMA 节点（读取 sysfs），未知返回 -1
+int numa_node_of_cpu(int cpu);
+
+// 一组 CPU 是否跨越多个 NUMA 节点
+bool spans_numa_nodes(const std::vector<int>& cpus);
+
+// 按 NUMA 节点分组排序（同节点内保持原顺序），使相邻编号的线程落在同一节点
+std::vector<int> group_by_numa(const std::vector<int>& cpus);
+
+} // namespace affinity
+} // namespace hz_mq
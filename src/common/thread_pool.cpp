@@ -1,33 +1,34 @@
 // ======================= thread_pool.cpp =======================
 #include "thread_pool.hpp"
+#include "thread_affinity.hpp"
+
+#include <algorithm>
+#include <string>
 
 namespace hz_mq {
 
-thread_pool::thread_pool(size_t num_threads)
-    : __stop(false)
+// 工作线程内部提交任务时不能阻塞，否则所有 worker 同时等空位会死锁；
+// EventLoop 线程阻塞则整个 Reactor 停摆，同样不等空位（积压由水位背压兜底）
+static thread_local bool tls_in_pool = false;
+static thread_local bool tls_in_loop = false;
+
+void thread_pool::mark_event_loop_thread()
+{
+    tls_in_loop = true;
+}
+
+thread_pool::thread_pool(size_t num_threads, size_t max_tasks,
+                         const std::vector<int>& cores)
+    : __stop(false), __max_tasks(max_tasks)
 {
     if (num_threads == 0) {
-        num_threads = std::thread::hardware_concurrency();
+        num_threads = cores.empty() ? std::thread::hardware_concurrency() : cores.size();
         if (num_threads == 0) num_threads = 1;
     }
 
     for (size_t i = 0; i < num_threads; ++i) {
-        __threads.emplace_back([this] {
-            std::function<void()> task;
-            while (true) {
-                {
-                    std::unique_lock<std::mutex> lock(this->__mtx);
-                    this->__cv.wait(
-                        lock,
-                        [this] { return this->__stop || !this->__tasks.empty(); }
-                    );
-                    if (this->__stop && this->__tasks.empty()) return;
-                    task = std::move(this->__tasks.front());
-                    this->__tasks.pop();
-                }
-                task();  // 在锁外执行
-            }
-        });
+        int cpu = cores.empty() ? -1 : cores[i % cores.size()];
+        __threads.emplace_back([this, i, cpu] { worker_loop(i, cpu); });
     }
 }
 
@@ -38,19 +39,202 @@ thread_pool::~thread_pool()
         __stop = true;
     }
     __cv.notify_all();
+    __not_full.notify_all();
     for (std::thread& t : __threads) {
         if (t.joinable()) t.join();
     }
 }
 
+// 自旋等待时让出流水线，降低对同核超线程的干扰
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#else
+    std::this_thread::yield();
+#endif
+}
+
+bool thread_pool::spin_for_task(size_t& spin_limit)
+{
+    for (size_t i = 0; i < spin_limit; ++i) {
+        if (__pending.load(std::memory_order_acquire) > 0 || __stop) {
+            // 自旋命中：下次允许自旋更久
+            spin_limit = std::min(spin_limit * 2, SPIN_MAX);
+            __spins.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        cpu_relax();
+    }
+    // 白白自旋：缩短下次自旋时间，尽快 park 让出 CPU
+    spin_limit = std::max(spin_limit / 2, SPIN_MIN);
+    return false;
+}
+
+void thread_pool::worker_loop(size_t index, int cpu)
+{
+    tls_in_pool = true;
+    affinity::set_current_thread_name("mq-wk-" + std::to_string(index));
+    if (cpu >= 0) affinity::pin_current_thread(cpu);
+
+    size_t spin_limit = SPIN_MAX;
+    std::function<void()> task;
+    while (true) {
+        // 1. 队列为空时先短暂自旋，避免每条消息一次 futex 睡眠 / 唤醒
+        if (__pending.load(std::memory_order_acquire) == 0 && !__stop)
+            spin_for_task(spin_limit);
+
+        bool crossed_low = false;
+        bool was_full = false;
+        {
+            std::unique_lock<std::mutex> lock(__mtx);
+            // 2. 仍无任务则 park；__sleepers 让 push 判断是否需要唤醒
+            if (__tasks.empty() && !__stop) {
+                ++__sleepers;
+                __parks.fetch_add(1, std::memory_order_relaxed);
+                // 每次从 wait 返回都消耗一次通知额度：被通知后任务可能已被自旋中的 worker 抢走，
+                // 此时继续睡也要先归还额度，否则 push 以为已有人被叫醒而不再 notify
+                while (!__stop && __tasks.empty()) {
+                    __cv.wait(lock);
+                    if (__signaled > 0) --__signaled;
+                }
+                --__sleepers;
+            }
+            if (__stop && __tasks.empty()) return;
+            was_full = __max_tasks && __tasks.size() >= __max_tasks;
+            task = std::move(__tasks.front());
+            __tasks.pop();
+            __pending.fetch_sub(1, std::memory_order_release);
+
+            // 回落到低水位：解除背压
+            if (__overloaded && backlog_locked() <= __low_watermark) {
+                __overloaded = false;
+                crossed_low = true;
+            }
+        }
+        if (was_full) __not_full.notify_one();
+        if (crossed_low) report_watermark();
+        task();  // 在锁外执行
+    }
+}
+
 void thread_pool::push(const std::function<void()>& task)
 {
+    bool wake = false;
+    bool crossed = false;
     {
         std::unique_lock<std::mutex> lock(__mtx);
+        if (__max_tasks && !tls_in_pool && !tls_in_loop) {
+            __not_full.wait(lock, [this] { return __stop || __tasks.size() < __max_tasks; });
+        }
         if (__stop) return;
-        __tasks.emplace(task);
+        enqueue_locked(task, wake, crossed);
     }
-    __cv.notify_one();
+    notify_pushed(wake, crossed);
 }
 
-} 
+bool thread_pool::try_push(const std::function<void()>& task)
+{
+    bool wake = false;
+    bool crossed = false;
+    {
+        std::unique_lock<std::mutex> lock(__mtx);
+        if (__stop || (__max_tasks && __tasks.size() >= __max_tasks)) return false;
+        enqueue_locked(task, wake, crossed);
+    }
+    notify_pushed(wake, crossed);
+    return true;
+}
+
+void thread_pool::enqueue_locked(const std::function<void()>& task, bool& wake, bool& crossed)
+{
+    __tasks.emplace(task);
+    __pending.fetch_add(1, std::memory_order_release);
+
+    // 唤醒合并：只有存在尚未被通知的睡眠 worker 时才 notify，
+    // 一串连续 push 对每个 worker 至多唤醒一次；自旋中的 worker 自行取走任务
+    if (__sleepers > __signaled) {
+        ++__signaled;
+        wake = true;
+    }
+
+    // 越过高水位：通知上游停止生产
+    if (__high_watermark && !__overloaded && backlog_locked() >= __high_watermark) {
+        __overloaded = true;
+        crossed = true;
+    }
+}
+
+void thread_pool::add_backlog(ptrdiff_t n)
+{
+    bool crossed = false;
+    {
+        std::unique_lock<std::mutex> lock(__mtx);
+        if (n < 0 && static_cast<size_t>(-n) > __external) __external = 0;
+        else __external += n;
+        if (!__high_watermark) return;
+        if (!__overloaded && backlog_locked() >= __high_watermark) {
+            __overloaded = true;
+            crossed = true;
+        } else if (__overloaded && backlog_locked() <= __low_watermark) {
+            __overloaded = false;
+            crossed = true;
+        }
+    }
+    if (crossed) report_watermark();
+}
+
+void thread_pool::notify_pushed(bool wake, bool crossed)
+{
+    if (wake) {
+        __wakeups.fetch_add(1, std::memory_order_relaxed);
+        __cv.notify_one();
+    }
+    if (crossed) report_watermark();
+}
+
+void thread_pool::report_watermark()
+{
+    // push 与 worker 各自在锁外报告，可能乱序到达（恢复先于暂停执行会让发布方永远停着）：
+    // 在 __wm_mtx 下重读当前状态，只在与上次通知不同时回调。每次状态变化之后都有一次报告，
+    // 最后执行的那次一定读到最终状态
+    std::lock_guard<std::mutex> lk(__wm_mtx);
+    bool overloaded = __overloaded.load(std::memory_order_acquire);
+    if (overloaded == __reported_overloaded) return;
+    __reported_overloaded = overloaded;
+    if (overloaded) {
+        if (__on_high) __on_high();
+    } else if (__on_low) {
+        __on_low();
+    }
+}
+
+void thread_pool::set_watermark(size_t high, size_t low,
+                                const watermark_callback& on_high,
+                                const watermark_callback& on_low)
+{
+    std::lock_guard<std::mutex> wm(__wm_mtx);
+    std::unique_lock<std::mutex> lock(__mtx);
+    __high_watermark = high;
+    __low_watermark  = low < high ? low : high / 2;
+    __on_high = on_high;
+    __on_low  = on_low;
+}
+
+size_t thread_pool::pending()
+{
+    return __pending.load(std::memory_order_acquire);
+}
+
+thread_pool::stats thread_pool::get_stats() const
+{
+    stats s;
+    s.wakeups = __wakeups.load(std::memory_order_relaxed);
+    s.spins   = __spins.load(std::memory_order_relaxed);
+    s.parks   = __parks.load(std::memory_order_relaxed);
+    return s;
+}
+
+}
@@ -9,25 +9,88 @@
 #include <condition_variable>
 #include <atomic>
 #include <memory>
+#include <cstdint>
+#include <cstddef>
 
 namespace hz_mq {
 
 class thread_pool {
 public:
     using ptr = std::shared_ptr<thread_pool>;
+    // 水位回调：积压任务数越过高水位 / 回落到低水位时各触发一次（在任务队列锁外调用）；
+    // 回调之间串行执行、高低交替，最后一次回调总与当前状态一致
+    using watermark_callback = std::function<void()>;
 
-    explicit thread_pool(size_t num_threads = 0);
+    // 调度计数：wakeups = push 发出的 notify 次数，spins = 自旋期间等到任务的次数，
+    // parks = worker 进入条件变量睡眠的次数
+    struct stats {
+        uint64_t wakeups{0};
+        uint64_t spins{0};
+        uint64_t parks{0};
+    };
+
+    // max_tasks == 0 表示不限容量；否则队列满时 push 阻塞提交方（worker 与 EventLoop 线程除外）
+    // cores 非空时第 i 个 worker 绑定到 cores[i % cores.size()]；
+    // num_threads == 0 且给定 cores 时按核数创建线程
+    explicit thread_pool(size_t num_threads = 0, size_t max_tasks = 0,
+                         const std::vector<int>& cores = {});
     ~thread_pool();
 
-    // 向线程池提交任务
+    // 向线程池提交任务；worker 与标记过的 EventLoop 线程不等空位，超出容量照常入队
     void push(const std::function<void()>& task);
+    // 不阻塞的提交：有界模式下队列已满时返回 false
+    bool try_push(const std::function<void()>& task);
+    // 把当前线程标记为 EventLoop 线程：在它上面 push 不等待空位，避免卡住 Reactor
+    static void mark_event_loop_thread();
+
+    // 设置高 / 低水位及回调，用于向上游（发布连接）施加背压
+    void set_watermark(size_t high, size_t low,
+                       const watermark_callback& on_high,
+                       const watermark_callback& on_low);
+
+    // 计入水位的外部积压（如 strand 上排队的任务）：入队 +n、取出 -n
+    void add_backlog(ptrdiff_t n);
+
+    size_t pending();                       // 当前积压任务数
+    bool overloaded() const { return __overloaded; }
+    stats get_stats() const;
 
 private:
+    // 自旋次数上下限：命中后加倍、落空后减半（自适应）
+    static constexpr size_t SPIN_MIN = 64;
+    static constexpr size_t SPIN_MAX = 4096;
+
+    void worker_loop(size_t index, int cpu);
+    bool spin_for_task(size_t& spin_limit);
+    void enqueue_locked(const std::function<void()>& task, bool& wake, bool& crossed);   // 需持有 __mtx
+    void notify_pushed(bool wake, bool crossed);
+    size_t backlog_locked() const { return __tasks.size() + __external; }   // 需持有 __mtx
+    // 水位状态变化后调用：串行化并按当前 __overloaded 去重，乱序到达的旧通知被丢弃
+    void report_watermark();
+
     std::vector<std::thread> __threads;
     std::queue<std::function<void()>> __tasks;
     std::mutex __mtx;
     std::condition_variable __cv;
+    std::condition_variable __not_full;     // 有界模式下等待空位
     std::atomic<bool> __stop;
+    std::atomic<size_t> __pending{0};       // 与 __tasks.size() 同步，供自旋无锁读取
+    size_t __sleepers{0};                   // 正在 park 的 worker 数（受 __mtx 保护）
+    size_t __signaled{0};                   // 已 notify 但尚未醒来的 worker 数
+    size_t __external{0};                   // add_backlog 登记的外部积压（受 __mtx 保护）
+
+    size_t __max_tasks{0};
+    size_t __high_watermark{0};             // 0 表示不启用水位
+    size_t __low_watermark{0};
+    watermark_callback __on_high;
+    watermark_callback __on_low;
+    std::atomic<bool> __overloaded{false};
+    std::mutex __wm_mtx;                    // 串行化水位回调
+    bool __reported_overloaded{false};      // 最近一次回调通知的状态（受 __wm_mtx 保护）
+
+    std::atomic<uint64_t> __wakeups{0};
+    std::atomic<uint64_t> __spins{0};
+    std::atomic<uint64_t> __parks{0};
 };
 
-} 
+}
@@ -0,0 +1,152 @@
+// ======================= arena_codec.cpp =======================
+#include "arena_codec.hpp"
+#include "../common/logger.hpp"
+
+#include <google/protobuf/descriptor.h>
+#include <zlib.h>
+
+#include <cstring>
+#include <string>
+
+#include <arpa/inet.h>
+
+namespace hz_mq {
+
+// -----------------------------------------------------------------------------
+// frame_arena
+// -----------------------------------------------------------------------------
+google::protobuf::ArenaOptions frame_arena::options(char* scratch)
+{
+    google::protobuf::ArenaOptions opts;
+    opts.initial_block      = scratch;
+    opts.initial_block_size = SCRATCH_SIZE;
+    return opts;
+}
+
+frame_arena::frame_arena()
+    : __scratch(new char[SCRATCH_SIZE]), __arena(options(__scratch.get())) {}
+
+frame_arena::ptr acquire_decode_arena()
+{
+    thread_local frame_arena::ptr current;
+    if (current && current.use_count() == 1) {
+        current->reset();
+    } else {
+        current = std::make_shared<frame_arena>();
+    }
+    return current;
+}
+
+// -----------------------------------------------------------------------------
+// arena_decoder：帧格式与 ProtobufCodec 一致
+//   len(4) | nameLen(4) | typeName('\0' 结尾) | protobuf 数据 | adler32(4)
+// -----------------------------------------------------------------------------
+static int32_t read_int32(const char* p)
+{
+    int32_t be;
+    std::memcpy(&be, p, sizeof(be));
+    return static_cast<int32_t>(ntohl(static_cast<uint32_t>(be)));
+}
+
+google::protobuf::Message* arena_decoder::parse(const char* data, int len,
+                                                google::protobuf::Arena* arena)
+{
+    int32_t expected = read_int32(data + len - HEADER_LEN);
+    int32_t checksum = static_cast<int32_t>(
+        ::adler32(1, reinterpret_cast<const Bytef*>(data), static_cast<uInt>(len - HEADER_LEN)));
+    if (checksum != expected) {
+        LOG(ERROR) << "arena decode: checksum error";
+        return nullptr;
+    }
+
+    int32_t name_len = read_int32(data);
+    if (name_len < 2 || name_len > len - 2 * HEADER_LEN) {
+        LOG(ERROR) << "arena decode: invalid name length";
+        return nullptr;
+    }
+    std::string type_name(data + HEADER_LEN, data + HEADER_LEN + name_len - 1);
+
+    const google::protobuf::Descriptor* desc =
+        google::protobuf::DescriptorPool::generated_pool()->FindMessageTypeByName(type_name);
+    const google::protobuf::Message* prototype =
+        desc ? google::protobuf::MessageFactory::generated_factory()->GetPrototype(desc) : nullptr;
+    if (!prototype) {
+        LOG(ERROR) << "arena decode: unknown message type " << type_name;
+        return nullptr;
+    }
+
+    google::protobuf::Message* msg = prototype->New(arena);
+    const char* body = data + HEADER_LEN + name_len;
+    int body_len = len - name_len - 2 * HEADER_LEN;
+    if (!msg->ParseFromArray(body, body_len)) {
+        LOG(ERROR) << "arena decode: parse error for " << type_name;
+        return nullptr;
+    }
+    return msg;
+}
+
+void arena_decoder::on_message(const muduo::net::TcpConnectionPtr& conn, muduo::net::Buffer* buf,
+                               muduo::Timestamp ts)
+{
+    frame_arena::ptr arena;
+    while (buf->readableBytes() > 0) {
+        // 热路径二进制帧：定长头 + 原始字节，无需类型名与反射
+        if (is_fast_frame(buf->peek(), buf->readableBytes())) {
+            fast_frame f;
+            long n = __fast_callback ? decode_fast_frame(buf->peek(), buf->readableBytes(), &f) : -1;
+            if (n == 0) break;
+            if (n < 0) {
+                LOG(ERROR) << "arena decode: invalid fast frame";
+                conn->shutdown();
+                return;
+            }
+            __fast_callback(conn, f, ts);   // f 指向 buf，回调结束后才能 retrieve
+            buf->retrieve(static_cast<size_t>(n));
+            continue;
+        }
+
+        if (buf->readableBytes() < static_cast<size_t>(MIN_MESSAGE_LEN + HEADER_LEN)) break;
+        const int32_t len = buf->peekInt32();
+        if (len > MAX_MESSAGE_LEN || len < MIN_MESSAGE_LEN) {
+            LOG(ERROR) << "arena decode: invalid length " << len;
+            conn->shutdown();
+            return;
+        }
+        if (buf->readableBytes() < static_cast<size_t>(HEADER_LEN + len)) break;
+
+        // 本次可读事件内的所有帧共用一个 Arena；请求以别名 shared_ptr 交给 handler，
+        // handler 若异步持有请求，Arena 随之延长生命周期
+        if (!arena) arena = acquire_decode_arena();
+        google::protobuf::Message* raw = parse(buf->peek() + HEADER_LEN, len, arena->get());
+        if (!raw) {
+            conn->shutdown();
+            return;
+        }
+        MessagePtr msg(arena, raw);
+        buf->retrieve(HEADER_LEN + len);
+        __callback(conn, msg, ts);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// response_arena
+// -----------------------------------------------------------------------------
+static thread_local int tls_response_depth = 0;
+
+static frame_arena* response_scratch()
+{
+    thread_local frame_arena arena;
+    return &arena;
+}
+
+response_arena::response_arena() : __arena(response_scratch())
+{
+    ++tls_response_depth;
+}
+
+response_arena::~response_arena()
+{
+    if (--tls_response_depth == 0) __arena->reset();
+}
+
+} // namespace hz_mq
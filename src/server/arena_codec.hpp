@@ -0,0 +1,90 @@
+// ======================= arena_codec.hpp =======================
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+#include <google/protobuf/arena.h>
+#include <google/protobuf/message.h>
+
+#include "../common/fast_frame.hpp"
+#include "muduo/net/Buffer.h"
+#include "muduo/net/TcpConnection.h"
+#include "muduo/base/Timestamp.h"
+
+namespace hz_mq {
+
+// -----------------------------------------------------------------
+// 基于 protobuf Arena 的收发辅助：
+//   · frame_arena      —— 一块 Arena，首块内存来自预分配的 scratch，Reset 后复用
+//   · arena_decoder    —— 与 ProtobufCodec 相同的帧格式，请求解码到 Arena 上；
+//                         一次可读事件内的所有帧共用一个 Arena；
+//                         以 FAST_MAGIC 开头的热路径二进制帧直接交给 fast 回调
+//   · response_arena   —— 构造响应用的线程局部 Arena，send 同步序列化后即回收
+// -----------------------------------------------------------------
+class frame_arena {
+public:
+    using ptr = std::shared_ptr<frame_arena>;
+
+    static constexpr size_t SCRATCH_SIZE = 64 * 1024;
+
+    frame_arena();
+    google::protobuf::Arena* get() { return &__arena; }
+    void reset() { __arena.Reset(); }   // 保留 scratch 首块，其余块释放
+
+private:
+    static google::protobuf::ArenaOptions options(char* scratch);
+
+    std::unique_ptr<char[]>  __scratch;
+    google::protobuf::Arena  __arena;
+};
+
+// 当前线程可复用的解码 Arena：上一批请求都已释放时 Reset 复用，
+// 仍有请求被异步处理持有（如持久化发布的协程）时另建一个，旧的随最后一个请求释放
+frame_arena::ptr acquire_decode_arena();
+
+class arena_decoder {
+public:
+    using MessagePtr = std::shared_ptr<google::protobuf::Message>;
+    using message_callback =
+        std::function<void(const muduo::net::TcpConnectionPtr&, const MessagePtr&, muduo::Timestamp)>;
+
+    using fast_callback =
+        std::function<void(const muduo::net::TcpConnectionPtr&, const fast_frame&, muduo::Timestamp)>;
+
+    explicit arena_decoder(const message_callback& cb, const fast_callback& fast = nullptr)
+        : __callback(cb), __fast_callback(fast) {}
+
+    // 用作 TcpServer 的 MessageCallback，替代 ProtobufCodec::onMessage
+    void on_message(const muduo::net::TcpConnectionPtr& conn, muduo::net::Buffer* buf,
+                    muduo::Timestamp ts);
+
+private:
+    static constexpr int HEADER_LEN      = sizeof(int32_t);
+    static constexpr int MIN_MESSAGE_LEN = 2 * HEADER_LEN + 2;   // nameLen + typeName + checksum
+    static constexpr int MAX_MESSAGE_LEN = 64 * 1024 * 1024;
+
+    // 解析一帧（不含长度前缀）到 arena 上；失败返回 nullptr
+    static google::protobuf::Message* parse(const char* data, int len, google::protobuf::Arena* arena);
+
+    message_callback __callback;
+    fast_callback    __fast_callback;
+};
+
+// 响应构造：同一线程内可嵌套，最外层析构时统一 Reset
+class response_arena {
+public:
+    response_arena();
+    ~response_arena();
+    response_arena(const response_arena&) = delete;
+    response_arena& operator=(const response_arena&) = delete;
+
+    template <typename T>
+    T* create() { return google::protobuf::Arena::CreateMessage<T>(__arena->get()); }
+
+private:
+    frame_arena* __arena;
+};
+
+} // namespace hz_mq
@@ -25,7 +25,9 @@
 namespace hz_mq {
 
 // -----------------------------------------------------------------------------
-BrokerServer::BrokerServer(int port, const std::string& base_dir)
+BrokerServer::BrokerServer(int port, const std::string& base_dir,
+                           const cpu_placement& placement)
+    : __placement(placement)
 {
     // 1. 创建核心组件 ----------------------------------------------------------
     __loop  = std::make_unique<muduo::net::EventLoop>();
@@ -38,17 +40,33 @@ BrokerServer::BrokerServer(int port, const std::string& base_dir)
     __codec = std::make_shared<ProtobufCodec>(
         std::bind(&ProtobufDispatcher::onProtobufMessage, __dispatcher.get(),
                   std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    // 收包走 Arena 解码（帧格式同 ProtobufCodec），发包仍用 __codec
+    __decoder = std::make_unique<arena_decoder>(
+        std::bind(&ProtobufDispatcher::onProtobufMessage, __dispatcher.get(),
+                  std::placeholders::_1, std::placeholders::_2, std::placeholders::_3),
+        std::bind(&BrokerServer::on_fastFrame, this,
+                  std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
 
     // 2. 虚拟主机 & 管理器 -----------------------------------------------------
     std::string db_path = base_dir + DBFILE_PATH;
     __virtual_host       = std::make_shared<virtual_host>(HOST_NAME, base_dir, db_path);
     __consumer_manager   = std::make_shared<consumer_manager>();
     __connection_manager = std::make_shared<connection_manager>();
-    __thread_pool        = std::make_shared<thread_pool>();
+    __thread_pool        = std::make_shared<thread_pool>(0, TASK_QUEUE_CAPACITY,
+                                                      affinity::group_by_numa(__placement.worker_cores));
+    __thread_pool->set_watermark(TASK_HIGH_WATERMARK, TASK_LOW_WATERMARK,
+        [this]() {
+            LOG(WARNING) << "task queue above high watermark, pause publishers";
+            __connection_manager->pause_publishers(connection_manager::PAUSE_TASK_BACKLOG);
+        },
+        [this]() {
+            LOG(INFO) << "task queue below low watermark, resume publishers";
+            __connection_manager->resume_publishers(connection_manager::PAUSE_TASK_BACKLOG);
+        });
 
     // 3. 为已存在队列初始化消费者列表 -----------------------------------------
-    for (const auto& [qname, _] : __virtual_host->all_queues()) {
-        __consumer_manager->init_queue_consumer(qname);
+    for (const auto& [qname, q] : __virtual_host->all_queues()) {
+        __consumer_manager->init_queue_consumer(qname, q->args);
     }
 
     // 4. 注册回调 --------------------------------------------------------------
@@ -68,24 +86,71 @@ BrokerServer::BrokerServer(int port, const std::string& base_dir)
     REG(basicConsumeRequest,     &BrokerServer::on_basicConsume);
     REG(basicCancelRequest,      &BrokerServer::on_basicCancel);
     REG(basicQueryRequest,       &BrokerServer::on_basicQuery);
+    REG(basicGetRequest,         &BrokerServer::on_basicGet);
+    REG(basicCreditRequest,      &BrokerServer::on_basicCredit);
+    REG(basicPublishBatchRequest, &BrokerServer::on_basicPublishBatch);
     REG(heartbeatRequest,        &BrokerServer::on_heartbeat);
     REG(queueStatusRequest,     &BrokerServer::on_queueStatusRequest);
     REG(declareQueueWithDLQRequest, &BrokerServer::on_declareQueueWithDLQ);
     REG(basicNackRequest,        &BrokerServer::on_basicNack);
+    REG(basicQosRequest,         &BrokerServer::on_basicQos);
+    REG(confirmSelectRequest,    &BrokerServer::on_confirmSelect);
+    REG(fastPathRequest,         &BrokerServer::on_fastPath);
+    REG(shmAttachRequest,        &BrokerServer::on_shmAttach);
 #undef REG
 
     // 5. 网络层回调 ------------------------------------------------------------
-    __server->setMessageCallback( std::bind(&ProtobufCodec::onMessage, __codec, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3) );
+    __server->setMessageCallback( std::bind(&arena_decoder::on_message, __decoder.get(), std::placeholders::_1, std::placeholders::_2, std::placeholders::_3) );
     __server->setConnectionCallback( std::bind(&BrokerServer::onConnection, this, std::placeholders::_1) );
 
+    // 多于一个 I/O 核时启用子 Reactor：io_cores[0] 给主循环，其余各一个子循环；
+    // 各循环上的 handler 并发访问 virtual_host，由它内部的读写锁保护
+    if (__placement.io_cores.size() > 1) {
+        auto next_io = std::make_shared<std::atomic<size_t>>(1);
+        __server->setThreadNum(static_cast<int>(__placement.io_cores.size() - 1));
+        __server->setThreadInitCallback([this, next_io](muduo::net::EventLoop*) {
+            size_t idx = next_io->fetch_add(1);
+            thread_pool::mark_event_loop_thread();
+            affinity::set_current_thread_name("mq-io-" + std::to_string(idx));
+            affinity::pin_current_thread(__placement.io_cores[idx % __placement.io_cores.size()]);
+        });
+    }
+
+    std::vector<int> all_cores = __placement.io_cores;
+    all_cores.insert(all_cores.end(), __placement.worker_cores.begin(), __placement.worker_cores.end());
+    if (affinity::spans_numa_nodes(all_cores)) {
+        LOG(WARNING) << "io / worker cores span multiple NUMA nodes, "
+                        "queue memory follows the publishing I/O thread (first touch)";
+    }
+
         __loop->runEvery(5.0, [this]() {
         __connection_manager->check_timeout(std::chrono::seconds(30));
     });
+    __loop->runEvery(QUEUE_DEPTH_CHECK_INTERVAL, [this]() { check_queue_depth(); });
+}
+
+// -----------------------------------------------------------------------------
+void BrokerServer::check_queue_depth()
+{
+    size_t depth = __virtual_host->total_depth();
+    if (!__depth_paused && depth >= QUEUE_DEPTH_HIGH_WATERMARK) {
+        __depth_paused = true;
+        LOG(WARNING) << "queue depth " << depth << " above high watermark, pause publishers";
+        __connection_manager->pause_publishers(connection_manager::PAUSE_QUEUE_DEPTH);
+    } else if (__depth_paused && depth <= QUEUE_DEPTH_LOW_WATERMARK) {
+        __depth_paused = false;
+        LOG(INFO) << "queue depth " << depth << " below low watermark, resume publishers";
+        __connection_manager->resume_publishers(connection_manager::PAUSE_QUEUE_DEPTH);
+    }
 }
 
 // -----------------------------------------------------------------------------
 void BrokerServer::start()
 {
+    affinity::set_current_thread_name("mq-io-0");
+    thread_pool::mark_event_loop_thread();
+    if (!__placement.io_cores.empty())
+        affinity::pin_current_thread(__placement.io_cores.front());
     printServerInfo();
     __server->start();
     __loop->loop();
@@ -244,7 +309,22 @@ void BrokerServer::on_basicPublish(const muduo::net::TcpConnectionPtr& conn, con
     GET_CONN_CTX();
     GET_CHANNEL(msg->cid());
     LOG_REQ(basicPublishRequest);
-    ch->basic_publish(msg);
+    conn_ctx->mark_publisher();
+    ch->basic_publish_async(msg);
+    // 已处于过载状态时，新出现的发布连接也立即停止读取；经 connection 记录暂停状态，
+    // resume_publishers 才能恢复它，共享内存环也一并暂停
+    if (__connection_manager->publishers_paused()) conn_ctx->pause_read();
+}
+
+void BrokerServer::on_basicPublishBatch(const muduo::net::TcpConnectionPtr& conn, const basicPublishBatchRequestPtr& msg, muduo::Timestamp ts)
+{
+    (void)ts;
+    GET_CONN_CTX();
+    GET_CHANNEL(msg->cid());
+    LOG_REQ(basicPublishBatchRequest);
+    conn_ctx->mark_publisher();
+    ch->basic_publish_batch_async(msg);
+    if (__connection_manager->publishers_paused()) conn_ctx->pause_read();
 }
 
 void BrokerServer::on_basicAck(const muduo::net::TcpConnectionPtr& conn, const basicAckRequestPtr& msg, muduo::Timestamp ts)
@@ -283,6 +363,24 @@ void BrokerServer::on_basicQuery(const muduo::net::TcpConnectionPtr& conn, const
     ch->basic_query(msg);
 }
 
+void BrokerServer::on_basicGet(const muduo::net::TcpConnectionPtr& conn, const basicGetRequestPtr& msg, muduo::Timestamp ts)
+{
+    (void)ts;
+    GET_CONN_CTX();
+    GET_CHANNEL(msg->cid());
+    LOG_REQ(basicGetRequest);
+    ch->basic_get(msg);
+}
+
+void BrokerServer::on_basicCredit(const muduo::net::TcpConnectionPtr& conn, const basicCreditRequestPtr& msg, muduo::Timestamp ts)
+{
+    (void)ts;
+    GET_CONN_CTX();
+    GET_CHANNEL(msg->cid());
+    LOG_REQ(basicCreditRequest);
+    ch->basic_credit(msg);
+}
+
 
 void BrokerServer::on_heartbeat(const muduo::net::TcpConnectionPtr& conn, const heartbeatRequestPtr& msg, muduo::Timestamp ts)
 {
@@ -311,6 +409,24 @@ void BrokerServer::on_basicNack(const muduo::net::TcpConnectionPtr& conn, const
     ch->basic_nack(msg);
 }
 
+void BrokerServer::on_basicQos(const muduo::net::TcpConnectionPtr& conn, const basicQosRequestPtr& msg, muduo::Timestamp ts)
+{
+    (void)ts;
+    GET_CONN_CTX();
+    GET_CHANNEL(msg->cid());
+    LOG_REQ(basicQosRequest);
+    ch->basic_qos(msg);
+}
+
+void BrokerServer::on_confirmSelect(const muduo::net::TcpConnectionPtr& conn, const confirmSelectRequestPtr& msg, muduo::Timestamp ts)
+{
+    (void)ts;
+    GET_CONN_CTX();
+    GET_CHANNEL(msg->cid());
+    LOG_REQ(confirmSelectRequest);
+    ch->confirm_select(msg);
+}
+
 void BrokerServer::on_queueStatusRequest(const muduo::net::TcpConnectionPtr& conn, const queueStatusRequestPtr& msg, muduo::Timestamp ts)
 {
     (void)ts;
@@ -333,6 +449,56 @@ void BrokerServer::on_queueStatusRequest(const muduo::net::TcpConnectionPtr& con
     __codec->send(conn, resp);
 }
 
+void BrokerServer::on_fastPath(const muduo::net::TcpConnectionPtr& conn, const fastPathRequestPtr& msg, muduo::Timestamp ts)
+{
+    (void)ts;
+    GET_CONN_CTX();
+    LOG_REQ(fastPathRequest);
+    conn_ctx->enable_fast_path(msg);
+}
+
+void BrokerServer::on_shmAttach(const muduo::net::TcpConnectionPtr& conn, const shmAttachRequestPtr& msg, muduo::Timestamp ts)
+{
+    (void)ts;
+    GET_CONN_CTX();
+    LOG_REQ(shmAttachRequest);
+    // 环内的帧与 TCP 上的二进制帧走同一入口；回调不持有连接
+    std::weak_ptr<muduo::net::TcpConnection> weak_conn = conn;
+    conn_ctx->attach_shm(msg,
+        [this, weak_conn](const fast_frame& f) {
+            if (auto c = weak_conn.lock()) on_fastFrame(c, f, muduo::Timestamp::now());
+        },
+        [weak_conn]() {
+            if (auto c = weak_conn.lock()) c->shutdown();
+        });
+}
+
+void BrokerServer::on_fastFrame(const muduo::net::TcpConnectionPtr& conn, const fast_frame& f, muduo::Timestamp ts)
+{
+    (void)ts;
+    GET_CONN_CTX();
+    auto ch = conn_ctx->select_channel(f.channel);
+    if (!ch) {
+        LOG(WARNING) << "fast frame on unknown channel " << f.channel;
+        return;
+    }
+    switch (f.opcode) {
+    case fast_op::PUBLISH:
+        conn_ctx->mark_publisher();
+        ch->fast_publish(f);
+        if (__connection_manager->publishers_paused()) conn_ctx->pause_read();
+        break;
+    case fast_op::ACK:
+        ch->fast_ack(f);
+        break;
+    default:
+        // DELIVER 只由服务端发出
+        LOG(WARNING) << "unexpected fast frame opcode " << static_cast<int>(f.opcode);
+        conn->shutdown();
+        break;
+    }
+}
+
 #undef GET_CONN_CTX
 #undef GET_CHANNEL
 #undef LOG_REQ
@@ -8,6 +8,8 @@
 #include "../common/protocol.pb.h"
 
 #include "connection.hpp"              // connection / connection_manager (前向声明已在头内)
+#include "arena_codec.hpp"               // arena_decoder
+#include "../common/thread_affinity.hpp"  // cpu_placement
 
 // -------------------- Muduo 前向声明 ------------------------------
 namespace muduo {
@@ -48,24 +50,43 @@ using basicAckRequestPtr       = std::shared_ptr<basicAckRequest>;
 using basicConsumeRequestPtr   = std::shared_ptr<basicConsumeRequest>;
 using basicCancelRequestPtr    = std::shared_ptr<basicCancelRequest>;
 using basicQueryRequestPtr     = std::shared_ptr<basicQueryRequest>;
+using basicGetRequestPtr       = std::shared_ptr<basicGetRequest>;
+using basicCreditRequestPtr    = std::shared_ptr<basicCreditRequest>;
+using basicPublishBatchRequestPtr = std::shared_ptr<basicPublishBatchRequest>;
 using heartbeatRequestPtr      = std::shared_ptr<heartbeatRequest>;
 using MessagePtr               = std::shared_ptr<::google::protobuf::Message>;
 using queueStatusRequestPtr    = std::shared_ptr<queueStatusRequest>;
 using queueStatusResponsePtr   = std::shared_ptr<queueStatusResponse>;
 using declareQueueWithDLQRequestPtr = std::shared_ptr<declareQueueWithDLQRequest>;
 using basicNackRequestPtr = std::shared_ptr<basicNackRequest>;
+using basicQosRequestPtr       = std::shared_ptr<basicQosRequest>;
+using confirmSelectRequestPtr  = std::shared_ptr<confirmSelectRequest>;
+using fastPathRequestPtr       = std::shared_ptr<fastPathRequest>;
+using shmAttachRequestPtr      = std::shared_ptr<shmAttachRequest>;
 
 // 常量 -------------------------------------------------------------
 inline constexpr const char* DBFILE_PATH = "/meta.db";
 inline constexpr const char* HOST_NAME   = "MyVirtualHost";
 
+// 线程池背压：积压任务达到高水位时暂停发布连接读取，回落到低水位后恢复
+inline constexpr size_t TASK_QUEUE_CAPACITY  = 200000;   // 硬上限，兜底防止内存无限增长
+inline constexpr size_t TASK_HIGH_WATERMARK  = 50000;
+inline constexpr size_t TASK_LOW_WATERMARK   = 10000;
+
+// 队列深度背压：分发器每队列只占一个任务，线程池积压反映不出消费跟不上；
+// 定时统计所有队列待投递消息数，越过高水位暂停发布，回落到低水位恢复
+inline constexpr size_t QUEUE_DEPTH_HIGH_WATERMARK = 1000000;
+inline constexpr size_t QUEUE_DEPTH_LOW_WATERMARK  = 500000;
+inline constexpr double QUEUE_DEPTH_CHECK_INTERVAL = 0.1;    // 秒
+
 // ================================================================
 // BrokerServer : 启动 TCP 服务、分发 Protobuf 消息、维护核心管理器
 // ================================================================
 class BrokerServer {
 public:
-    BrokerServer(int port, const std::string& base_dir);
-    void start();   // 启动事件循环
+    BrokerServer(int port, const std::string& base_dir,
+                 const cpu_placement& placement = {});
+    void start();   // 启动事件循环（在调用线程上运行主 I/O 循环 mq-io-0）
 
 private:
     // 内部辅助 -----------------------------------------------------
@@ -94,23 +115,37 @@ private:
     void on_basicConsume  (const muduo::net::TcpConnectionPtr&, const basicConsumeRequestPtr&,   muduo::Timestamp);
     void on_basicCancel   (const muduo::net::TcpConnectionPtr&, const basicCancelRequestPtr&,    muduo::Timestamp);
     void on_basicQuery    (const muduo::net::TcpConnectionPtr&, const basicQueryRequestPtr&,     muduo::Timestamp);
+    void on_basicGet      (const muduo::net::TcpConnectionPtr&, const basicGetRequestPtr&,       muduo::Timestamp);
+    void on_basicPublishBatch(const muduo::net::TcpConnectionPtr&, const basicPublishBatchRequestPtr&, muduo::Timestamp);
+    void on_basicCredit   (const muduo::net::TcpConnectionPtr&, const basicCreditRequestPtr&,    muduo::Timestamp);
     void on_heartbeat     (const muduo::net::TcpConnectionPtr&, const heartbeatRequestPtr&,      muduo::Timestamp);
     void on_declareQueueWithDLQ(const muduo::net::TcpConnectionPtr&, const declareQueueWithDLQRequestPtr&, muduo::Timestamp);
     void on_basicNack     (const muduo::net::TcpConnectionPtr&, const basicNackRequestPtr&,      muduo::Timestamp);
+    void on_basicQos      (const muduo::net::TcpConnectionPtr&, const basicQosRequestPtr&,       muduo::Timestamp);
+    void on_confirmSelect (const muduo::net::TcpConnectionPtr&, const confirmSelectRequestPtr&,  muduo::Timestamp);
     void on_queueStatusRequest(const muduo::net::TcpConnectionPtr&, const queueStatusRequestPtr&, muduo::Timestamp);
+    void on_fastPath      (const muduo::net::TcpConnectionPtr&, const fastPathRequestPtr&,       muduo::Timestamp);
+    void on_shmAttach     (const muduo::net::TcpConnectionPtr&, const shmAttachRequestPtr&,      muduo::Timestamp);
+    // 热路径二进制帧（PUBLISH / ACK），不经 ProtobufDispatcher
+    void on_fastFrame     (const muduo::net::TcpConnectionPtr&, const fast_frame&,               muduo::Timestamp);
 
     virtual_host::ptr get_virtual_host() const { return __virtual_host; }
 private:
+    void check_queue_depth();   // 主循环定时调用
+
     std::unique_ptr<muduo::net::EventLoop>   __loop;
     std::unique_ptr<muduo::net::TcpServer>   __server;
 
     std::unique_ptr<ProtobufDispatcher>      __dispatcher;
     ProtobufCodecPtr                         __codec;
+    std::unique_ptr<arena_decoder>           __decoder;
 
     virtual_host::ptr                        __virtual_host;
     consumer_manager::ptr                    __consumer_manager;
     connection_manager::ptr                  __connection_manager;
     thread_pool::ptr                         __thread_pool;
+    cpu_placement                            __placement;
+    bool                                     __depth_paused{false};   // 只在主循环访问
 };
 
 } 
\ No newline at end of file
@@ -5,10 +5,15 @@
 #include "route.hpp"
 // ======================= channel.cpp =======================
 #include "channel.hpp"
+#include "arena_codec.hpp"
+#include "scatter_send.hpp"
 #include "muduo/protoc/codec.h"             
+#include "muduo/net/TcpConnection.h"
+#include "muduo/net/EventLoop.h"
 #include "../common/logger.hpp"    // 日志
 #include "../common/message.hpp"   // message_ptr
 
+#include <algorithm>
 #include <functional>
 #include <utility>
 
@@ -22,16 +27,38 @@ channel::channel(const std::string& cid,
                  const consumer_manager::ptr& cmp,
                  const ProtobufCodecPtr& codec,
                  const muduo::net::TcpConnectionPtr conn,
-                 const thread_pool::ptr& pool)
-    : __cid(cid), __conn(conn), __codec(codec), __cmp(cmp), __host(host), __pool(pool)
+                 const thread_pool::ptr& pool,
+                 const output_gate::ptr& gate,
+                 const body_codec& compression)
+    : __cid(cid), __conn(conn), __codec(codec), __cmp(cmp), __host(host), __pool(pool),
+      __publish_strand(std::make_shared<coro::strand>(pool)),
+      __dispatcher(std::make_shared<queue_dispatcher>(host, cmp, pool)),
+      __gate(gate),
+      __compression(compression),
+      __channel_window(std::make_shared<prefetch_window>())
 {
     // 初始没有 consumer
 }
 
 channel::~channel()
 {
-    if (__consumer) {
-        __cmp->remove(__consumer->tag, __consumer->qname);
+    for (auto& [tag, cp] : __consumers) {
+        __cmp->remove(tag, cp->qname);
+    }
+    // 未完成的 basic.get 等待者：抢先完成使派发器不再为它取消息；
+    // 已被派发器取到消息的由 complete 回调放回队列
+    for (auto& [qname, w] : __pull_waiters) {
+        if (!w->try_finish()) continue;
+        if (auto qc = __cmp->select(qname)) qc->pop_waiter(w);
+    }
+    // 通道 / 连接关闭：未确认的消息重新入队，交给其他消费者
+    std::vector<std::string> queues = requeue_unacked("");
+    for (auto& [tag, cp] : __consumers) {
+        if (std::find(queues.begin(), queues.end(), cp->qname) == queues.end())
+            queues.push_back(cp->qname);
+    }
+    for (const auto& qname : queues) {
+        __dispatcher->notify(qname);
     }
 }
 
@@ -40,50 +67,265 @@ channel::~channel()
 // -----------------------------------------------------------------------------
 void channel::basic_response(bool ok, const std::string& rid, const std::string& cid)
 {
-    basicCommonResponse resp;
-    resp.set_rid(rid);
-    resp.set_cid(cid);
-    resp.set_ok(ok);
-    __codec->send(__conn, resp);
+    response_arena arena;
+    basicCommonResponse* resp = arena.create<basicCommonResponse>();
+    resp->set_rid(rid);
+    resp->set_cid(cid);
+    resp->set_ok(ok);
+    __codec->send(__conn, *resp);
+}
+
+BasicProperties channel::delivery_properties(const BasicProperties& src, const std::string& qname,
+                                             const consumer::ptr& owner, bool track)
+{
+    BasicProperties props;
+    // 发布方未带 id（如 broker 内部生成的消息）时用数值 id 的十进制文本，客户端按 id 确认仍能找回
+    props.set_id(src.id().empty() ? std::to_string(src.numeric_id()) : src.id());
+    props.set_numeric_id(src.numeric_id());
+    props.set_delivery_mode(src.delivery_mode());
+    props.set_routing_key(src.routing_key());
+    props.set_redelivered(src.redelivered());
+    props.set_content_encoding(src.content_encoding());
+
+    // 手动确认：分配投递标签并登记为未确认
+    if (track) {
+        std::lock_guard<std::mutex> lk(__unacked_mtx);
+        uint64_t tag = ++__next_tag;
+        __unacked.emplace(tag, unacked_delivery{qname, src.numeric_id(), owner});
+        props.set_delivery_tag(tag);
+    }
+    return props;
+}
+
+const std::string& channel::wire_body(const std::string& body, BasicProperties* props,
+                                     std::string* packed) const
+{
+    // 发布方已自行编码的消息体原样转发
+    if (!props->content_encoding().empty() || !__compression.encode(body, packed)) return body;
+    props->set_content_encoding(ENCODING_DEFLATE);
+    return *packed;
 }
 
-void channel::consume(const std::string& qname)
+void channel::deliver(const consumer::ptr& cp, const message_ptr& mp)
 {
-    // 1. 取出消息
-    message_ptr mp = __host->basic_consume(qname);
-    if (!mp) {
-        LOG(ERROR) << "consume task: no message in queue [" << qname << "]"  ;
+    BasicProperties props = delivery_properties(mp->payload().properties(), cp->qname, cp,
+                                                !cp->auto_ack);
+
+    // 批量消费者：追加到待发批次，凑满条数 / 字节数即发出
+    basicDeliverBatch full;
+    {
+        std::lock_guard<std::mutex> lk(__batch_mtx);
+        auto it = __batches.find(cp->tag);
+        if (it != __batches.end()) {
+            delivery_batch& b = it->second;
+            deliveredMessage* m = b.frame.add_messages();
+            *m->mutable_properties() = std::move(props);
+            m->set_body(mp->payload().body());
+            b.bytes += m->body().size();
+            if (static_cast<uint32_t>(b.frame.messages_size()) < b.max_count &&
+                (b.max_bytes == 0 || b.bytes < b.max_bytes))
+                return;
+            full.Swap(&b.frame);
+            b.bytes = 0;
+        }
+    }
+    if (full.messages_size() > 0) {
+        send_batch(cp->tag, full);
         return;
     }
-    // 2. 选消费者
-    consumer::ptr cp = __cmp->choose(qname);
-    if (!cp) {
-        LOG(ERROR) << "consume task: no consumer for queue [" << qname << "]" ;
+
+    if (uint32_t no = fast_path()) {
+        if (send_fast_deliver(no, cp->tag, mp, props)) return;
+    }
+
+    // 响应构造在线程局部 Arena 上，send 同步序列化后随作用域回收
+    response_arena arena;
+    basicConsumeResponse* resp = arena.create<basicConsumeResponse>();
+    resp->set_cid(__cid);
+    resp->set_consumer_tag(cp->tag);
+    std::string packed;
+    const std::string& body = wire_body(mp->payload().body(), &props, &packed);
+    resp->mutable_properties()->Swap(&props);
+    if (packed.empty() && body.size() >= SCATTER_MIN_BODY) {
+        // 大消息体：不拷进响应，帧头与消息体分段发出
+        send_with_body(__conn, *resp, basicConsumeResponse::kBodyFieldNumber, mp);
         return;
     }
-    // 3. 调用回调投递消息
-    cp->callback(cp->tag, mp->mutable_payload()->mutable_properties(), mp->payload().body());
-    // 4. 自动 ack
-    if (cp->auto_ack) {
-        __host->basic_ack(qname, mp->payload().properties().id());
+    resp->set_body(body);
+    __codec->send(__conn, *resp);
+}
+
+bool channel::send_fast_deliver(uint32_t channel_no, const std::string& ctag, const message_ptr& mp,
+                                BasicProperties& props)
+{
+    // 先于 wire_body 检查：它会改写 props 的 content_encoding，回退 protobuf 时要保持原样
+    if (ctag.size() > FAST_MAX_FIELD || props.routing_key().size() > FAST_MAX_FIELD ||
+        props.id().size() > FAST_MAX_FIELD || mp->payload().body().size() > FAST_MAX_BODY)
+        return false;
+
+    std::string packed;
+    const std::string& body = wire_body(mp->payload().body(), &props, &packed);
+
+    fast_frame f;
+    f.opcode  = fast_op::DELIVER;
+    f.channel = channel_no;
+    f.tag     = props.delivery_tag();
+    if (props.delivery_mode() == DeliveryMode::DURABLE) f.flags |= FAST_FLAG_DURABLE;
+    if (props.redelivered()) f.flags |= FAST_FLAG_REDELIVERED;
+    if (props.content_encoding() == ENCODING_DEFLATE) f.flags |= FAST_FLAG_DEFLATE;
+    f.name = ctag;
+    f.key  = props.routing_key();
+    f.id   = props.id();
+    f.body = body;
+
+    // 线程局部编码缓冲：容量跨帧复用
+    thread_local std::string frame;
+    if (auto shm = std::atomic_load(&__shm)) {
+        // 同机客户端：帧头与消息体直接拷进共享环，不经 socket
+        frame.clear();
+        encode_fast_header(f, frame);
+        if (shm->send(frame, body)) return true;
+    }
+
+    if (packed.empty() && body.size() >= SCATTER_MIN_BODY) {
+        std::string head;
+        encode_fast_header(f, head);
+        send_scattered(__conn, std::move(head), mp, {});
+        return true;
     }
+
+    frame.clear();
+    encode_fast_frame(f, frame);
+    __conn->send(frame.data(), static_cast<int>(frame.size()));
+    return true;
 }
 
-void channel::consume_cb(const std::string& tag,
-                         const BasicProperties* bp,
-                         const std::string& body)
+void channel::on_flush(const consumer::ptr& cp)
 {
-    basicConsumeResponse resp;
-    resp.set_cid(__cid);
-    resp.set_consumer_tag(tag);
-    resp.set_body(body);
+    basicDeliverBatch frame;
+    {
+        std::lock_guard<std::mutex> lk(__batch_mtx);
+        auto it = __batches.find(cp->tag);
+        if (it == __batches.end() || it->second.frame.messages_size() == 0) return;
+        delivery_batch& b = it->second;
+        if (b.linger_ms > 0) {
+            // 未凑满：等待 linger，期间后续派发轮次的消息并入同一帧
+            if (b.timer_armed) return;
+            b.timer_armed = true;
+            std::weak_ptr<channel> weak_self = shared_from_this();
+            std::string ctag = cp->tag;
+            __conn->getLoop()->runAfter(b.linger_ms / 1000.0, [weak_self, ctag] {
+                if (auto self = weak_self.lock()) self->flush_batch(ctag);
+            });
+            return;
+        }
+        frame.Swap(&b.frame);
+        b.bytes = 0;
+    }
+    send_batch(cp->tag, frame);
+}
 
-    if (bp) {
-        resp.mutable_properties()->set_id(bp->id());
-        resp.mutable_properties()->set_delivery_mode(bp->delivery_mode());
-        resp.mutable_properties()->set_routing_key(bp->routing_key());
+void channel::flush_batch(const std::string& ctag)
+{
+    basicDeliverBatch frame;
+    {
+        std::lock_guard<std::mutex> lk(__batch_mtx);
+        auto it = __batches.find(ctag);
+        if (it == __batches.end()) return;
+        it->second.timer_armed = false;
+        frame.Swap(&it->second.frame);
+        it->second.bytes = 0;
     }
-    __codec->send(__conn, resp);
+    if (frame.messages_size() > 0) send_batch(ctag, frame);
+}
+
+void channel::send_batch(const std::string& ctag, basicDeliverBatch& frame)
+{
+    // 待发批次每次被 Swap 走后只剩空帧，tag 在这里统一填写
+    frame.set_cid(__cid);
+    frame.set_consumer_tag(ctag);
+    if (__compression.enabled) {
+        // 整帧压缩：同一批消息的重复字段（JSON 键名等）一起参与字典匹配
+        basicDeliverBatch inner;
+        inner.mutable_messages()->Swap(frame.mutable_messages());
+        std::string packed;
+        if (__compression.encode(inner.SerializeAsString(), &packed)) {
+            frame.set_encoding(ENCODING_DEFLATE);
+            frame.set_packed(std::move(packed));
+        } else {
+            frame.mutable_messages()->Swap(inner.mutable_messages());
+        }
+    }
+    __codec->send(__conn, frame);
+}
+
+bool channel::settle(const std::string& qname, uint64_t msg_id)
+{
+    bool found = false;
+    consumer::ptr owner;
+    {
+        std::lock_guard<std::mutex> lk(__unacked_mtx);
+        for (auto it = __unacked.begin(); it != __unacked.end(); ++it) {
+            if (it->second.qname == qname && it->second.msg_id == msg_id) {
+                owner = std::move(it->second.owner);
+                __unacked.erase(it);
+                found = true;
+                break;
+            }
+        }
+    }
+    if (owner) owner->release_credit();
+    return found;
+}
+
+std::vector<channel::unacked_delivery> channel::settle_tags(uint64_t tag, bool multiple)
+{
+    std::vector<unacked_delivery> settled;
+    {
+        std::lock_guard<std::mutex> lk(__unacked_mtx);
+        if (multiple) {
+            auto end = __unacked.upper_bound(tag);
+            for (auto it = __unacked.begin(); it != end; ++it)
+                settled.push_back(std::move(it->second));
+            __unacked.erase(__unacked.begin(), end);
+        } else {
+            auto it = __unacked.find(tag);
+            if (it != __unacked.end()) {
+                settled.push_back(std::move(it->second));
+                __unacked.erase(it);
+            }
+        }
+    }
+    for (auto& d : settled) {
+        if (d.owner) d.owner->release_credit();
+    }
+    return settled;
+}
+
+std::vector<std::string> channel::requeue_unacked(const std::string& owner_tag)
+{
+    std::vector<unacked_delivery> taken;
+    {
+        std::lock_guard<std::mutex> lk(__unacked_mtx);
+        for (auto it = __unacked.begin(); it != __unacked.end();) {
+            if (owner_tag.empty() || (it->second.owner && it->second.owner->tag == owner_tag)) {
+                taken.push_back(std::move(it->second));
+                it = __unacked.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // 逆序 push_front，放回后仍保持原投递顺序；超过重试上限转入死信的消息，其死信队列一并返回
+    std::vector<std::string> queues;
+    for (auto it = taken.rbegin(); it != taken.rend(); ++it) {
+        __host->basic_requeue(it->qname, it->msg_id, &queues);
+        if (it->owner) it->owner->release_credit();
+        if (std::find(queues.begin(), queues.end(), it->qname) == queues.end())
+            queues.push_back(it->qname);
+    }
+    return queues;
 }
 
 // -----------------------------------------------------------------------------
@@ -115,7 +357,7 @@ void channel::declare_queue(const declareQueueRequestPtr& req)
         basic_response(false, req->rid(), req->cid());
         return;
     }
-    __cmp->init_queue_consumer(req->queue_name());
+    __cmp->init_queue_consumer(req->queue_name(), args_map);
     basic_response(true, req->rid(), req->cid());
 }
 
@@ -137,7 +379,7 @@ void channel::declare_queue_with_dlq(const declareQueueWithDLQRequestPtr& req)
         basic_response(false, req->rid(), req->cid());
         return;
     }
-    __cmp->init_queue_consumer(req->queue_name());
+    __cmp->init_queue_consumer(req->queue_name(), args_map);
     basic_response(true, req->rid(), req->cid());
 }
 
@@ -167,12 +409,155 @@ void channel::unbind(const unbindRequestPtr& req)
 // Message ops
 // -----------------------------------------------------------------------------
 void channel::basic_publish(const basicPublishRequestPtr& req)
+{
+    bool ok = publish_and_dispatch(req);
+    if (!req->no_response()) basic_response(ok, req->rid(), req->cid());
+}
+
+coro::detached_task channel::basic_publish_async(basicPublishRequestPtr req)
+{
+    auto self = shared_from_this();   // 协程挂起期间保活 channel
+
+    // 确认模式：按到达顺序编号；strand 串行执行，完成顺序与编号一致
+    uint64_t seq = __confirm_mode ? ++__publish_seq : 0;
+
+    // 不会落盘（交换机未绑定持久化队列）且前面没有未完成的发布：直接在 Reactor 上完成
+    bool durable = __host->binds_durable_queue(req->exchange_name());
+    if (!durable && __publish_strand->idle()) {
+        bool ok = publish_and_dispatch(req);
+        if (seq) confirm(seq, ok);
+        else if (!req->no_response()) basic_response(ok, req->rid(), req->cid());
+        co_return;
+    }
+
+    muduo::net::EventLoop* loop = __conn->getLoop();
+    co_await coro::resume_on(__publish_strand);   // 落盘在线程池上串行执行
+    bool ok = publish_and_dispatch(req);
+    co_await coro::resume_in_loop(loop);          // 回到连接所属线程发送响应
+    if (seq) confirm(seq, ok);
+    else if (!req->no_response()) basic_response(ok, req->rid(), req->cid());
+}
+
+coro::detached_task channel::basic_publish_batch_async(basicPublishBatchRequestPtr req)
+{
+    auto self = shared_from_this();
+
+    if (!req->encoding().empty() && !unpack_batch(req.get())) {
+        LOG(WARNING) << "cannot unpack publish batch, encoding [" << req->encoding() << "]";
+        basic_response(false, req->rid(), req->cid());
+        co_return;
+    }
+
+    // 确认模式：每条消息各占一个序号，整批连续编号
+    uint64_t first_seq = 0;
+    if (__confirm_mode && req->entries_size() > 0) {
+        first_seq = __publish_seq + 1;
+        __publish_seq += static_cast<uint64_t>(req->entries_size());
+    }
+
+    bool durable = __host->binds_durable_queue(req->exchange_name());
+    if (!durable && __publish_strand->idle()) {
+        respond_batch(req, first_seq, publish_batch_and_dispatch(req));
+        co_return;
+    }
+
+    muduo::net::EventLoop* loop = __conn->getLoop();
+    co_await coro::resume_on(__publish_strand);
+    std::vector<bool> results = publish_batch_and_dispatch(req);
+    co_await coro::resume_in_loop(loop);
+    respond_batch(req, first_seq, results);
+}
+
+bool channel::unpack_batch(basicPublishBatchRequest* req) const
+{
+    std::string packed = std::move(*req->mutable_packed());
+    req->clear_packed();
+    if (req->encoding() != ENCODING_DEFLATE) return false;
+    req->clear_encoding();
+
+    std::string raw;
+    if (!__compression.decode(packed, &raw, MAX_FRAME_BYTES)) return false;
+    // packed 是只含 entries 的同类消息：直接 Merge 到原请求（同一 Arena）上
+    return req->MergeFromString(raw) && req->encoding().empty();
+}
+
+void channel::respond_batch(const basicPublishBatchRequestPtr& req, uint64_t first_seq,
+                            const std::vector<bool>& results)
+{
+    if (first_seq) {
+        for (size_t i = 0; i < results.size(); ++i) confirm(first_seq + i, results[i]);
+        return;
+    }
+    bool ok = std::all_of(results.begin(), results.end(), [](bool r) { return r; });
+    basic_response(ok, req->rid(), req->cid());
+}
+
+std::vector<bool> channel::publish_batch_and_dispatch(const basicPublishBatchRequestPtr& req)
+{
+    std::vector<bool> results;
+    std::vector<std::string> touched;
+    __host->publish_batch_to_exchange(req->exchange_name(), req->mutable_entries(), &results, &touched);
+    // 每个队列只唤醒一次派发
+    for (const auto& qname : touched) {
+        __dispatcher->notify(qname);
+    }
+    return results;
+}
+
+void channel::confirm_select(const confirmSelectRequestPtr& req)
+{
+    __confirm_mode = true;
+    basic_response(true, req->rid(), req->cid());
+}
+
+void channel::confirm(uint64_t seq, bool ok)
+{
+    __confirm_done[seq] = ok;
+    if (__confirm_flush_scheduled) return;
+
+    // 本轮事件循环内完成的发布合并为一帧，在处理完当前读事件后统一发出
+    __confirm_flush_scheduled = true;
+    std::weak_ptr<channel> weak_self = shared_from_this();
+    __conn->getLoop()->queueInLoop([weak_self] {
+        if (auto self = weak_self.lock()) self->flush_confirms();
+    });
+}
+
+void channel::flush_confirms()
+{
+    __confirm_flush_scheduled = false;
+
+    // 只发出从 __confirm_sent 起连续完成的一段；连续的 ack 合并为一条 multiple 帧，
+    // 后完成的编号要等前面的空洞补齐（inline 发布可能先于 strand 上的发布回到 loop）
+    uint64_t ack_upto = 0;
+    auto send = [this](uint64_t tag, bool nack) {
+        basicConfirm frame;
+        frame.set_cid(__cid);
+        frame.set_delivery_tag(tag);
+        frame.set_multiple(!nack);
+        frame.set_nack(nack);
+        __codec->send(__conn, frame);
+    };
+    for (auto it = __confirm_done.begin();
+         it != __confirm_done.end() && it->first == __confirm_sent + 1;
+         it = __confirm_done.erase(it)) {
+        __confirm_sent = it->first;
+        if (it->second) {
+            ack_upto = it->first;
+            continue;
+        }
+        if (ack_upto) { send(ack_upto, false); ack_upto = 0; }
+        send(it->first, true);
+    }
+    if (ack_upto) send(ack_upto, false);
+}
+
+bool channel::publish_and_dispatch(const basicPublishRequestPtr& req)
 {
     // 1. exchange 必须存在
     auto ep = __host->select_exchange(req->exchange_name());
     if (!ep) {
-        basic_response(false, req->rid(), req->cid());
-        return;
+        return false;
     }
 
     // 2. 使用publish_to_exchange方法，支持所有交换机类型
@@ -183,35 +568,134 @@ void channel::basic_publish(const basicPublishRequestPtr& req)
 
     bool published = __host->publish_to_exchange(req->exchange_name(), properties, req->body());
     
-    // 3. 如果有消息投递成功，异步派发消费任务
+    // 3. 如果有消息投递成功，唤醒各绑定队列的派发器
     if (published) {
         auto bindings = __host->exchange_bindings(req->exchange_name());
         for (const auto& [qname, _] : bindings) {
-            auto task = std::bind(&channel::consume, this, qname);
-            __pool->push(task);
+            __dispatcher->notify(qname);
         }
     }
     
-    basic_response(true, req->rid(), req->cid());
+    // 没有命中任何队列或写盘失败：确认模式回 nack
+    return published;
+}
+
+bool channel::ack_tags(uint64_t tag, bool multiple)
+{
+    // 按投递标签确认：multiple 一帧确认一整段
+    auto settled = settle_tags(tag, multiple);
+    std::vector<std::string> queues;
+    for (const auto& d : settled) {
+        __host->basic_ack(d.qname, d.msg_id);
+        if (std::find(queues.begin(), queues.end(), d.qname) == queues.end())
+            queues.push_back(d.qname);
+    }
+    for (const auto& qname : queues) __dispatcher->notify(qname);
+    return !settled.empty();
 }
 
 void channel::basic_ack(const basicAckRequestPtr& req)
 {
-    __host->basic_ack(req->queue_name(), req->message_id());
-    basic_response(true, req->rid(), req->cid());
+    if (req->delivery_tag() != 0) {
+        bool ok = ack_tags(req->delivery_tag(), req->multiple());
+        if (!req->no_response()) basic_response(ok, req->rid(), req->cid());
+        return;
+    }
+
+    // 按消息 id 确认：优先用数值 id，旧客户端只带字符串 id 时线性查找一次
+    uint64_t id = req->numeric_id() != 0 ? req->numeric_id()
+                                         : __host->lookup_id(req->queue_name(), req->message_id());
+    bool tracked = id != 0 && settle(req->queue_name(), id);
+    if (id != 0) __host->basic_ack(req->queue_name(), id);
+    else __host->basic_ack(req->queue_name(), req->message_id());   // 保留空 id 删除队首的旧语义
+    if (!req->no_response()) basic_response(true, req->rid(), req->cid());
+    // 归还了预取额度：继续派发积压的消息
+    if (tracked) __dispatcher->notify(req->queue_name());
+}
+
+void channel::fast_ack(const fast_frame& f)
+{
+    ack_tags(f.tag, f.has(FAST_FLAG_MULTIPLE));
+}
+
+void channel::fast_publish(const fast_frame& f)
+{
+    // 转为无响应的 basicPublishRequest，复用持久化排序与确认模式编号
+    auto req = std::make_shared<basicPublishRequest>();
+    req->set_cid(__cid);
+    req->set_exchange_name(std::string(f.name));
+    req->set_body(std::string(f.body));
+    req->set_no_response(true);
+    BasicProperties* props = req->mutable_properties();
+    props->set_routing_key(std::string(f.key));
+    if (!f.id.empty()) props->set_id(std::string(f.id));
+    if (f.has(FAST_FLAG_DEFLATE)) props->set_content_encoding(ENCODING_DEFLATE);
+    props->set_delivery_mode(f.has(FAST_FLAG_DURABLE) ? DeliveryMode::DURABLE
+                                                      : DeliveryMode::UNDURABLE);
+    basic_publish_async(std::move(req));
 }
 
 // 新增：消息拒绝（NACK）处理
 void channel::basic_nack(const basicNackRequestPtr& req)
 {
-    __host->basic_nack(req->queue_name(), req->message_id(), req->requeue(), req->reason());
-    basic_response(true, req->rid(), req->cid());
+    if (req->delivery_tag() != 0) {
+        auto settled = settle_tags(req->delivery_tag(), req->multiple());
+        std::vector<std::string> queues;
+        // 逆序处理：requeue 时 push_front 仍保持原投递顺序
+        for (auto it = settled.rbegin(); it != settled.rend(); ++it) {
+            __host->basic_nack(it->qname, it->msg_id, req->requeue(), req->reason(), &queues);
+            if (std::find(queues.begin(), queues.end(), it->qname) == queues.end())
+                queues.push_back(it->qname);
+        }
+        if (!req->no_response()) basic_response(!settled.empty(), req->rid(), req->cid());
+        for (const auto& qname : queues) __dispatcher->notify(qname);
+        return;
+    }
+
+    uint64_t id = req->numeric_id() != 0 ? req->numeric_id()
+                                         : __host->lookup_id(req->queue_name(), req->message_id());
+    bool tracked = id != 0 && settle(req->queue_name(), id);
+    std::vector<std::string> dead_lettered;   // 消息转入的死信队列，需唤醒其分发器
+    if (id != 0) __host->basic_nack(req->queue_name(), id, req->requeue(), req->reason(), &dead_lettered);
+    if (!req->no_response()) basic_response(true, req->rid(), req->cid());
+    if (tracked || req->requeue()) __dispatcher->notify(req->queue_name());
+    for (const auto& qname : dead_lettered) __dispatcher->notify(qname);
 }
 
-void channel::basic_nack(const basicNackRequestPtr& req)
+void channel::basic_qos(const basicQosRequestPtr& req)
 {
-    __host->basic_nack(req->queue_name(), req->message_id(), req->requeue(), req->reason());
+    if (req->global()) {
+        __channel_window->limit.store(req->prefetch_count(), std::memory_order_relaxed);
+    } else {
+        __consumer_prefetch = req->prefetch_count();
+        for (auto& [_, cp] : __consumers) {
+            cp->window->limit.store(__consumer_prefetch, std::memory_order_relaxed);
+        }
+    }
     basic_response(true, req->rid(), req->cid());
+    // 窗口可能被放大：唤醒各订阅队列的派发
+    for (auto& [_, cp] : __consumers) {
+        __dispatcher->notify(cp->qname);
+    }
+}
+
+void channel::basic_credit(const basicCreditRequestPtr& req)
+{
+    auto it = __consumers.find(req->consumer_tag());
+    if (it == __consumers.end() || !it->second->credit) {
+        basic_response(false, req->rid(), req->cid());
+        return;
+    }
+    it->second->credit->grant(req->message_credit(), req->byte_credit());
+    if (!req->no_response()) basic_response(true, req->rid(), req->cid());
+    __dispatcher->notify(it->second->qname);
+}
+
+void channel::resume_delivery()
+{
+    for (auto& [_, cp] : __consumers) {
+        __dispatcher->notify(cp->qname);
+    }
 }
 
 void channel::basic_consume(const basicConsumeRequestPtr& req)
@@ -221,16 +705,96 @@ void channel::basic_consume(const basicConsumeRequestPtr& req)
         return;
     }
 
-    auto cb = std::bind(&channel::consume_cb, this, std::placeholders::_1,
-                        std::placeholders::_2, std::placeholders::_3);
-    __consumer = __cmp->create(req->consumer_tag(), req->queue_name(),
-                               req->auto_ack(), cb);
+    auto cp = std::make_shared<consumer>(req->consumer_tag(), req->queue_name(),
+                                         req->auto_ack(), consumer_callback{});
+    cp->window = std::make_shared<prefetch_window>();
+    cp->window->limit = req->prefetch_count() ? req->prefetch_count() : __consumer_prefetch;
+    cp->channel_window = __channel_window;
+    cp->gate = __gate;
+    if (req->credit_flow()) cp->credit = std::make_shared<flow_credit>();
+    auto wit = req->args().find("x-weight");
+    if (wit != req->args().end()) {
+        try {
+            cp->weight = static_cast<uint32_t>(std::max(1L, std::stol(wit->second)));
+        } catch (const std::exception&) {
+            LOG(WARNING) << "invalid x-weight [" << wit->second << "], use 1";
+        }
+    }
+    auto pit = req->args().find("x-priority");
+    if (pit != req->args().end()) {
+        try {
+            cp->priority = std::stoi(pit->second);
+        } catch (const std::exception&) {
+            LOG(WARNING) << "invalid x-priority [" << pit->second << "], use 0";
+        }
+    }
+
+    // 投递在线程池中进行；channel 已关闭时把消息放回队列
+    std::weak_ptr<channel> weak_self = shared_from_this();
+    cp->deliver = [weak_self, host = __host, dispatcher = __dispatcher](const consumer::ptr& c,
+                                                                        const message_ptr& mp) {
+        if (auto self = weak_self.lock()) {
+            self->deliver(c, mp);
+        } else if (!c->auto_ack) {
+            std::vector<std::string> dead_lettered;
+            host->basic_requeue(c->qname, mp->payload().properties().numeric_id(), &dead_lettered);
+            c->release_credit();
+            for (const auto& qname : dead_lettered) dispatcher->notify(qname);
+        }
+    };
+
+    if (req->batch_max_count() > 1) {
+        delivery_batch b;
+        b.max_count = req->batch_max_count();
+        b.max_bytes = req->batch_max_bytes();
+        b.linger_ms = req->batch_linger_ms();
+        {
+            std::lock_guard<std::mutex> lk(__batch_mtx);
+            __batches[cp->tag] = std::move(b);
+        }
+        cp->flush = [weak_self](const consumer::ptr& c) {
+            if (auto self = weak_self.lock()) self->on_flush(c);
+        };
+    }
+
+    if (!__cmp->create(cp)) {
+        if (cp->flush) {
+            std::lock_guard<std::mutex> lk(__batch_mtx);
+            __batches.erase(cp->tag);
+        }
+        basic_response(false, req->rid(), req->cid());
+        return;
+    }
+    __consumers[cp->tag] = cp;
     basic_response(true, req->rid(), req->cid());
+    __dispatcher->notify(cp->qname);   // 队列中可能已有积压消息
 }
 
 void channel::basic_cancel(const basicCancelRequestPtr& req)
 {
     __cmp->remove(req->consumer_tag(), req->queue_name());
+    auto cit = __consumers.find(req->consumer_tag());
+    bool auto_ack = cit != __consumers.end() && cit->second->auto_ack;
+    if (cit != __consumers.end()) __consumers.erase(cit);
+
+    // 未发出的批次：auto_ack 消息已出队，照常发出；手动确认的随下面的未确认消息一起重新入队
+    basicDeliverBatch pending;
+    {
+        std::lock_guard<std::mutex> lk(__batch_mtx);
+        auto bit = __batches.find(req->consumer_tag());
+        if (bit != __batches.end()) {
+            if (auto_ack) pending.Swap(&bit->second.frame);
+            __batches.erase(bit);
+        }
+    }
+    if (pending.messages_size() > 0) send_batch(req->consumer_tag(), pending);
+
+    // 消费者取消：其未确认的消息重新入队；
+    // 同时唤醒派发（single-active 模式下由下一个消费者接管积压）
+    for (const auto& qname : requeue_unacked(req->consumer_tag())) {
+        if (qname != req->queue_name()) __dispatcher->notify(qname);
+    }
+    __dispatcher->notify(req->queue_name());
     basic_response(true, req->rid(), req->cid());
 }
 
@@ -244,6 +808,79 @@ void channel::basic_query(const basicQueryRequestPtr& req)
     __codec->send(__conn, resp);
 }
 
+void channel::basic_get(const basicGetRequestPtr& req)
+{
+    const std::string& qname = req->queue_name();
+    queue_consumer::ptr qc = __cmp->select(qname);
+    if (!qc || !__host->exists_queue(qname)) {
+        basicGetResponse resp;
+        resp.set_rid(req->rid());
+        resp.set_cid(__cid);
+        resp.set_ok(false);
+        __codec->send(__conn, resp);
+        return;
+    }
+
+    uint32_t max_count = std::max<uint32_t>(req->max_count(), 1);
+    bool auto_ack = req->auto_ack();
+    auto msgs = __host->basic_get(qname, max_count, auto_ack);
+    if (!msgs.empty() || req->max_wait_ms() == 0) {
+        send_get_response(req->rid(), qname, auto_ack, msgs);
+        return;
+    }
+
+    // 队列为空：登记等待者后立即返回；消息到达由派发器完成，超时由定时器完成。
+    // 派发器一律按未确认取出，auto_ack 在响应发出后才确认，channel 已关闭时可以整批放回
+    auto w = std::make_shared<pull_waiter>();
+    w->max_count = max_count;
+    w->auto_ack  = false;
+    std::weak_ptr<channel> weak_self = shared_from_this();
+    w->complete = [weak_self, host = __host, dispatcher = __dispatcher, rid = req->rid(), qname,
+                   auto_ack](std::vector<message_ptr>&& got) {
+        if (auto self = weak_self.lock()) {
+            self->send_get_response(rid, qname, auto_ack, got);
+            if (auto_ack) {
+                for (const auto& mp : got) host->basic_ack(qname, mp->payload().properties().numeric_id());
+            }
+            return;
+        }
+        if (got.empty()) return;
+        // channel 已关闭：逆序放回队首，交给其他消费者
+        std::vector<std::string> queues{qname};
+        for (auto it = got.rbegin(); it != got.rend(); ++it)
+            host->basic_requeue(qname, (*it)->payload().properties().numeric_id(), &queues);
+        for (const auto& q : queues) dispatcher->notify(q);
+    };
+    __pull_waiters.erase(std::remove_if(__pull_waiters.begin(), __pull_waiters.end(),
+                                        [](const auto& p) { return p.second->done.load(); }),
+                         __pull_waiters.end());
+    __pull_waiters.emplace_back(qname, w);
+    qc->add_waiter(w);
+    __conn->getLoop()->runAfter(req->max_wait_ms() / 1000.0, [w] {
+        if (w->try_finish()) w->complete({});
+    });
+    __dispatcher->notify(qname);   // 登记前可能恰好有消息到达
+}
+
+void channel::send_get_response(const std::string& rid, const std::string& qname, bool auto_ack,
+                                const std::vector<message_ptr>& msgs)
+{
+    response_arena arena;
+    basicGetResponse* resp = arena.create<basicGetResponse>();
+    resp->set_rid(rid);
+    resp->set_cid(__cid);
+    resp->set_ok(true);
+    for (const auto& mp : msgs) {
+        deliveredMessage* m = resp->add_messages();
+        BasicProperties props = delivery_properties(mp->payload().properties(), qname,
+                                                    nullptr, !auto_ack);
+        std::string packed;
+        m->set_body(wire_body(mp->payload().body(), &props, &packed));
+        m->mutable_properties()->Swap(&props);
+    }
+    __codec->send(__conn, *resp);
+}
+
 // -----------------------------------------------------------------------------
 // channel_manager
 // -----------------------------------------------------------------------------
@@ -252,19 +889,34 @@ bool channel_manager::open_channel(const std::string& cid,
                                    const consumer_manager::ptr& cmp,
                                    const ProtobufCodecPtr& codec,
                                    const muduo::net::TcpConnectionPtr conn,
-                                   const thread_pool::ptr& pool)
+                                   const thread_pool::ptr& pool,
+                                   const output_gate::ptr& gate,
+                                   const body_codec& compression)
 {
     std::unique_lock<std::mutex> lock(__mtx);
     if (__channels.count(cid) != 0) return false;
 
-    __channels[cid] = std::make_shared<channel>(cid, host, cmp, codec, conn, pool);
+    __channels[cid] = std::make_shared<channel>(cid, host, cmp, codec, conn, pool, gate, compression);
     return true;
 }
 
+void channel_manager::resume_delivery()
+{
+    std::vector<channel::ptr> channels;
+    {
+        std::unique_lock<std::mutex> lock(__mtx);
+        for (auto& [_, ch] : __channels) channels.push_back(ch);
+    }
+    for (auto& ch : channels) ch->resume_delivery();
+}
+
 void channel_manager::close_channel(const std::string& cid)
 {
     std::unique_lock<std::mutex> lock(__mtx);
-    __channels.erase(cid);
+    auto it = __channels.find(cid);
+    if (it == __channels.end()) return;
+    if (uint32_t no = it->second->fast_path()) __fast_channels.erase(no);
+    __channels.erase(it);
 }
 
 channel::ptr channel_manager::select_channel(const std::string& cid)
@@ -274,4 +926,25 @@ channel::ptr channel_manager::select_channel(const std::string& cid)
     return (it == __channels.end()) ? nullptr : it->second;
 }
 
+uint32_t channel_manager::enable_fast_path(const std::string& cid)
+{
+    std::unique_lock<std::mutex> lock(__mtx);
+    auto it = __channels.find(cid);
+    if (it == __channels.end()) return 0;
+    uint32_t no = it->second->fast_path();
+    if (no == 0) {
+        no = ++__next_fast_no;
+        __fast_channels[no] = it->second;
+        it->second->enable_fast_path(no);
+    }
+    return no;
+}
+
+channel::ptr channel_manager::select_channel(uint32_t channel_no)
+{
+    std::unique_lock<std::mutex> lock(__mtx);
+    auto it = __fast_channels.find(channel_no);
+    return (it == __fast_channels.end()) ? nullptr : it->second;
+}
+
 } 
@@ -1,16 +1,26 @@
 // ======================= channel.hpp =======================
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "../common/msg.pb.h"     // 请求/响应 Protobuf
 #include "../common/protocol.pb.h"
 
 #include "consumer.hpp"
+#include "dispatcher.hpp"
 #include "virtual_host.hpp"
 #include "../common/thread_pool.hpp"
+#include "loop_task.hpp"
+#include "../common/fast_frame.hpp"
+#include "../common/body_codec.hpp"
+#include "shm_endpoint.hpp"
 #include "muduo/protoc/codec.h"
 
 // --- 前向声明以减少编译依赖 --------------------------------------
@@ -43,14 +53,21 @@ using basicAckRequestPtr       = std::shared_ptr<basicAckRequest>;
 using basicConsumeRequestPtr   = std::shared_ptr<basicConsumeRequest>;
 using basicCancelRequestPtr    = std::shared_ptr<basicCancelRequest>;
 using basicQueryRequestPtr     = std::shared_ptr<basicQueryRequest>;
+using basicGetRequestPtr       = std::shared_ptr<basicGetRequest>;
 using basicCommonResponsePtr   = std::shared_ptr<basicCommonResponse>;
 using declareQueueWithDLQRequestPtr = std::shared_ptr<declareQueueWithDLQRequest>;
 using basicNackRequestPtr = std::shared_ptr<basicNackRequest>;
+using basicQosRequestPtr       = std::shared_ptr<basicQosRequest>;
+using confirmSelectRequestPtr  = std::shared_ptr<confirmSelectRequest>;
+using basicCreditRequestPtr    = std::shared_ptr<basicCreditRequest>;
+using basicPublishBatchRequestPtr = std::shared_ptr<basicPublishBatchRequest>;
+using fastPathRequestPtr       = std::shared_ptr<fastPathRequest>;
+using shmAttachRequestPtr      = std::shared_ptr<shmAttachRequest>;
 
 // =================================================================
 // channel : 表示一条逻辑通道（AMQP 风格）
 // =================================================================
-class channel {
+class channel : public std::enable_shared_from_this<channel> {
 public:
     using ptr = std::shared_ptr<channel>;
 
@@ -59,7 +76,9 @@ public:
             const consumer_manager::ptr& cmp,
             const ProtobufCodecPtr& codec,
             const muduo::net::TcpConnectionPtr conn,
-            const thread_pool::ptr& pool);
+            const thread_pool::ptr& pool,
+            const output_gate::ptr& gate = nullptr,
+            const body_codec& compression = {});
     ~channel();
 
     // ------------------- Exchange -------------------
@@ -77,25 +96,117 @@ public:
 
     // ------------------- Message --------------------
     void basic_publish(const basicPublishRequestPtr& req);
+    // 协程版发布：持久化消息在 strand 上落盘，完成后回到 EventLoop 发送响应
+    coro::detached_task basic_publish_async(basicPublishRequestPtr req);
+    // 批量发布：整批一次路由、一条响应；含持久化消息时同样在 strand 上落盘
+    coro::detached_task basic_publish_batch_async(basicPublishBatchRequestPtr req);
     void basic_ack(const basicAckRequestPtr& req);
     void basic_consume(const basicConsumeRequestPtr& req);
     void basic_cancel(const basicCancelRequestPtr& req);
     void basic_query(const basicQueryRequestPtr& req);
+    // 长轮询批量拉取：队列为空时登记等待者，不占用线程
+    void basic_get(const basicGetRequestPtr& req);
     void basic_nack(const basicNackRequestPtr& req);
+    void basic_qos(const basicQosRequestPtr& req);
+    void confirm_select(const confirmSelectRequestPtr& req);
+    void basic_credit(const basicCreditRequestPtr& req);
+    // 连接输出缓冲写空：唤醒本通道各消费者所在队列的派发
+    void resume_delivery();
+
+    // ------------------- 热路径二进制帧 -------------
+    // 协商后非批量投递改发 DELIVER 帧；PUBLISH / ACK 帧由连接按 channel 号转交
+    void enable_fast_path(uint32_t channel_no) { __fast_no.store(channel_no, std::memory_order_release); }
+    uint32_t fast_path() const { return __fast_no.load(std::memory_order_acquire); }
+    void fast_publish(const fast_frame& f);
+    void fast_ack(const fast_frame& f);
+    // 连接附加了共享内存传输：DELIVER 帧优先写入 S2C 环，环满时仍走 TCP
+    void enable_shm(const shm_endpoint::ptr& shm) { std::atomic_store(&__shm, shm); }
 private:
+    // 已投递、等待客户端确认的消息
+    struct unacked_delivery {
+        std::string   qname;
+        uint64_t      msg_id{0};    // properties.numeric_id
+        consumer::ptr owner;        // basic.get 拉取的消息为空
+    };
+
+    // 批量投递：每个开启批量的消费者一个待发批次
+    struct delivery_batch {
+        uint32_t          max_count{0};
+        uint32_t          max_bytes{0};
+        uint32_t          linger_ms{0};
+        bool              timer_armed{false};
+        size_t            bytes{0};
+        basicDeliverBatch frame;
+    };
+
     // helpers ------------------------------------------------------
     void basic_response(bool ok, const std::string& rid, const std::string& cid);
-    void consume(const std::string& qname); // 在线程池中执行
-    void consume_cb(const std::string& tag, const BasicProperties* bp, const std::string& body);
+    bool publish_and_dispatch(const basicPublishRequestPtr& req);
+    std::vector<bool> publish_batch_and_dispatch(const basicPublishBatchRequestPtr& req);
+    void respond_batch(const basicPublishBatchRequestPtr& req, uint64_t first_seq,
+                       const std::vector<bool>& results);
+    void deliver(const consumer::ptr& cp, const message_ptr& mp);
+    // 字段超出二进制帧可表示的长度时不发送并返回 false，由调用方改走 protobuf
+    bool send_fast_deliver(uint32_t channel_no, const std::string& ctag, const message_ptr& mp,
+                           BasicProperties& props);
+    // 协商了压缩：达到阈值且未带 content_encoding 的消息体压缩到 packed 并标注编码，
+    // 返回实际要发送的消息体
+    const std::string& wire_body(const std::string& body, BasicProperties* props,
+                                 std::string* packed) const;
+    // 解开整批压缩的批量发布帧，失败返回 false
+    bool unpack_batch(basicPublishBatchRequest* req) const;
+    // 按投递标签确认并唤醒相关队列，返回是否确认到消息
+    bool ack_tags(uint64_t tag, bool multiple);
+    void on_flush(const consumer::ptr& cp);            // 一轮派发结束
+    void flush_batch(const std::string& ctag);         // linger 定时器到期
+    void send_batch(const std::string& ctag, basicDeliverBatch& frame);   // 每帧都带上 consumer tag
+    void send_get_response(const std::string& rid, const std::string& qname, bool auto_ack,
+                           const std::vector<message_ptr>& msgs);
+    BasicProperties delivery_properties(const BasicProperties& src, const std::string& qname,
+                                        const consumer::ptr& owner, bool track);
+    void confirm(uint64_t seq, bool ok);               // 仅在连接所属 EventLoop 线程调用
+    void flush_confirms();
+    // 按 queue + msg_id 摘除一条未确认记录并归还预取额度；找不到返回 false
+    bool settle(const std::string& qname, uint64_t msg_id);
+    // 按投递标签摘除（multiple 时摘除 <= tag 的全部），归还预取额度
+    std::vector<unacked_delivery> settle_tags(uint64_t tag, bool multiple);
+    // 把 owner 名下（为空则全部）未确认消息按投递逆序放回队首，返回涉及的队列
+    std::vector<std::string> requeue_unacked(const std::string& owner_tag);
 
     // data ---------------------------------------------------------
     std::string                    __cid;
-    consumer::ptr                  __consumer;   // 若该通道作消费者
+    std::unordered_map<std::string, consumer::ptr> __consumers;   // 本通道创建的消费者：tag → consumer
     muduo::net::TcpConnectionPtr   __conn;
     ProtobufCodecPtr               __codec;
     consumer_manager::ptr          __cmp;
     virtual_host::ptr              __host;
     thread_pool::ptr               __pool;
+    coro::strand::ptr              __publish_strand;   // 保证本 channel 发布顺序
+    queue_dispatcher::ptr          __dispatcher;       // 队列推送（不持有 channel，关闭后仍可安全使用）
+    output_gate::ptr               __gate;             // 所属连接的输出缓冲状态
+    std::atomic<uint32_t>          __fast_no{0};       // 协商的二进制帧 channel 号，0 表示未启用
+    shm_endpoint::ptr              __shm;              // 经 std::atomic_load / atomic_store 访问
+    body_codec                     __compression;      // 打开 channel 时协商的网络压缩
+
+    // basic.qos ----------------------------------------------------
+    uint32_t                       __consumer_prefetch{0};   // 每个消费者的预取上限
+    prefetch_window::ptr           __channel_window;         // global qos：整个 channel 共享
+    std::mutex                     __unacked_mtx;
+    uint64_t                       __next_tag{0};
+    std::map<uint64_t, unacked_delivery> __unacked;          // delivery_tag → 未确认消息
+
+    std::mutex                     __batch_mtx;
+    std::unordered_map<std::string, delivery_batch> __batches;   // consumer tag → 待发批次
+
+    // publisher confirms：只在连接所属 EventLoop 线程访问，无需加锁
+    bool                           __confirm_mode{false};
+    uint64_t                       __publish_seq{0};
+    uint64_t                       __confirm_sent{0};         // 已发出确认的最大序号
+    std::map<uint64_t, bool>       __confirm_done;            // 已完成未发出：seq → ok
+    bool                           __confirm_flush_scheduled{false};
+
+    // 挂起的 basic.get：只在 EventLoop 线程登记，关闭时取消（队列名, 等待者）
+    std::vector<std::pair<std::string, pull_waiter::ptr>> __pull_waiters;
 };
 
 // =================================================================
@@ -110,13 +221,22 @@ public:
                       const consumer_manager::ptr& cmp,
                       const ProtobufCodecPtr& codec,
                       const muduo::net::TcpConnectionPtr conn,
-                      const thread_pool::ptr& pool);
+                      const thread_pool::ptr& pool,
+                      const output_gate::ptr& gate = nullptr,
+                      const body_codec& compression = {});
 
     void close_channel(const std::string& cid);
     channel::ptr select_channel(const std::string& cid);
+    void resume_delivery();
+
+    // 为 channel 分配二进制帧 channel 号（已分配则沿用），channel 不存在返回 0
+    uint32_t enable_fast_path(const std::string& cid);
+    channel::ptr select_channel(uint32_t channel_no);
 
 private:
     std::unordered_map<std::string, channel::ptr> __channels;
+    std::unordered_map<uint32_t, channel::ptr>    __fast_channels;   // channel 号 → channel
+    uint32_t                                      __next_fast_no{0};
     std::mutex                                    __mtx;
 };
 
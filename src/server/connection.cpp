@@ -1,6 +1,8 @@
 // ======================= connection.cpp =======================
 #include "connection.hpp"
+#include "arena_codec.hpp"
 #include "../common/logger.hpp"
+#include "muduo/net/TcpConnection.h"
 #include <vector>
 
 
@@ -16,22 +18,48 @@ connection::connection(const virtual_host::ptr& host,
                        const thread_pool::ptr& pool)
     : __conn(conn), __codec(codec), __cmp(cmp), __host(host), __pool(pool),
       __channels(std::make_shared<channel_manager>()),
-      __last_active(std::chrono::steady_clock::now()) {}
+      __gate(std::make_shared<output_gate>()),
+      __last_active(std::chrono::steady_clock::now())
+{
+    // 输出缓冲积压到高水位：关闭闸门，派发器不再向本连接的消费者推送
+    output_gate::ptr gate = __gate;
+    conn->setHighWaterMarkCallback(
+        [gate](const muduo::net::TcpConnectionPtr&, size_t) {
+            gate->writable.store(false, std::memory_order_release);
+        },
+        OUTPUT_HIGH_WATERMARK);
+    // 缓冲写空：重新打开并唤醒派发；闸门本来就开着时只是一次原子读
+    std::weak_ptr<channel_manager> weak_channels = __channels;
+    conn->setWriteCompleteCallback([gate, weak_channels](const muduo::net::TcpConnectionPtr&) {
+        if (gate->writable.load(std::memory_order_acquire)) return;
+        gate->writable.store(true, std::memory_order_release);
+        if (auto channels = weak_channels.lock()) channels->resume_delivery();
+    });
+}
 
-connection::~connection() = default;
+connection::~connection()
+{
+    if (auto shm = std::atomic_load(&__shm)) shm->close();
+}
 
 void connection::basic_response(bool ok, const std::string& rid, const std::string& cid)
 {
-    basicCommonResponse resp;
-    resp.set_rid(rid);
-    resp.set_cid(cid);
-    resp.set_ok(ok);
-    __codec->send(__conn, resp);
+    response_arena arena;
+    basicCommonResponse* resp = arena.create<basicCommonResponse>();
+    resp->set_rid(rid);
+    resp->set_cid(cid);
+    resp->set_ok(ok);
+    __codec->send(__conn, *resp);
 }
 
 void connection::open_channel(const openChannelRequestPtr& req)
 {
-    bool ok = __channels->open_channel(req->cid(), __host, __cmp, __codec, __conn, __pool);
+    body_codec compression;
+    compression.enabled = req->compression() == ENCODING_DEFLATE;
+    if (req->compress_min_bytes()) compression.min_bytes = req->compress_min_bytes();
+    compression.dict = req->compress_dict();
+    bool ok = __channels->open_channel(req->cid(), __host, __cmp, __codec, __conn, __pool, __gate,
+                                       compression);
     basic_response(ok, req->rid(), req->cid());
 }
 
@@ -46,6 +74,74 @@ channel::ptr connection::select_channel(const std::string& cid)
     return __channels->select_channel(cid);
 }
 
+channel::ptr connection::select_channel(uint32_t channel_no)
+{
+    return __channels->select_channel(channel_no);
+}
+
+void connection::enable_fast_path(const fastPathRequestPtr& req)
+{
+    uint32_t no = __channels->enable_fast_path(req->cid());
+    fastPathResponse resp;
+    resp.set_rid(req->rid());
+    resp.set_cid(req->cid());
+    resp.set_ok(no != 0);
+    resp.set_channel_no(no);
+    __codec->send(__conn, resp);
+}
+
+void connection::attach_shm(const shmAttachRequestPtr& req,
+                            shm_endpoint::frame_callback on_frame,
+                            shm_endpoint::error_callback on_error)
+{
+    shmAttachResponse resp;
+    resp.set_rid(req->rid());
+    resp.set_cid(req->cid());
+
+    channel::ptr ch = __channels->select_channel(req->cid());
+    shm_endpoint::ptr shm = std::atomic_load(&__shm);
+    bool ok = ch != nullptr;
+    if (ok && !shm) {
+        // 本连接第一次附加：建共享区并挂出一次性的 fd 交接 socket
+        std::string name, token;
+        shm = shm_endpoint::create(__conn->getLoop(), req->ring_bytes(),
+                                   std::move(on_frame), std::move(on_error));
+        ok = shm && shm_offer(shm->region(), &name, &token);
+        if (ok) {
+            std::atomic_store(&__shm, shm);
+            if (__read_paused) shm->pause();
+            shm->start();
+            resp.set_socket_name(name);
+            resp.set_token(token);
+        } else {
+            LOG(WARNING) << "shm transport unavailable for " << __conn->name();
+        }
+    }
+    uint32_t no = 0;
+    if (ok) {
+        no = __channels->enable_fast_path(req->cid());
+        ch->enable_shm(shm);
+        resp.set_ring_bytes(shm->region().ring_bytes());
+    }
+    resp.set_ok(no != 0);
+    resp.set_channel_no(no);
+    __codec->send(__conn, resp);
+}
+
+void connection::pause_read()
+{
+    if (__read_paused.exchange(true)) return;
+    __conn->stopRead();
+    if (auto shm = std::atomic_load(&__shm)) shm->pause();
+}
+
+void connection::resume_read()
+{
+    if (!__read_paused.exchange(false)) return;
+    __conn->startRead();
+    if (auto shm = std::atomic_load(&__shm)) shm->resume();
+}
+
 void connection::refresh()
 {
     __last_active = std::chrono::steady_clock::now();
@@ -99,6 +195,8 @@ void connection_manager::check_timeout(std::chrono::seconds timeout)
         std::unique_lock<std::mutex> lock(__mtx);
         for (auto& [c, ctx] : __conns)
         {
+            // 被背压暂停读取的连接收不到心跳，不能按超时处理
+            if (__paused_reasons != 0 && ctx->is_publisher()) continue;
             if (ctx->expired(timeout))
                 to_close.push_back(c);
         }
@@ -109,4 +207,30 @@ void connection_manager::check_timeout(std::chrono::seconds timeout)
     }
 }
 
-} 
+void connection_manager::pause_publishers(unsigned reason)
+{
+    std::unique_lock<std::mutex> lock(__mtx);
+    unsigned before = __paused_reasons;
+    __paused_reasons = before | reason;
+    if (before != 0) return;           // 已因其他原因暂停
+    for (auto& [c, ctx] : __conns)
+    {
+        if (ctx->is_publisher())
+            ctx->pause_read();
+    }
+}
+
+void connection_manager::resume_publishers(unsigned reason)
+{
+    std::unique_lock<std::mutex> lock(__mtx);
+    if (__paused_reasons == 0) return;
+    __paused_reasons = __paused_reasons & ~reason;
+    if (__paused_reasons != 0) return; // 还有别的原因未解除
+    for (auto& [c, ctx] : __conns)
+    {
+        if (ctx->is_publisher())
+            ctx->resume_read();
+    }
+}
+
+}
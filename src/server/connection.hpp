@@ -5,6 +5,7 @@
 #include <mutex>
 #include <unordered_map>
 #include <chrono>
+#include <atomic>
 
 #include "channel.hpp"  // channel / channel_manager
 
@@ -20,6 +21,9 @@ class ProtobufCodec;  // Muduo Protobuf 编解码器
 
 namespace hz_mq {
 
+// 输出缓冲高水位：越过后暂停向该连接推送，写空后恢复，慢消费者占用的内存有上界
+inline constexpr size_t OUTPUT_HIGH_WATERMARK = 4 * 1024 * 1024;
+
 // ================================================================
 // connection : 管理单条 TCP 连接及其 channels
 // ================================================================
@@ -41,7 +45,24 @@ public:
     bool expired(std::chrono::seconds timeout) const;
     muduo::net::TcpConnectionPtr tcp() const { return __conn; }
 
+    // 发布方标记：线程池过载时只暂停发布连接的读取，消费 / ack 流量不受影响
+    void mark_publisher() { __publisher = true; }
+    bool is_publisher() const { return __publisher; }
+
     channel::ptr select_channel(const std::string& cid);
+    channel::ptr select_channel(uint32_t channel_no);   // 二进制帧按 channel 号查找
+
+    // 协商热路径二进制帧，回 fastPathResponse
+    void enable_fast_path(const fastPathRequestPtr& req);
+    // 附加共享内存传输（同时开启热路径），回 shmAttachResponse；
+    // 环内读出的帧交给 on_frame，共享区被写坏时调用 on_error
+    void attach_shm(const shmAttachRequestPtr& req,
+                    shm_endpoint::frame_callback on_frame,
+                    shm_endpoint::error_callback on_error);
+
+    // 背压：暂停 / 恢复读取，TCP 与共享内存环一并生效
+    void pause_read();
+    void resume_read();
 
 private:
     void basic_response(bool ok, const std::string& rid, const std::string& cid);
@@ -52,7 +73,11 @@ private:
     virtual_host::ptr             __host;
     thread_pool::ptr              __pool;
     channel_manager::ptr          __channels;
+    output_gate::ptr              __gate;          // 本连接所有消费者共享的输出缓冲状态
     std::chrono::steady_clock::time_point __last_active;
+    std::atomic<bool>             __publisher{false};
+    std::atomic<bool>             __read_paused{false};
+    shm_endpoint::ptr             __shm;           // 至多一个，经 std::atomic_load / atomic_store 访问
 }; 
 
 // ================================================================
@@ -78,8 +103,20 @@ public:
     void refresh_connection(const muduo::net::TcpConnectionPtr& conn);
     void check_timeout(std::chrono::seconds timeout);
 
+    // 背压原因：各自独立置位 / 清除，全部清除后才恢复读取
+    enum pause_reason : unsigned {
+        PAUSE_TASK_BACKLOG = 1u << 0,   // 线程池 + strand 积压越过高水位
+        PAUSE_QUEUE_DEPTH  = 1u << 1,   // 队列里待投递的消息过多
+    };
+
+    // 背压：暂停 / 恢复所有发布连接的读事件
+    void pause_publishers(unsigned reason = PAUSE_TASK_BACKLOG);
+    void resume_publishers(unsigned reason = PAUSE_TASK_BACKLOG);
+    bool publishers_paused() const { return __paused_reasons != 0; }
+
 private:
     std::mutex                                                      __mtx;
+    std::atomic<unsigned>                                           __paused_reasons{0};
     std::unordered_map<muduo::net::TcpConnectionPtr, connection::ptr> __conns;
 };
 
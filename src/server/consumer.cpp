@@ -2,8 +2,30 @@
 #include "consumer.hpp"
 #include "../common/logger.hpp"
 
+#include <algorithm>
+#include <limits>
+#include <random>
+
 namespace hz_mq {
 
+select_strategy strategy_from_args(const std::unordered_map<std::string, std::string>& args)
+{
+    auto it = args.find("x-consumer-strategy");
+    if (it == args.end()) return select_strategy::round_robin;
+    if (it->second == "weighted")      return select_strategy::weighted;
+    if (it->second == "least-unacked") return select_strategy::least_unacked;
+    if (it->second == "p2c")           return select_strategy::power_of_two;
+    if (it->second != "round-robin")
+        LOG(WARNING) << "unknown x-consumer-strategy [" << it->second << "], use round-robin";
+    return select_strategy::round_robin;
+}
+
+bool single_active_from_args(const std::unordered_map<std::string, std::string>& args)
+{
+    auto it = args.find("x-single-active-consumer");
+    return it != args.end() && (it->second == "true" || it->second == "1");
+}
+
 // --------- consumer ----------
 consumer::consumer(const std::string& ctag, const std::string& queue_name,
                    bool ack_flag, const consumer_callback& cb)
@@ -12,24 +34,155 @@ consumer::consumer(const std::string& ctag, const std::string& queue_name,
       auto_ack(ack_flag),
       callback(cb) {}
 
+void flow_credit::grant(uint32_t nmsgs, uint64_t nbytes)
+{
+    messages.fetch_add(nmsgs, std::memory_order_relaxed);
+    if (nbytes > 0) {
+        bytes.fetch_add(static_cast<int64_t>(nbytes), std::memory_order_relaxed);
+        byte_limited.store(true, std::memory_order_relaxed);
+    }
+}
+
+void flow_credit::consume(size_t nbytes)
+{
+    messages.fetch_sub(1, std::memory_order_relaxed);
+    if (byte_limited.load(std::memory_order_relaxed))
+        bytes.fetch_sub(static_cast<int64_t>(nbytes), std::memory_order_relaxed);
+}
+
+bool flow_credit::ready() const
+{
+    if (messages.load(std::memory_order_relaxed) <= 0) return false;
+    return !byte_limited.load(std::memory_order_relaxed) ||
+           bytes.load(std::memory_order_relaxed) > 0;
+}
+
+bool consumer::flow_ready() const
+{
+    if (gate && !gate->writable.load(std::memory_order_acquire)) return false;
+    return !credit || credit->ready();
+}
+
+void consumer::on_delivered(size_t nbytes)
+{
+    if (credit) credit->consume(nbytes);
+}
+
+bool consumer::try_acquire_credit()
+{
+    if (!flow_ready()) return false;
+    if (auto_ack) return true;
+    if (window && !window->try_acquire()) return false;
+    if (channel_window && !channel_window->try_acquire()) {
+        if (window) window->release();
+        return false;
+    }
+    return true;
+}
+
+void consumer::release_credit(uint32_t n)
+{
+    if (auto_ack) return;
+    if (window) window->release(n);
+    if (channel_window) channel_window->release(n);
+}
+
+bool consumer::has_credit() const
+{
+    if (!flow_ready()) return false;
+    if (auto_ack) return true;
+    return (!window || window->available()) &&
+           (!channel_window || channel_window->available());
+}
+
+uint32_t consumer::unacked() const
+{
+    if (auto_ack || !window) return 0;
+    return window->inflight.load(std::memory_order_relaxed);
+}
+
+// --------- prefetch_window ----------
+bool prefetch_window::try_acquire()
+{
+    uint32_t cur = inflight.load(std::memory_order_relaxed);
+    while (true) {
+        uint32_t lim = limit.load(std::memory_order_relaxed);
+        if (lim != 0 && cur >= lim) return false;
+        if (inflight.compare_exchange_weak(cur, cur + 1, std::memory_order_acq_rel))
+            return true;
+    }
+}
+
+void prefetch_window::release(uint32_t n)
+{
+    uint32_t cur = inflight.load(std::memory_order_relaxed);
+    while (true) {
+        uint32_t next = cur > n ? cur - n : 0;
+        if (inflight.compare_exchange_weak(cur, next, std::memory_order_acq_rel))
+            return;
+    }
+}
+
+bool prefetch_window::available() const
+{
+    uint32_t lim = limit.load(std::memory_order_relaxed);
+    return lim == 0 || inflight.load(std::memory_order_relaxed) < lim;
+}
+
 // --------- queue_consumer ----------
-queue_consumer::queue_consumer(const std::string& qname)
-    : __qname(qname), __rr_index(0) {}
+queue_consumer::queue_consumer(const std::string& qname, select_strategy strategy,
+                               bool single_active)
+    : __qname(qname), __snapshot(std::make_shared<const snapshot>()), __strategy(strategy),
+      __single_active(single_active) {}
+
+void queue_consumer::publish_locked()
+{
+    // 按优先级从高到低稳定排序：同优先级保持订阅先后
+    std::vector<consumer::ptr> ordered = __consumers;
+    std::stable_sort(ordered.begin(), ordered.end(),
+                     [](const consumer::ptr& a, const consumer::ptr& b) { return a->priority > b->priority; });
+    if (__single_active) {
+        // 活跃消费者一直保持到它被移除，之后才由排第一的接管；新加入的高优先级消费者不抢占，
+        // 否则未确认的消息还在旧消费者手里时新消费者就开始收后续消息，破坏单消费者顺序
+        bool kept = __active && std::find(__consumers.begin(), __consumers.end(), __active) != __consumers.end();
+        if (!kept) __active = ordered.empty() ? nullptr : ordered.front();
+        ordered.clear();
+        if (__active) ordered.push_back(__active);
+    }
+
+    auto snap = std::make_shared<snapshot>();
+    for (const auto& c : ordered) {
+        if (snap->groups.empty() || snap->groups.back().priority != c->priority) {
+            snap->groups.emplace_back();
+            snap->groups.back().priority = c->priority;
+        }
+        priority_group& g = snap->groups.back();
+        g.consumers.push_back(c);
+        g.total_weight += std::max<uint32_t>(c->weight, 1);
+        g.weight_prefix.push_back(g.total_weight);
+    }
+    __snapshot.store(std::move(snap));
+}
 
 consumer::ptr queue_consumer::create(const std::string& ctag,
                                      const std::string& queue_name,
                                      bool ack_flag,
                                      const consumer_callback& cb)
+{
+    return create(std::make_shared<consumer>(ctag, queue_name, ack_flag, cb));
+}
+
+consumer::ptr queue_consumer::create(const consumer::ptr& new_consumer)
 {
     std::unique_lock<std::mutex> lock(__mtx);
     for (const auto& c : __consumers) {
-        if (c->tag == ctag) {
+        if (c->tag == new_consumer->tag) {
             LOG(WARNING) << "consumer duplicate tag, create failed";
             return {};
         }
     }
-    auto new_consumer = std::make_shared<consumer>(ctag, queue_name, ack_flag, cb);
     __consumers.push_back(new_consumer);
+    publish_locked();
     return new_consumer;
 }
 
@@ -39,19 +192,132 @@ void queue_consumer::remove(const std::string& ctag)
     for (auto it = __consumers.begin(); it != __consumers.end(); ++it) {
         if ((*it)->tag == ctag) {
             __consumers.erase(it);
+            publish_locked();   // single-active 模式下自动切换到下一个消费者
             return;
         }
     }
     LOG(WARNING) << "consumer tag [" << ctag << "] not found, remove failed";
 }
 
+consumer::ptr queue_consumer::choose()
+{
+    snapshot_ptr snap = __snapshot.load();
+    select_strategy strategy = __strategy.load(std::memory_order_relaxed);
+    // 高优先级组有额度时总是先投递，组内再按策略选择
+    for (const auto& g : snap->groups) {
+        if (consumer::ptr c = choose_in(g, strategy)) return c;
+    }
+    return {};   // 所有消费者的预取窗口都已占满
+}
+
 consumer::ptr queue_consumer::rr_choose()
+{
+    snapshot_ptr snap = __snapshot.load();
+    for (const auto& g : snap->groups) {
+        if (consumer::ptr c = choose_in(g, select_strategy::round_robin)) return c;
+    }
+    return {};
+}
+
+consumer::ptr queue_consumer::active()
+{
+    snapshot_ptr snap = __snapshot.load();
+    if (snap->groups.empty()) return {};
+    return snap->groups.front().consumers.front();
+}
+
+void queue_consumer::add_waiter(const pull_waiter::ptr& w)
+{
+    std::unique_lock<std::mutex> lock(__mtx);
+    // 顺带清理已超时的等待者，队列长期无消息时不会堆积
+    __waiters.erase(std::remove_if(__waiters.begin(), __waiters.end(),
+                                   [](const pull_waiter::ptr& p) { return p->done.load(); }),
+                    __waiters.end());
+    __waiters.push_back(w);
+}
+
+pull_waiter::ptr queue_consumer::front_waiter()
+{
+    std::unique_lock<std::mutex> lock(__mtx);
+    while (!__waiters.empty() && __waiters.front()->done.load()) __waiters.pop_front();
+    return __waiters.empty() ? nullptr : __waiters.front();
+}
+
+void queue_consumer::pop_waiter(const pull_waiter::ptr& w)
 {
     std::unique_lock<std::mutex> lock(__mtx);
-    if (__consumers.empty()) return {};
-    consumer::ptr chosen = __consumers[__rr_index % __consumers.size()];
-    __rr_index = (__rr_index + 1) % __consumers.size();
-    return chosen;
+    auto it = std::find(__waiters.begin(), __waiters.end(), w);
+    if (it != __waiters.end()) __waiters.erase(it);
+}
+
+consumer::ptr queue_consumer::choose_in(const priority_group& g, select_strategy strategy)
+{
+    switch (strategy) {
+    case select_strategy::weighted:      return weighted_choose(g);
+    case select_strategy::least_unacked: return least_unacked_choose(g);
+    case select_strategy::power_of_two:  return p2c_choose(g);
+    default:                             break;
+    }
+    return pick_from(g, __rr_index.fetch_add(1, std::memory_order_relaxed));
+}
+
+// 从 start 开始依次尝试，返回第一个抢到额度的消费者
+consumer::ptr queue_consumer::pick_from(const priority_group& g, size_t start)
+{
+    size_t n = g.consumers.size();
+    for (size_t i = 0; i < n; ++i) {
+        const consumer::ptr& cand = g.consumers[(start + i) % n];
+        if (cand->try_acquire_credit()) return cand;
+    }
+    return {};
+}
+
+consumer::ptr queue_consumer::weighted_choose(const priority_group& g)
+{
+    // 轮询计数落在累计权重区间上：权重为 w 的消费者每轮被选中 w 次
+    uint64_t slot = __rr_index.fetch_add(1, std::memory_order_relaxed) % g.total_weight;
+    size_t idx = std::upper_bound(g.weight_prefix.begin(), g.weight_prefix.end(), slot) -
+                 g.weight_prefix.begin();
+    return pick_from(g, idx);
+}
+
+consumer::ptr queue_consumer::least_unacked_choose(const priority_group& g)
+{
+    size_t n = g.consumers.size();
+    // 起点轮转，未确认数相同时均匀分摊
+    size_t start = __rr_index.fetch_add(1, std::memory_order_relaxed);
+    for (size_t attempt = 0; attempt < n; ++attempt) {
+        consumer::ptr best;
+        uint32_t best_unacked = std::numeric_limits<uint32_t>::max();
+        for (size_t i = 0; i < n; ++i) {
+            const consumer::ptr& c = g.consumers[(start + i) % n];
+            if (!c->has_credit()) continue;
+            uint32_t u = c->unacked();
+            if (u < best_unacked) { best = c; best_unacked = u; }
+        }
+        if (!best) return {};
+        if (best->try_acquire_credit()) return best;   // 并发抢占失败则重新比较
+    }
+    return pick_from(g, start);
+}
+
+consumer::ptr queue_consumer::p2c_choose(const priority_group& g)
+{
+    size_t n = g.consumers.size();
+    if (n == 1) return pick_from(g, 0);
+
+    thread_local std::minstd_rand rng{std::random_device{}()};
+    size_t a = rng() % n;
+    size_t b = rng() % (n - 1);
+    if (b >= a) ++b;
+
+    const consumer::ptr& ca = g.consumers[a];
+    const consumer::ptr& cb = g.consumers[b];
+    const consumer::ptr& first  = ca->unacked() <= cb->unacked() ? ca : cb;
+    const consumer::ptr& second = ca->unacked() <= cb->unacked() ? cb : ca;
+    if (first->try_acquire_credit())  return first;
+    if (second->try_acquire_credit()) return second;
+    return pick_from(g, a);   // 两个都满：退化为顺序查找
 }
 
 bool queue_consumer::empty()
@@ -73,15 +339,37 @@ void queue_consumer::clear()
 {
     std::unique_lock<std::mutex> lock(__mtx);
     __consumers.clear();
+    publish_locked();
     __rr_index = 0;
 }
 
+bool queue_consumer::begin_dispatch()
+{
+    __dispatch_signal.store(true);
+    return !__dispatching.exchange(true);
+}
+
+void queue_consumer::consume_signal()
+{
+    __dispatch_signal.store(false);
+}
+
+bool queue_consumer::finish_dispatch()
+{
+    // 先释放派发权再检查通知：与 begin_dispatch 的"先置位再抢占"配对，不会漏掉通知
+    __dispatching.store(false);
+    if (!__dispatch_signal.load()) return false;
+    return !__dispatching.exchange(true);
+}
+
 // --------- consumer_manager ----------
-void consumer_manager::init_queue_consumer(const std::string& qname)
+void consumer_manager::init_queue_consumer(const std::string& qname,
+                                           const std::unordered_map<std::string, std::string>& args)
 {
     std::unique_lock<std::mutex> lock(__mtx);
     if (__queue_consumers.find(qname) == __queue_consumers.end()) {
-        __queue_consumers[qname] = std::make_shared<queue_consumer>(qname);
+        __queue_consumers[qname] = std::make_shared<queue_consumer>(
+            qname, strategy_from_args(args), single_active_from_args(args));
     }
 }
 
@@ -109,6 +397,21 @@ consumer::ptr consumer_manager::create(const std::string& ctag,
     return qc->create(ctag, queue_name, ack_flag, cb);
 }
 
+consumer::ptr consumer_manager::create(const consumer::ptr& c)
+{
+    queue_consumer::ptr qc;
+    {
+        std::unique_lock<std::mutex> lock(__mtx);
+        auto it = __queue_consumers.find(c->qname);
+        if (it == __queue_consumers.end()) {
+            LOG(ERROR) << "queue_consumer for [" << c->qname << "] not found";
+            return {};
+        }
+        qc = it->second;
+    }
+    return qc->create(c);
+}
+
 void consumer_manager::remove(const std::string& ctag, const std::string& queue_name)
 {
     queue_consumer::ptr qc;
@@ -132,7 +435,14 @@ consumer::ptr consumer_manager::choose(const std::string& queue_name)
         LOG(ERROR) << "queue_consumer for [" << queue_name << "] not found";
         return {};
     }
-    return it->second->rr_choose();
+    return it->second->choose();
+}
+
+queue_consumer::ptr consumer_manager::select(const std::string& queue_name)
+{
+    std::unique_lock<std::mutex> lock(__mtx);
+    auto it = __queue_consumers.find(queue_name);
+    return (it == __queue_consumers.end()) ? nullptr : it->second;
 }
 
 } 
@@ -1,6 +1,9 @@
 // ======================= consumer.hpp =======================
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -16,6 +19,84 @@ namespace hz_mq {
 using consumer_callback =
     std::function<void(const std::string&, const BasicProperties*, const std::string&)>;
 
+struct consumer;
+
+// 投递回调：consumer, message —— 由所属 channel 分配 delivery tag 并登记未确认消息
+using delivery_callback =
+    std::function<void(const std::shared_ptr<consumer>&, const std::shared_ptr<Message>&)>;
+
+// 一轮派发结束时调用：批量投递的消费者借此发出（或定时发出）未满的批次
+using flush_callback = std::function<void(const std::shared_ptr<consumer>&)>;
+
+// --------- select_strategy ----------
+// 同一队列多个消费者时的选择策略，由队列参数 x-consumer-strategy 指定：
+//   round-robin（默认） / weighted（按消费者参数 x-weight 加权轮询） /
+//   least-unacked（未确认数最少优先） / p2c（随机取两个，选未确认数较少者）
+enum class select_strategy { round_robin, weighted, least_unacked, power_of_two };
+
+select_strategy strategy_from_args(const std::unordered_map<std::string, std::string>& args);
+// 队列参数 x-single-active-consumer = true：同一时刻只向一个消费者投递
+bool single_active_from_args(const std::unordered_map<std::string, std::string>& args);
+
+// --------- pull_waiter ----------
+// 挂起的 basic.get 长轮询请求：队列为空时登记到 queue_consumer，
+// 有消息到达由派发器完成，超时由定时器完成，二者经 try_finish 保证只完成一次
+struct pull_waiter {
+    using ptr = std::shared_ptr<pull_waiter>;
+    using complete_callback = std::function<void(std::vector<std::shared_ptr<Message>>&&)>;
+
+    uint32_t          max_count{1};
+    bool              auto_ack{false};
+    complete_callback complete;
+    std::mutex        mtx;           // 派发器取消息期间持有，与超时互斥
+    std::atomic<bool> done{false};
+
+    bool try_finish()
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        if (done) return false;
+        done = true;
+        return true;
+    }
+};
+
+// --------- prefetch_window ----------
+// 预取窗口：limit == 0 表示不限；inflight 为已投递但未确认的消息数
+struct prefetch_window {
+    using ptr = std::shared_ptr<prefetch_window>;
+
+    std::atomic<uint32_t> limit{0};
+    std::atomic<uint32_t> inflight{0};
+
+    bool try_acquire();
+    void release(uint32_t n = 1);
+    bool available() const;
+};
+
+// --------- flow_credit ----------
+// 基于信用的流控（basic.credit）：消费者授予条数 / 字节额度，每次投递扣减，
+// 耗尽后停止派发直到再次授予；从未授予字节额度时不按字节限制
+struct flow_credit {
+    using ptr = std::shared_ptr<flow_credit>;
+
+    std::atomic<int64_t> messages{0};
+    std::atomic<int64_t> bytes{0};
+    std::atomic<bool>    byte_limited{false};
+
+    void grant(uint32_t nmsgs, uint64_t nbytes);
+    void consume(size_t nbytes);    // 投递后扣减；字节额度允许透支一条消息
+    bool ready() const;
+};
+
+// --------- output_gate ----------
+// 连接输出缓冲状态：越过高水位时关闭，写空（WriteComplete）后重新打开；
+// 同一连接上所有 channel 的消费者共享
+struct output_gate {
+    using ptr = std::shared_ptr<output_gate>;
+
+    std::atomic<bool> writable{true};
+};
+
 // --------- consumer ----------
 struct consumer {
     using ptr = std::shared_ptr<consumer>;
@@ -23,11 +104,28 @@ struct consumer {
     std::string tag;      // 标识
     std::string qname;    // 订阅队列
     bool auto_ack{false};
+    uint32_t weight{1};                     // weighted 策略下的权重（x-weight）
+    int32_t priority{0};                    // 消费者优先级（x-priority），高优先级有额度时总是先投递
     consumer_callback callback;
+    delivery_callback deliver;              // 非空时优先使用（channel 创建的消费者）
+    flush_callback    flush;                // 可选
+
+    prefetch_window::ptr window;            // 消费者级预取窗口
+    prefetch_window::ptr channel_window;    // channel 级（basic.qos global）窗口
+    flow_credit::ptr     credit;            // 非空表示信用模式
+    output_gate::ptr     gate;              // 所属连接的输出缓冲状态
 
     consumer() = default;
     consumer(const std::string& ctag, const std::string& queue_name,
              bool ack_flag, const consumer_callback& cb);
+
+    // 预占 / 归还一个投递额度；auto_ack 消费者不受预取限制，但受信用额度与输出缓冲限制
+    bool try_acquire_credit();
+    void release_credit(uint32_t n = 1);
+    bool has_credit() const;
+    bool flow_ready() const;                // 信用未耗尽且连接可写
+    void on_delivered(size_t nbytes);       // 扣减信用额度
+    uint32_t unacked() const;               // 已投递未确认数（auto_ack 恒为 0）
 };
 
 // --------- queue_consumer ----------
@@ -35,21 +133,71 @@ class queue_consumer {
 public:
     using ptr = std::shared_ptr<queue_consumer>;
 
-    explicit queue_consumer(const std::string& qname);
+    explicit queue_consumer(const std::string& qname,
+                            select_strategy strategy = select_strategy::round_robin,
+                            bool single_active = false);
 
     consumer::ptr create(const std::string& ctag, const std::string& queue_name,
                          bool ack_flag, const consumer_callback& cb);
+    consumer::ptr create(const consumer::ptr& c);   // 添加预先配置好的消费者
     void remove(const std::string& ctag);
+
+    // 按策略选择，跳过预取额度已满的消费者并预占一个额度；不加锁，只读消费者快照
+    consumer::ptr choose();
     consumer::ptr rr_choose();      // 轮询选择
+    void set_strategy(select_strategy strategy) { __strategy = strategy; }
+    consumer::ptr active();         // single-active 模式下当前的活跃消费者（保持到它被移除）
+
+    // basic.get 长轮询等待者，按登记顺序服务
+    void add_waiter(const pull_waiter::ptr& w);
+    pull_waiter::ptr front_waiter();           // 跳过已超时的，无等待者返回空
+    void pop_waiter(const pull_waiter::ptr& w);
     bool empty();
     bool exists(const std::string& ctag);
     void clear();
 
+    // 派发状态（见 queue_dispatcher）：
+    //   begin_dispatch  —— 置位通知；返回 true 表示调用方负责启动派发任务
+    //   consume_signal  —— 派发任务每轮开始前清除通知
+    //   finish_dispatch —— 结束派发；期间又有通知且重新抢到派发权时返回 true
+    bool begin_dispatch();
+    void consume_signal();
+    bool finish_dispatch();
+
 private:
+    // 同一优先级的消费者
+    struct priority_group {
+        int32_t                    priority{0};
+        std::vector<consumer::ptr> consumers;
+        std::vector<uint64_t>      weight_prefix;   // 累计权重，weighted 策略二分查找
+        uint64_t                   total_weight{0};
+    };
+    // 消费者列表的只读快照：增删时整体替换（copy-on-write），选择路径无锁读取；
+    // groups 按优先级从高到低排列，single-active 模式下只含活跃消费者
+    struct snapshot {
+        std::vector<priority_group> groups;
+    };
+    using snapshot_ptr = std::shared_ptr<const snapshot>;
+
+    void publish_locked();          // 需持有 __mtx
+    consumer::ptr choose_in(const priority_group& g, select_strategy strategy);
+    consumer::ptr pick_from(const priority_group& g, size_t start);
+    consumer::ptr weighted_choose(const priority_group& g);
+    consumer::ptr least_unacked_choose(const priority_group& g);
+    consumer::ptr p2c_choose(const priority_group& g);
+
     std::string __qname;
-    std::mutex __mtx;
-    size_t __rr_index{0};
+    std::mutex __mtx;               // 串行化增删
     std::vector<consumer::ptr> __consumers;
+    std::deque<pull_waiter::ptr> __waiters;
+    std::atomic<snapshot_ptr> __snapshot;
+    std::atomic<size_t> __rr_index{0};
+    std::atomic<select_strategy> __strategy;
+    bool __single_active{false};
+    consumer::ptr __active;         // single-active 模式下的活跃消费者，受 __mtx 保护
+
+    std::atomic<bool> __dispatching{false};
+    std::atomic<bool> __dispatch_signal{false};
 };
 
 // --------- consumer_manager ----------
@@ -59,13 +207,17 @@ public:
 
     consumer_manager() = default;
 
-    void init_queue_consumer(const std::string& qname);
+    // args 为队列参数：x-consumer-strategy / x-single-active-consumer
+    void init_queue_consumer(const std::string& qname,
+                             const std::unordered_map<std::string, std::string>& args = {});
     void destroy_queue_consumer(const std::string& qname);
 
     consumer::ptr create(const std::string& ctag, const std::string& queue_name,
                          bool ack_flag, const consumer_callback& cb);
+    consumer::ptr create(const consumer::ptr& c);
     void remove(const std::string& ctag, const std::string& queue_name);
     consumer::ptr choose(const std::string& queue_name);
+    queue_consumer::ptr select(const std::string& queue_name);
 
 private:
     std::mutex __mtx;
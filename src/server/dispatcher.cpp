@@ -0,0 +1,103 @@
+// ======================= dispatcher.cpp =======================
+#include "dispatcher.hpp"
+#include "queue_message.hpp"
+#include "../common/logger.hpp"
+
+#include <algorithm>
+
+namespace hz_mq {
+
+queue_dispatcher::queue_dispatcher(const virtual_host::ptr& host,
+                                   const consumer_manager::ptr& cmp,
+                                   const thread_pool::ptr& pool)
+    : __host(host), __cmp(cmp), __pool(pool) {}
+
+void queue_dispatcher::notify(const std::string& qname)
+{
+    queue_consumer::ptr qc = __cmp->select(qname);
+    if (!qc) return;
+    // 已有派发任务在跑：置位即可，由它在收尾时重新检查
+    if (!qc->begin_dispatch()) return;
+
+    auto self = shared_from_this();
+    __pool->push([self, qname, qc] { self->run(qname, qc); });
+}
+
+void queue_dispatcher::run(const std::string& qname, const queue_consumer::ptr& qc)
+{
+    size_t delivered = 0;
+    std::vector<consumer::ptr> touched;
+    do {
+        qc->consume_signal();
+        delivered += serve_waiters(qname, qc);
+        while (delivered < DISPATCH_BATCH && dispatch_one(qname, qc, touched)) {
+            ++delivered;
+        }
+        flush(touched);
+        if (delivered >= DISPATCH_BATCH) {
+            // 批次用完：保持派发状态，重新入池，给其他队列让出 worker
+            auto self = shared_from_this();
+            __pool->push([self, qname, qc] { self->run(qname, qc); });
+            return;
+        }
+    } while (qc->finish_dispatch());
+}
+
+size_t queue_dispatcher::serve_waiters(const std::string& qname, const queue_consumer::ptr& qc)
+{
+    size_t served = 0;
+    while (pull_waiter::ptr w = qc->front_waiter()) {
+        std::vector<message_ptr> msgs;
+        {
+            std::lock_guard<std::mutex> lk(w->mtx);
+            if (!w->done) {
+                msgs = __host->basic_get(qname, w->max_count, w->auto_ack);
+                if (msgs.empty()) return served;   // 队列已空：等待者继续挂起
+                w->done = true;
+            }
+        }
+        qc->pop_waiter(w);
+        if (msgs.empty()) continue;                // 刚好超时
+        served += msgs.size();
+        w->complete(std::move(msgs));
+    }
+    return served;
+}
+
+void queue_dispatcher::flush(std::vector<consumer::ptr>& touched)
+{
+    for (auto& cp : touched) {
+        if (cp->flush) cp->flush(cp);
+    }
+    touched.clear();
+}
+
+bool queue_dispatcher::dispatch_one(const std::string& qname, const queue_consumer::ptr& qc,
+                                    std::vector<consumer::ptr>& touched)
+{
+    // 1. 选消费者：同时预占一个预取额度，窗口全满时消息留在队列里等 ack 再派发
+    consumer::ptr cp = qc->choose();
+    if (!cp) return false;
+
+    // 2. 取出消息：auto_ack 直接出队，手动确认则登记为未确认
+    message_ptr mp = cp->auto_ack ? __host->basic_consume(qname) : __host->basic_take(qname);
+    if (!mp) {
+        cp->release_credit();
+        return false;
+    }
+
+    // 3. 投递（信用额度按同一队列串行派发扣减，无需与预占合并）
+    cp->on_delivered(mp->payload().body().size());
+    if (cp->deliver) {
+        cp->deliver(cp, mp);
+        if (cp->flush && std::find(touched.begin(), touched.end(), cp) == touched.end())
+            touched.push_back(cp);
+        return true;
+    }
+    if (cp->callback) {
+        cp->callback(cp->tag, &mp->payload().properties(), mp->payload().body());
+    }
+    return true;   // auto_ack 消息已由 basic_consume 出队，无需再 ack
+}
+
+} // namespace hz_mq
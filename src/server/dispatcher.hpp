@@ -0,0 +1,50 @@
+// ======================= dispatcher.hpp =======================
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "consumer.hpp"
+#include "virtual_host.hpp"
+#include "../common/thread_pool.hpp"
+
+namespace hz_mq {
+
+// -----------------------------------------------------------------
+// queue_dispatcher : 按队列持续推送
+//   · notify(qname) 在发布 / 订阅 / ack 时调用，只置位不派发
+//   · 同一队列同一时刻只有一个派发任务（状态保存在 queue_consumer 中，
+//     所有 channel 共享），任务内循环投递直到队列为空或消费者额度耗尽
+//   · 每个任务至多投递 DISPATCH_BATCH 条，超出后重新入池让出 worker
+//   · 每轮结束对本轮收到消息的消费者调用 flush，批量投递据此成帧
+//   · 挂起的 basic.get 长轮询请求先于推送消费者得到服务
+//   · 消费者信用耗尽或连接输出缓冲越过高水位时停止派发，
+//     basic.credit / WriteComplete 再次 notify 后继续
+// -----------------------------------------------------------------
+class queue_dispatcher : public std::enable_shared_from_this<queue_dispatcher> {
+public:
+    using ptr = std::shared_ptr<queue_dispatcher>;
+
+    static constexpr size_t DISPATCH_BATCH = 64;
+
+    queue_dispatcher(const virtual_host::ptr& host,
+                     const consumer_manager::ptr& cmp,
+                     const thread_pool::ptr& pool);
+
+    void notify(const std::string& qname);
+
+private:
+    void run(const std::string& qname, const queue_consumer::ptr& qc);
+    size_t serve_waiters(const std::string& qname, const queue_consumer::ptr& qc);
+    bool dispatch_one(const std::string& qname, const queue_consumer::ptr& qc,
+                      std::vector<consumer::ptr>& touched);
+    static void flush(std::vector<consumer::ptr>& touched);
+
+    virtual_host::ptr     __host;
+    consumer_manager::ptr __cmp;
+    thread_pool::ptr      __pool;
+};
+
+} // namespace hz_mq
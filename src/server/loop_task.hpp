@@ -0,0 +1,110 @@
+// ======================= loop_task.hpp =======================
+#pragma once
+
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "muduo/net/EventLoop.h"
+#include "../common/logger.hpp"
+#include "../common/thread_pool.hpp"
+
+// -----------------------------------------------------------------
+// 基于 C++20 协程的请求处理支持：
+//   · detached_task     —— handler 的根协程，即发即忘，异常只记录日志
+//   · resume_in_loop()  —— 切回 muduo EventLoop 线程（发送响应等）
+//   · resume_on()       —— 切到 strand 在线程池上串行执行阻塞操作（落盘等）
+// handler 写成顺序代码，不阻塞 Reactor，也不需要回调链
+// -----------------------------------------------------------------
+namespace hz_mq::coro {
+
+// ---------- detached_task ----------
+struct detached_task {
+    struct promise_type {
+        detached_task get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept
+        {
+            try { std::rethrow_exception(std::current_exception()); }
+            catch (const std::exception& e) { LOG(ERROR) << "coroutine handler failed: " << e.what(); }
+            catch (...) { LOG(ERROR) << "coroutine handler failed"; }
+        }
+    };
+};
+
+// ---------- strand：在线程池上串行执行，保证同一 channel 内的顺序 ----------
+// 排队中的任务通过 add_backlog 计入线程池水位，积压过多时同样触发发布方背压
+class strand : public std::enable_shared_from_this<strand> {
+public:
+    using ptr = std::shared_ptr<strand>;
+
+    explicit strand(const thread_pool::ptr& pool) : __pool(pool) {}
+
+    void post(std::function<void()> fn)
+    {
+        __pool->add_backlog(1);   // 在 strand 锁外登记，水位回调不会在持锁时执行
+        {
+            std::lock_guard<std::mutex> lk(__mtx);
+            __jobs.push_back(std::move(fn));
+            if (__running) return;
+            __running = true;
+        }
+        auto self = shared_from_this();
+        __pool->push([self] { self->run(); });
+    }
+
+    // strand 上没有排队或执行中的任务
+    bool idle()
+    {
+        std::lock_guard<std::mutex> lk(__mtx);
+        return !__running;
+    }
+
+private:
+    void run()
+    {
+        while (true) {
+            std::function<void()> fn;
+            {
+                std::lock_guard<std::mutex> lk(__mtx);
+                if (__jobs.empty()) { __running = false; return; }
+                fn = std::move(__jobs.front());
+                __jobs.pop_front();
+            }
+            __pool->add_backlog(-1);
+            fn();
+        }
+    }
+
+    thread_pool::ptr                  __pool;
+    std::mutex                        __mtx;
+    std::deque<std::function<void()>> __jobs;
+    bool                              __running{false};
+};
+
+// ---------- awaitables ----------
+struct loop_awaiter {
+    muduo::net::EventLoop* loop;
+
+    bool await_ready() const { return loop->isInLoopThread(); }
+    void await_suspend(std::coroutine_handle<> h) const { loop->queueInLoop([h] { h.resume(); }); }
+    void await_resume() const noexcept {}
+};
+
+struct strand_awaiter {
+    strand* s;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) const { s->post([h] { h.resume(); }); }
+    void await_resume() const noexcept {}
+};
+
+inline loop_awaiter   resume_in_loop(muduo::net::EventLoop* loop) { return {loop}; }
+inline strand_awaiter resume_on(const strand::ptr& s)            { return {s.get()}; }
+
+} // namespace hz_mq::coro
@@ -1,5 +1,6 @@
 #include "broker_server.hpp"
 #include "management_http.hpp"
+#include "../common/snowflake.hpp"
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/TcpServer.h"
 #include "muduo/protoc/dispatcher.h"
@@ -13,7 +14,19 @@ int main(int argc, char* argv[]) {
     if (argc >= 3) {
         base_dir = argv[2];
     }
-    hz_mq::BrokerServer server(port, base_dir);
+    // 可选绑核：mq_server <port> <dir> <io_cores> <worker_cores> [node_id]，如 "0,1" "2-7"
+    hz_mq::cpu_placement placement;
+    if (argc >= 4) {
+        placement.io_cores = hz_mq::affinity::parse_cpu_list(argv[3]);
+    }
+    if (argc >= 5) {
+        placement.worker_cores = hz_mq::affinity::parse_cpu_list(argv[4]);
+    }
+    // 可选节点号（0 ~ 1023）：同时运行多个 broker 时各取不同值，消息 id 互不冲突
+    if (argc >= 6) {
+        hz_mq::message_id_generator().set_node(static_cast<uint32_t>(std::atoi(argv[5])));
+    }
+    hz_mq::BrokerServer server(port, base_dir, placement);
     hz_mq::management_http_server http_srv(server.get_virtual_host(), 8080);
     http_srv.start();
     server.start();
@@ -3,13 +3,22 @@
 #include <deque>
 #include <memory>
 #include <string>
+#include <stdexcept>
 #include <fstream>
 #include <mutex>
 #include <filesystem>
 #include <algorithm>
+#include <unordered_map>
+#include <vector>
 
 #include "../common/msg.pb.h"      // BasicProperties / Message     // 新增
 #include "../common/message.hpp"   // 若已有真正定义则直接用它
+#include "../common/mpsc_ring.hpp" // 发布入口无锁环
+#include "../common/body_codec.hpp" // 落盘压缩
+#include "../common/snowflake.hpp"  // 数值消息 id
+#include "../common/slab_pool.hpp"  // 消息对象 / 容器节点池
+#include "../common/logger.hpp"
+#include <google/protobuf/io/coded_stream.h>
 
 namespace hz_mq {
 
@@ -24,6 +33,17 @@ namespace hz_mq {
 
 using message_ptr = std::shared_ptr<Message>;
 
+// 每个队列的无锁入口环容量；环满时发布方回退到加锁直接入队
+inline constexpr size_t INGRESS_RING_CAPACITY = 4096;
+
+// 消息对象的分配方式（队列参数 x-message-alloc=slab|heap，默认 slab）：
+//   slab 时 shared_ptr 控制块与 Message 一次从线程 slab 池取得，释放时批量归还所属线程
+enum class message_alloc : uint8_t { slab, heap };
+
+message_alloc message_alloc_from_args(const std::unordered_map<std::string, std::string>& args);
+message_ptr   new_message(message_alloc alloc);
+message_ptr   new_message(message_alloc alloc, const Message& src);   // 复制
+
 class queue_message {
 public:
     using ptr = std::shared_ptr<queue_message>;
@@ -34,41 +54,129 @@ public:
         double invalid_ratio{0.0};
     };
 
-    queue_message(const std::string& base_dir, const std::string& queue_name);
+    // codec：落盘记录的消息体压缩配置（x-compress），内存中的消息体始终为原文
+    // alloc：本队列新建 / 复制 / 恢复消息时的分配方式
+    queue_message(const std::string& base_dir, const std::string& queue_name,
+                  const body_codec& codec = {}, message_alloc alloc = message_alloc::slab);
     ~queue_message();
 
     bool insert(BasicProperties* bp,
                 const std::string& body,
                  bool durable);
-
-    message_ptr front() const
-    {   return msgs_.empty() ? nullptr : msgs_.front(); }
-
-    void remove(const std::string& id); 
-
-    std::size_t getable_count() const { return msgs_.size(); }
-    std::deque<message_ptr> get_all_messages() const { return msgs_; }
+    // 插入共享消息：扇出时同一 Message 被多个队列引用，消息体只有一份；
+    // 各队列自己的磁盘位置记在 positions_，投递状态变化时写时复制。
+    // durable 时写盘失败返回 false 且不入队：发布方收到 nack 后会重发
+    bool insert(const message_ptr& msg, bool durable);
+    // numeric_id 未设置时在此分配
+    static message_ptr make_message(const BasicProperties* bp, const std::string& body,
+                                    message_alloc alloc = message_alloc::slab);
+    message_alloc alloc() const { return alloc_; }
+
+    message_ptr front() const;
+
+    // 按数值 id（properties.numeric_id）删除
+    void remove(uint64_t id);
+
+    // 手动确认模式：take 取出队首并记入未确认表（不作废持久化记录），
+    // ack 确认后才从磁盘作废；requeue 把未确认消息放回队首、标记 redelivered
+    // 并把 delivery_count 加一（持久化消息同步改写磁盘记录）
+    message_ptr take();
+    // 自动确认出队：取出队首并作废持久化记录，整个过程持 store_mtx_。
+    // front() + remove() 两步之间可能被分发器抢先取走，同一条消息会被投递两次
+    message_ptr pop();
+    // 一次取出至多 max_count 条：auto_ack 时同 pop，否则同 take
+    std::vector<message_ptr> pop_n(size_t max_count, bool auto_ack);
+    bool ack(uint64_t id);
+    bool requeue(uint64_t id);
+    message_ptr find(uint64_t id) const;   // 先查未确认表，再查队列
+
+    // 字符串 id 兼容接口：客户端自带的 properties.id，或数值 id 的十进制文本；
+    // 需线性查找，只用于旧客户端 / 管理接口。remove("") 删除队首
+    uint64_t lookup_id(const std::string& id) const;   // 找不到返回 0
+    void remove(const std::string& id);
+    bool ack(const std::string& id);
+    bool requeue(const std::string& id);
+    message_ptr find(const std::string& id) const;
+    std::size_t unacked_count() const;
+
+    std::size_t getable_count() const;
+    std::deque<message_ptr> get_all_messages() const;
     void recovery();   // 从磁盘恢复
 
     stats get_stats() const;
     void compact();
 
+    // 把入口环中已发布的消息批量搬进主存储，返回搬运条数（由派发方 / 读取方调用）
+    size_t drain_ingress(size_t max_batch = INGRESS_RING_CAPACITY);
 
 private:
-    bool write_persistent(message_ptr& msg);
+    // 磁盘记录位置：共享消息在每个队列文件中的偏移不同，不能存在 Message 里
+    struct record_pos {
+        uint64_t offset{0};
+        uint64_t length{0};
+        uint32_t valid_at{0};   // valid 字段取值字节在记录体内的偏移，0 表示未找到
+    };
+
+    bool write_persistent(const message_ptr& msg);
     void invalidate_persistent(const message_ptr& msg);
-    std::deque<message_ptr> msgs_;
+    void rewrite_persistent(const message_ptr& msg);
+    // 消息可能被其他队列共享：修改投递状态前复制一份（仅复制本队列持有的条目）
+    message_ptr detach_locked(message_ptr msg);   // 需持有 store_mtx_
+    // 落盘镜像：redelivered 由 delivery_count 推出不写入，保证同一条记录改写前后长度一致；
+    // 达到压缩阈值的消息体按 codec_ 压缩（deflate 输出确定，改写后长度同样不变）
+    std::string serialize_record(const MessagePayload& payload, const char* valid) const;
+    // 在序列化好的记录里定位 valid 字段的取值字节（写入 / 恢复时各算一次）；
+    // 作废记录只改这一个字节，不必重新序列化和压缩
+    static uint32_t locate_valid(const std::string& data);
+    void mark_invalid(const record_pos& rec);   // 需持有 mtx_
+    // 解析落盘记录并还原压缩的消息体；失败返回 false
+    bool parse_record(const std::string& data, MessagePayload* payload) const;
+    size_t drain_locked(size_t max_batch) const;   // 需持有 store_mtx_
+
+    // 发布方（多线程）只做一次 CAS 写入 ingress_；消费侧持 store_mtx_ 时单线程 drain 进 msgs_
+    mutable mpsc_ring<message_ptr> ingress_{INGRESS_RING_CAPACITY};
+    // 队列节点（deque 分块、哈希表节点）来自 slab 池，入队出队不反复向全局堆申请
+    template <class K, class V>
+    using slab_map = std::unordered_map<K, V, std::hash<K>, std::equal_to<K>,
+                                        slab_allocator<std::pair<const K, V>>>;
+    mutable std::deque<message_ptr, slab_allocator<message_ptr>> msgs_;
+    slab_map<uint64_t, message_ptr> outstanding_;   // 已投递未确认：numeric_id → msg
+    mutable std::mutex     store_mtx_;   // 保护 msgs_ / outstanding_ 及 ingress_ 的消费端；先于 mtx_ 加锁
     std::string            file_path_;
-    mutable std::mutex     mtx_;
-    std::fstream           file_;
+    body_codec             codec_;
+    message_alloc          alloc_;
+    mutable std::mutex     mtx_;         // 保护持久化文件及 positions_
+    slab_map<const Message*, record_pos> positions_;   // 本队列的持久化消息 → 记录位置
+    mutable std::fstream   file_;
 };
 
 } // namespace hz_mq
 
 // ==================== Implementation ====================
+inline hz_mq::message_alloc hz_mq::message_alloc_from_args(
+    const std::unordered_map<std::string, std::string>& args)
+{
+    auto it = args.find("x-message-alloc");
+    return it != args.end() && it->second == "heap" ? message_alloc::heap : message_alloc::slab;
+}
+
+inline hz_mq::message_ptr hz_mq::new_message(message_alloc alloc)
+{
+    if (alloc == message_alloc::slab) return std::allocate_shared<Message>(slab_allocator<Message>());
+    return std::make_shared<Message>();
+}
+
+inline hz_mq::message_ptr hz_mq::new_message(message_alloc alloc, const Message& src)
+{
+    if (alloc == message_alloc::slab) return std::allocate_shared<Message>(slab_allocator<Message>(), src);
+    return std::make_shared<Message>(src);
+}
+
 inline hz_mq::queue_message::queue_message(const std::string& base_dir,
-                                           const std::string& queue_name)
-    : file_path_(base_dir + "/" + queue_name + ".mqd")
+                                           const std::string& queue_name,
+                                           const body_codec& codec,
+                                           message_alloc alloc)
+    : file_path_(base_dir + "/" + queue_name + ".mqd"), codec_(codec), alloc_(alloc)
 {
     namespace fs = std::filesystem;
     if (!fs::exists(base_dir))
@@ -88,14 +196,78 @@ inline hz_mq::queue_message::~queue_message()
     if (file_.is_open()) file_.close();
 }
 
-inline bool hz_mq::queue_message::write_persistent(message_ptr& msg)
+inline std::string hz_mq::queue_message::serialize_record(const MessagePayload& payload,
+                                                         const char* valid) const
+{
+    MessagePayload image = payload;
+    image.set_valid(valid);
+    image.mutable_properties()->clear_redelivered();
+    if (!image.has_delivery_count()) image.set_delivery_count(0);
+    std::string packed;
+    if (codec_.encode(payload.body(), &packed)) {
+        image.set_body(std::move(packed));
+        image.set_body_encoding(ENCODING_DEFLATE);
+    }
+    std::string data;
+    image.SerializeToString(&data);
+    return data;
+}
+
+inline uint32_t hz_mq::queue_message::locate_valid(const std::string& data)
+{
+    namespace io = google::protobuf::io;
+    io::CodedInputStream in(reinterpret_cast<const uint8_t*>(data.data()), static_cast<int>(data.size()));
+    // 逐个跳过字段直到 valid（字段号 3、长度前缀类型）；只认长度为 1 的取值
+    while (uint32_t tag = in.ReadTag()) {
+        uint32_t n = 0;
+        uint64_t v = 0;
+        switch (tag & 7) {
+        case 0: if (!in.ReadVarint64(&v)) return 0; break;
+        case 1: if (!in.Skip(8)) return 0; break;
+        case 5: if (!in.Skip(4)) return 0; break;
+        case 2:
+            if (!in.ReadVarint32(&n)) return 0;
+            if ((tag >> 3) == MessagePayload::kValidFieldNumber)
+                return n == 1 ? static_cast<uint32_t>(in.CurrentPosition()) : 0;
+            if (!in.Skip(static_cast<int>(n))) return 0;
+            break;
+        default: return 0;
+        }
+    }
+    return 0;
+}
+
+inline void hz_mq::queue_message::mark_invalid(const record_pos& rec)
+{
+    if (rec.valid_at == 0) {
+        LOG(WARNING) << "cannot invalidate record at " << rec.offset << " in " << file_path_
+                     << ": valid field not found";
+        return;
+    }
+    file_.seekp(rec.offset + sizeof(uint32_t) + rec.valid_at, std::ios::beg);
+    file_.put('0');
+}
+
+inline bool hz_mq::queue_message::parse_record(const std::string& data,
+                                               MessagePayload* payload) const
+{
+    if (!payload->ParseFromString(data)) return false;
+    if (payload->body_encoding().empty()) return true;
+
+    std::string body;
+    if (payload->body_encoding() != ENCODING_DEFLATE || !codec_.decode(payload->body(), &body, MAX_BODY_BYTES))
+        return false;
+    payload->set_body(std::move(body));
+    payload->clear_body_encoding();
+    return true;
+}
+
+inline bool hz_mq::queue_message::write_persistent(const message_ptr& msg)
 {
     std::lock_guard<std::mutex> lk(mtx_);
     if (!file_.is_open()) return false;
 
-    msg->mutable_payload()->set_valid("1");
-    std::string data;
-    msg->payload().SerializeToString(&data);
+    std::string data = serialize_record(msg->payload(), "1");
     uint32_t len = static_cast<uint32_t>(data.size());
 
     file_.seekp(0, std::ios::end);
@@ -103,59 +275,148 @@ inline bool hz_mq::queue_message::write_persistent(message_ptr& msg)
     file_.write(reinterpret_cast<const char*>(&len), sizeof(len));
     file_.write(data.data(), data.size());
     file_.flush();
+    if (!file_.good()) return false;
 
-    msg->set_offset(static_cast<uint64_t>(pos));
-    msg->set_length(sizeof(len) + len);
-    return file_.good();
+    positions_[msg.get()] = record_pos{static_cast<uint64_t>(pos), sizeof(len) + len, locate_valid(data)};
+    return true;
 }
 
-inline bool hz_mq::queue_message::insert(BasicProperties* bp,
-                                         const std::string& body,
-                                         bool durable)
+inline hz_mq::message_ptr hz_mq::queue_message::make_message(const BasicProperties* bp,
+                                                             const std::string& body,
+                                                             message_alloc alloc)
 {
-    auto msg = std::make_shared<Message>();
+    auto msg = new_message(alloc);
     if (bp)
         *msg->mutable_payload()->mutable_properties() = *bp;
     msg->mutable_payload()->set_body(body);
+    msg->mutable_payload()->set_valid("1");
+    if (msg->payload().properties().numeric_id() == 0)
+        msg->mutable_payload()->mutable_properties()->set_numeric_id(next_message_id());
+    return msg;
+}
+
+inline bool hz_mq::queue_message::insert(BasicProperties* bp,
+                                         const std::string& body,
+                                         bool durable)
+{
+    return insert(make_message(bp, body, alloc_), durable);
+}
 
-    if (durable)
-        write_persistent(msg);
+inline bool hz_mq::queue_message::insert(const message_ptr& msg, bool durable)
+{
+    if (durable && !write_persistent(msg)) {
+        LOG(ERROR) << "persist failed: " << file_path_;
+        return false;
+    }
 
-    msgs_.push_back(std::move(msg));
+    message_ptr entry = msg;
+    if (ingress_.try_push(std::move(entry)))
+        return true;
+
+    // 入口环已满：加锁先把环内消息搬走以保持顺序，再直接入队
+    std::lock_guard<std::mutex> lk(store_mtx_);
+    drain_locked(INGRESS_RING_CAPACITY);
+    msgs_.push_back(msg);
     return true;
 }
 
-inline void hz_mq::queue_message::invalidate_persistent(const message_ptr& msg)
+inline size_t hz_mq::queue_message::drain_locked(size_t max_batch) const
 {
-    if (msg->length() == 0) return;
+    return ingress_.drain([this](message_ptr&& m) { msgs_.push_back(std::move(m)); },
+                          max_batch);
+}
 
+inline size_t hz_mq::queue_message::drain_ingress(size_t max_batch)
+{
+    std::lock_guard<std::mutex> lk(store_mtx_);
+    return drain_locked(max_batch);
+}
+
+inline hz_mq::message_ptr hz_mq::queue_message::front() const
+{
+    std::lock_guard<std::mutex> lk(store_mtx_);
+    drain_locked(INGRESS_RING_CAPACITY);
+    return msgs_.empty() ? nullptr : msgs_.front();
+}
+
+inline std::size_t hz_mq::queue_message::getable_count() const
+{
+    std::lock_guard<std::mutex> lk(store_mtx_);
+    drain_locked(INGRESS_RING_CAPACITY);
+    return msgs_.size();
+}
+
+inline std::deque<hz_mq::message_ptr> hz_mq::queue_message::get_all_messages() const
+{
+    std::lock_guard<std::mutex> lk(store_mtx_);
+    drain_locked(INGRESS_RING_CAPACITY);
+    return std::deque<message_ptr>(msgs_.begin(), msgs_.end());
+}
+
+inline void hz_mq::queue_message::invalidate_persistent(const message_ptr& msg)
+{
     std::lock_guard<std::mutex> lk(mtx_);
+    auto pit = positions_.find(msg.get());
+    if (pit == positions_.end()) return;
+    record_pos rec = pit->second;
+    positions_.erase(pit);
     if (!file_.is_open()) return;
 
-    MessagePayload payload = msg->payload();
-    payload.set_valid("0");
-    std::string data;
-    payload.SerializeToString(&data);
-    uint32_t len = static_cast<uint32_t>(data.size());
-
-    file_.seekp(msg->offset() + sizeof(uint32_t), std::ios::beg);
-    file_.write(data.data(), len);
+    // 只改写 valid 的一个字节：记录长度不变，也不用在确认路径上重新序列化 / 压缩
+    mark_invalid(rec);
     file_.flush();
 }
 
-inline void hz_mq::queue_message::remove(const std::string& id)
+inline void hz_mq::queue_message::rewrite_persistent(const message_ptr& msg)
 {
-    if (msgs_.empty()) return;
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto pit = positions_.find(msg.get());
+    if (pit == positions_.end() || !file_.is_open()) return;
+    record_pos& rec = pit->second;
 
-    if (id.empty()) {
-        auto msg = msgs_.front();
-        invalidate_persistent(msg);
-        msgs_.pop_front();
+    std::string data = serialize_record(msg->payload(), "1");
+    uint32_t len = static_cast<uint32_t>(data.size());
+    if (sizeof(len) + len == rec.length) {
+        // 长度不变：原地改写
+        file_.seekp(rec.offset + sizeof(uint32_t), std::ios::beg);
+        file_.write(data.data(), len);
+        file_.flush();
+        rec.valid_at = locate_valid(data);
         return;
     }
 
+    // 旧格式记录（无 delivery_count / numeric_id）：先追加新记录再作废旧记录，崩溃时至多重复一条
+    file_.seekp(0, std::ios::end);
+    std::streampos pos = file_.tellp();
+    file_.write(reinterpret_cast<const char*>(&len), sizeof(len));
+    file_.write(data.data(), data.size());
+
+    mark_invalid(rec);
+    file_.flush();
+
+    rec = record_pos{static_cast<uint64_t>(pos), sizeof(len) + len, locate_valid(data)};
+}
+
+inline hz_mq::message_ptr hz_mq::queue_message::detach_locked(message_ptr msg)
+{
+    // 只有本函数持有引用时可以直接修改；否则复制，并把磁盘位置转到副本名下
+    if (msg.use_count() == 1) return msg;
+    auto copy = new_message(alloc_, *msg);
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto pit = positions_.find(msg.get());
+    if (pit != positions_.end()) {
+        positions_[copy.get()] = pit->second;
+        positions_.erase(pit);
+    }
+    return copy;
+}
+
+inline void hz_mq::queue_message::remove(uint64_t id)
+{
+    std::lock_guard<std::mutex> store_lk(store_mtx_);
+    drain_locked(INGRESS_RING_CAPACITY);
     for (auto it = msgs_.begin(); it != msgs_.end(); ++it) {
-        if ((*it)->payload().properties().id() == id) {
+        if ((*it)->payload().properties().numeric_id() == id) {
             invalidate_persistent(*it);
             msgs_.erase(it);
             break;
@@ -163,38 +424,199 @@ inline void hz_mq::queue_message::remove(const std::string& id)
     }
 }
 
-inline void hz_mq::queue_message::recovery()
+inline hz_mq::message_ptr hz_mq::queue_message::take()
 {
-    std::lock_guard<std::mutex> lk(mtx_);
-    if (!file_.is_open()) return;
+    std::lock_guard<std::mutex> lk(store_mtx_);
+    drain_locked(INGRESS_RING_CAPACITY);
+    if (msgs_.empty()) return nullptr;
+
+    message_ptr msg = std::move(msgs_.front());
+    msgs_.pop_front();
+    outstanding_.emplace(msg->payload().properties().numeric_id(), msg);
+    return msg;
+}
 
-    file_.seekg(0, std::ios::beg);
-    std::streampos pos = file_.tellg();
-    while (true) {
-        uint32_t len = 0;
-        if (!file_.read(reinterpret_cast<char*>(&len), sizeof(len))) break;
-        std::string data(len, '\0');
-        if (!file_.read(&data[0], len)) break;
+inline hz_mq::message_ptr hz_mq::queue_message::pop()
+{
+    std::lock_guard<std::mutex> lk(store_mtx_);
+    drain_locked(INGRESS_RING_CAPACITY);
+    if (msgs_.empty()) return nullptr;
+
+    message_ptr msg = std::move(msgs_.front());
+    msgs_.pop_front();
+    invalidate_persistent(msg);
+    return msg;
+}
 
-        MessagePayload payload;
-        if (!payload.ParseFromString(data)) break;
+inline std::vector<hz_mq::message_ptr> hz_mq::queue_message::pop_n(size_t max_count, bool auto_ack)
+{
+    std::vector<message_ptr> out;
+    std::lock_guard<std::mutex> lk(store_mtx_);
+    drain_locked(INGRESS_RING_CAPACITY);
+    size_t n = std::min(max_count, msgs_.size());
+    out.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        message_ptr msg = std::move(msgs_.front());
+        msgs_.pop_front();
+        if (auto_ack) invalidate_persistent(msg);
+        else outstanding_.emplace(msg->payload().properties().numeric_id(), msg);
+        out.push_back(std::move(msg));
+    }
+    return out;
+}
+
+inline bool hz_mq::queue_message::ack(uint64_t id)
+{
+    {
+        std::lock_guard<std::mutex> lk(store_mtx_);
+        auto it = outstanding_.find(id);
+        if (it != outstanding_.end()) {
+            invalidate_persistent(it->second);
+            outstanding_.erase(it);
+            return true;
+        }
+    }
+    // 未经 take 投递的消息：沿用按 id 直接删除的语义
+    remove(id);
+    return false;
+}
+
+inline bool hz_mq::queue_message::requeue(uint64_t id)
+{
+    std::lock_guard<std::mutex> lk(store_mtx_);
+    auto it = outstanding_.find(id);
+    if (it == outstanding_.end()) return false;
+
+    message_ptr msg = detach_locked(std::move(it->second));
+    outstanding_.erase(it);
+    MessagePayload* payload = msg->mutable_payload();
+    payload->set_delivery_count(payload->delivery_count() + 1);
+    payload->mutable_properties()->set_redelivered(true);
+    rewrite_persistent(msg);
+    msgs_.push_front(std::move(msg));
+    return true;
+}
 
-        auto msg = std::make_shared<Message>();
-        *msg->mutable_payload() = payload;
-        msg->set_offset(static_cast<uint64_t>(pos));
-        msg->set_length(sizeof(len) + len);
+inline hz_mq::message_ptr hz_mq::queue_message::find(uint64_t id) const
+{
+    std::lock_guard<std::mutex> lk(store_mtx_);
+    auto it = outstanding_.find(id);
+    if (it != outstanding_.end()) return it->second;
+
+    drain_locked(INGRESS_RING_CAPACITY);
+    for (const auto& m : msgs_) {
+        if (m->payload().properties().numeric_id() == id) return m;
+    }
+    return nullptr;
+}
 
-        if (payload.valid() == "1")
-            msgs_.push_back(std::move(msg));
+inline uint64_t hz_mq::queue_message::lookup_id(const std::string& id) const
+{
+    if (id.empty()) return 0;
+    {
+        std::lock_guard<std::mutex> lk(store_mtx_);
+        for (const auto& [num, m] : outstanding_) {
+            if (m->payload().properties().id() == id) return num;
+        }
+        drain_locked(INGRESS_RING_CAPACITY);
+        for (const auto& m : msgs_) {
+            if (m->payload().properties().id() == id) return m->payload().properties().numeric_id();
+        }
+    }
+    // 数值 id 的十进制文本
+    if (id.find_first_not_of("0123456789") != std::string::npos || id.size() > 20) return 0;
+    try {
+        return std::stoull(id);
+    } catch (const std::exception&) {
+        return 0;
+    }
+}
 
-        pos = file_.tellg();
+inline void hz_mq::queue_message::remove(const std::string& id)
+{
+    if (id.empty()) {
+        std::lock_guard<std::mutex> store_lk(store_mtx_);
+        drain_locked(INGRESS_RING_CAPACITY);
+        if (msgs_.empty()) return;
+        invalidate_persistent(msgs_.front());
+        msgs_.pop_front();
+        return;
     }
+    if (uint64_t num = lookup_id(id)) remove(num);
+}
+
+inline bool hz_mq::queue_message::ack(const std::string& id)
+{
+    if (id.empty()) {
+        remove(id);
+        return false;
+    }
+    uint64_t num = lookup_id(id);
+    return num != 0 && ack(num);
+}
+
+inline bool hz_mq::queue_message::requeue(const std::string& id)
+{
+    uint64_t num = lookup_id(id);
+    return num != 0 && requeue(num);
+}
+
+inline hz_mq::message_ptr hz_mq::queue_message::find(const std::string& id) const
+{
+    uint64_t num = lookup_id(id);
+    return num != 0 ? find(num) : nullptr;
+}
+
+inline std::size_t hz_mq::queue_message::unacked_count() const
+{
+    std::lock_guard<std::mutex> lk(store_mtx_);
+    return outstanding_.size();
+}
+
+inline void hz_mq::queue_message::recovery()
+{
+    // 先在文件锁内读出，再在队列锁内并入，保持 store_mtx_ → mtx_ 的加锁顺序
+    std::deque<message_ptr> recovered;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (!file_.is_open()) return;
+
+        file_.seekg(0, std::ios::beg);
+        std::streampos pos = file_.tellg();
+        while (true) {
+            uint32_t len = 0;
+            if (!file_.read(reinterpret_cast<char*>(&len), sizeof(len))) break;
+            std::string data(len, '\0');
+            if (!file_.read(&data[0], len)) break;
+
+            MessagePayload payload;
+            if (!parse_record(data, &payload)) break;
+
+            if (payload.valid() == "1") {
+                auto msg = new_message(alloc_);
+                *msg->mutable_payload() = std::move(payload);
+                if (msg->payload().delivery_count() > 0)
+                    msg->mutable_payload()->mutable_properties()->set_redelivered(true);
+                if (msg->payload().properties().numeric_id() == 0)   // 旧格式记录：补分配，仅存于内存
+                    msg->mutable_payload()->mutable_properties()->set_numeric_id(next_message_id());
+                positions_[msg.get()] = record_pos{static_cast<uint64_t>(pos), sizeof(len) + len, locate_valid(data)};
+                recovered.push_back(std::move(msg));
+            }
+
+            pos = file_.tellg();
+        }
+        file_.clear();   // 读到末尾后清除 eof/fail 位，否则后续追加写失败
+    }
+
+    std::lock_guard<std::mutex> store_lk(store_mtx_);
+    drain_locked(INGRESS_RING_CAPACITY);
+    msgs_.insert(msgs_.begin(), recovered.begin(), recovered.end());
 }
 
 inline hz_mq::queue_message::stats hz_mq::queue_message::get_stats() const
 {
     stats s{};
-    s.depth = msgs_.size();
+    s.depth = getable_count();
 
     namespace fs = std::filesystem;
     if (fs::exists(file_path_)) {
@@ -228,6 +650,8 @@ inline hz_mq::queue_message::stats hz_mq::queue_message::get_stats() const
 
 inline void hz_mq::queue_message::compact()
 {
+    std::lock_guard<std::mutex> store_lk(store_mtx_);
+    drain_locked(INGRESS_RING_CAPACITY);
     std::lock_guard<std::mutex> lk(mtx_);
     if (!file_.is_open()) return;
 
@@ -236,17 +660,22 @@ inline void hz_mq::queue_message::compact()
     std::fstream tmp(tmp_path, std::ios::out | std::ios::binary);
     if (!tmp.is_open()) return;
 
+    // 未确认消息仍需保留在磁盘上，否则崩溃后会丢失；非持久化消息不落盘
+    std::vector<message_ptr> live;
+    live.reserve(outstanding_.size() + msgs_.size());
+    for (auto& [_, msg] : outstanding_) live.push_back(msg);
+    live.insert(live.end(), msgs_.begin(), msgs_.end());
+
     std::streampos pos = 0;
-    for (auto& msg : msgs_) {
-        MessagePayload payload = msg->payload();
-        std::string data;
-        payload.SerializeToString(&data);
+    for (auto& msg : live) {
+        auto pit = positions_.find(msg.get());
+        if (pit == positions_.end()) continue;
+        std::string data = serialize_record(msg->payload(), "1");
         uint32_t len = static_cast<uint32_t>(data.size());
         tmp.write(reinterpret_cast<const char*>(&len), sizeof(len));
         tmp.write(data.data(), data.size());
         tmp.flush();
-        msg->set_offset(static_cast<uint64_t>(pos));
-        msg->set_length(sizeof(len) + len);
+        pit->second = record_pos{static_cast<uint64_t>(pos), sizeof(len) + len, locate_valid(data)};
         pos = tmp.tellp();
     }
     tmp.close();
@@ -0,0 +1,75 @@
+// ======================= scatter_send.cpp =======================
+#include "scatter_send.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <zlib.h>
+
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpConnection.h"
+
+namespace hz_mq {
+
+void send_scattered(const muduo::net::TcpConnectionPtr& conn, std::string head,
+                    const message_ptr& mp, std::string tail)
+{
+    muduo::net::EventLoop* loop = conn->getLoop();
+    loop->runInLoop([conn, head = std::move(head), mp, tail = std::move(tail)] {
+        const std::string& body = mp->payload().body();
+        conn->send(head.data(), static_cast<int>(head.size()));
+        conn->send(body.data(), static_cast<int>(body.size()));
+        if (!tail.empty()) conn->send(tail.data(), static_cast<int>(tail.size()));
+    });
+}
+
+static void append_int32(std::string& out, int32_t v)
+{
+    uint32_t be = htonl(static_cast<uint32_t>(v));
+    out.append(reinterpret_cast<const char*>(&be), sizeof(be));
+}
+
+static void append_varint(std::string& out, uint64_t v)
+{
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+void build_body_frame(const google::protobuf::Message& msg, int body_field, const std::string& body,
+                      std::string* head, std::string* tail)
+{
+    const std::string& type_name = msg.GetTypeName();
+
+    // len(4) | nameLen(4) | typeName\0 | msg | body 字段 tag + 长度 || body || adler32(4)
+    head->clear();
+    head->reserve(64 + type_name.size() + msg.ByteSizeLong());
+    head->resize(sizeof(int32_t));   // 长度最后回填
+    append_int32(*head, static_cast<int32_t>(type_name.size() + 1));
+    head->append(type_name.c_str(), type_name.size() + 1);
+    msg.AppendToString(head);
+    append_varint(*head, (static_cast<uint32_t>(body_field) << 3) | 2);   // length-delimited
+    append_varint(*head, body.size());
+
+    uLong sum = ::adler32(1, reinterpret_cast<const Bytef*>(head->data() + sizeof(int32_t)),
+                          static_cast<uInt>(head->size() - sizeof(int32_t)));
+    sum = ::adler32(sum, reinterpret_cast<const Bytef*>(body.data()), static_cast<uInt>(body.size()));
+    tail->clear();
+    append_int32(*tail, static_cast<int32_t>(sum));
+
+    uint32_t len = htonl(static_cast<uint32_t>(head->size() - sizeof(int32_t) + body.size() + tail->size()));
+    std::memcpy(&(*head)[0], &len, sizeof(len));
+}
+
+void send_with_body(const muduo::net::TcpConnectionPtr& conn, const google::protobuf::Message& msg,
+                    int body_field, const message_ptr& mp)
+{
+    std::string head, tail;
+    build_body_frame(msg, body_field, mp->payload().body(), &head, &tail);
+    send_scattered(conn, std::move(head), mp, std::move(tail));
+}
+
+} // namespace hz_mq
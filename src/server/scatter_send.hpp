@@ -0,0 +1,46 @@
+// ======================= scatter_send.hpp =======================
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include <google/protobuf/message.h>
+
+#include "../common/msg.pb.h"      // Message
+
+namespace muduo {
+namespace net {
+class TcpConnection;
+using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
+} // namespace net
+} // namespace muduo
+
+namespace hz_mq {
+
+using message_ptr = std::shared_ptr<Message>;
+
+// -----------------------------------------------------------------
+// 大消息体分段发送：帧头 / 帧尾来自小缓冲，消息体直接引用共享 Message。
+//   · 发送切到连接所属 EventLoop 上执行，输出缓冲为空时 muduo 直接 write 到 socket，
+//     消息体不经过 protobuf 序列化，也不做跨线程的整帧字符串拷贝
+//   · 闭包持有 message_ptr，写出前消息体不会被释放
+//   · 与其他线程的 send 同样经 runInLoop 排队，帧间顺序不变
+// 小于 SCATTER_MIN_BODY 的消息体拷贝更便宜，仍走 codec->send
+// -----------------------------------------------------------------
+inline constexpr size_t SCATTER_MIN_BODY = 64 * 1024;
+
+// head + 消息体 + tail 依次发出
+void send_scattered(const muduo::net::TcpConnectionPtr& conn, std::string head,
+                    const message_ptr& mp, std::string tail);
+
+// 按 ProtobufCodec 帧格式构造 msg + body 字段的帧头与帧尾（head + body + tail 即完整帧）
+void build_body_frame(const google::protobuf::Message& msg, int body_field, const std::string& body,
+                      std::string* head, std::string* tail);
+
+// 以 ProtobufCodec 帧格式发送 msg，并把 mp 的消息体作为 body_field（bytes）字段追加在末尾；
+// msg 自身不应设置该字段。adler32 校验跨分段增量计算
+void send_with_body(const muduo::net::TcpConnectionPtr& conn, const google::protobuf::Message& msg,
+                    int body_field, const message_ptr& mp);
+
+} // namespace hz_mq
@@ -0,0 +1,131 @@
+// ======================= shm_endpoint.cpp =======================
+#include "shm_endpoint.hpp"
+#include "../common/logger.hpp"
+#include "muduo/net/Channel.h"
+#include "muduo/net/EventLoop.h"
+
+namespace hz_mq {
+
+shm_endpoint::shm_endpoint(muduo::net::EventLoop* loop, shm_region::ptr region,
+                           frame_callback on_frame, error_callback on_error)
+    : __loop(loop), __region(std::move(region)),
+      __in(__region->ring(SHM_C2S)), __out(__region->ring(SHM_S2C)),
+      __on_frame(std::move(on_frame)), __on_error(std::move(on_error))
+{
+}
+
+shm_endpoint::~shm_endpoint() = default;
+
+shm_endpoint::ptr shm_endpoint::create(muduo::net::EventLoop* loop, size_t ring_bytes,
+                                       frame_callback on_frame, error_callback on_error)
+{
+    auto region = shm_region::create(ring_bytes ? ring_bytes : SHM_DEFAULT_RING);
+    if (!region) return nullptr;
+    return std::make_shared<shm_endpoint>(loop, std::move(region), std::move(on_frame), std::move(on_error));
+}
+
+void shm_endpoint::start()
+{
+    auto self = shared_from_this();
+    __loop->runInLoop([self] {
+        if (self->__closed || self->__channel) return;
+        self->__channel = std::make_unique<muduo::net::Channel>(self->__loop, self->__region->event_fd(SHM_C2S));
+        self->__channel->setReadCallback([raw = self.get()](muduo::Timestamp) { raw->on_readable(); });
+        self->sync_reading();
+    });
+}
+
+void shm_endpoint::close()
+{
+    if (__closed.exchange(true)) return;
+    auto self = shared_from_this();
+    __loop->runInLoop([self] {
+        if (!self->__channel) return;
+        if (self->__reading) self->__channel->disableAll();
+        self->__channel->remove();
+        self->__reading = false;
+        // 可能正处于本 Channel 的事件回调中：延后到本轮事件处理结束再析构
+        self->__loop->queueInLoop([self] { self->__channel.reset(); });
+    });
+}
+
+void shm_endpoint::pause()
+{
+    if (__paused.exchange(true)) return;
+    auto self = shared_from_this();
+    __loop->runInLoop([self] { self->sync_reading(); });
+}
+
+void shm_endpoint::resume()
+{
+    if (!__paused.exchange(false)) return;
+    auto self = shared_from_this();
+    __loop->runInLoop([self] { self->sync_reading(); });
+}
+
+void shm_endpoint::sync_reading()
+{
+    if (__closed || !__channel) return;
+    bool want = !__paused.load(std::memory_order_acquire);
+    if (want != __reading) {
+        __reading = want;
+        if (want) __channel->enableReading();
+        else __channel->disableAll();
+    }
+    // 暂停期间客户端看到读端未休眠，不会敲门铃：恢复时直接读一遍
+    // （pause / resume 相继发生时 __reading 可能未变，环里仍可能留着暂停时没读的帧）
+    if (want) on_readable();
+}
+
+void shm_endpoint::on_readable()
+{
+    if (__closed || !__reading) return;
+    shm_region::clear(__region->event_fd(SHM_C2S));
+    __in.wake_up();
+
+    // 每帧之后检查背压：处理帧时触发的 pause 要立即生效，剩下的帧留在环里等 resume
+    auto stopped = [this] { return __closed || !__reading || __paused.load(std::memory_order_acquire); };
+    while (true) {
+        bool bad = false;
+        __in.drain([this, &bad, &stopped](const char* data, size_t len) {
+            fast_frame f;
+            if (decode_fast_frame(data, len, &f) != static_cast<long>(len)) {
+                bad = true;
+                return false;
+            }
+            __on_frame(f);
+            return !stopped();
+        });
+        if (bad || __in.broken()) {
+            fail(bad ? "malformed frame in ring" : "peer index corrupted");
+            return;
+        }
+        if (stopped()) return;                     // 处理帧时触发了背压或连接关闭
+        if (__in.prepare_sleep()) return;          // 确认已空再等门铃
+    }
+}
+
+void shm_endpoint::fail(const char* why)
+{
+    if (__closed) return;
+    LOG(WARNING) << "shm transport closed: " << why;
+    close();
+    if (__on_error) __on_error();
+}
+
+bool shm_endpoint::send(std::string_view head, std::string_view body)
+{
+    if (__closed.load(std::memory_order_acquire) || !__region->peer_attached()) return false;
+    {
+        std::lock_guard<std::mutex> lk(__out_mtx);
+        if (!__out.push(head, body)) {
+            if (__out.broken()) fail("peer index corrupted");
+            return false;
+        }
+        if (!__out.reader_sleeping()) return true;
+    }
+    shm_region::notify(__region->event_fd(SHM_S2C));
+    return true;
+}
+
+} // namespace hz_mq
@@ -0,0 +1,75 @@
+// ======================= shm_endpoint.hpp =======================
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "../common/fast_frame.hpp"
+#include "../common/shm_ring.hpp"
+
+namespace muduo {
+namespace net {
+class EventLoop;
+class Channel;
+} // namespace net
+} // namespace muduo
+
+namespace hz_mq {
+
+// -----------------------------------------------------------------
+// broker 侧的共享内存端点：一条 TCP 连接至多一个
+//   · C2S 门铃 eventfd 注册在连接所属 EventLoop 上，读出的二进制帧交给 on_frame，
+//     与 TCP 上收到的 PUBLISH / ACK 帧走同一处理路径
+//   · send 由投递线程调用，写锁串行化多个写者；客户端尚未取走 fd、环满或帧过大时返回 false，调用方改走 TCP
+//   · pause / resume 对应发布方背压：暂停期间不读 C2S 环，客户端写满后自行等待
+//   · 对端写坏了共享区（位置未对齐 / 回退、长度越界或帧非法）时停止读写并调用 on_error，由连接关闭 TCP
+// start / close / pause / resume 可在任意线程调用，实际操作转到 loop 线程
+// -----------------------------------------------------------------
+class shm_endpoint : public std::enable_shared_from_this<shm_endpoint> {
+public:
+    using ptr = std::shared_ptr<shm_endpoint>;
+    using frame_callback = std::function<void(const fast_frame&)>;
+    using error_callback = std::function<void()>;
+
+    shm_endpoint(muduo::net::EventLoop* loop, shm_region::ptr region,
+                 frame_callback on_frame, error_callback on_error);
+    ~shm_endpoint();
+
+    // 创建共享区失败返回 nullptr
+    static ptr create(muduo::net::EventLoop* loop, size_t ring_bytes,
+                      frame_callback on_frame, error_callback on_error);
+
+    const shm_region& region() const { return *__region; }
+
+    void start();
+    void close();
+    void pause();
+    void resume();
+
+    // 写一帧到 S2C 环：head 为帧头（含 name / key / id），body 为消息体
+    bool send(std::string_view head, std::string_view body);
+
+private:
+    void on_readable();
+    void sync_reading();   // 按 __paused 开关读事件
+    void fail(const char* why);
+
+    muduo::net::EventLoop*               __loop;
+    shm_region::ptr                      __region;
+    // 两个环对象各自保存本端的读 / 写位置，控制页里对端可改的值只作校验后的参考
+    shm_ring                             __in;       // C2S，仅 loop 线程读
+    shm_ring                             __out;      // S2C，受 __out_mtx 保护
+    std::mutex                           __out_mtx;
+    frame_callback                       __on_frame;
+    error_callback                       __on_error;
+    std::unique_ptr<muduo::net::Channel> __channel;
+    std::atomic<bool>                    __paused{false};
+    std::atomic<bool>                    __closed{false};
+    bool                                 __reading{false};   // 仅 loop 线程访问
+};
+
+} // namespace hz_mq
@@ -4,20 +4,12 @@
 #include "route.hpp"                // 若 queue_message 里需要路由，可引
 
 #include "queue_message.hpp"        // 假设有该头（持久化实现）
+#include <algorithm>
+#include <mutex>
 #include <utility>
 
 namespace hz_mq {
 
-// -----------------------------------------------------------------------------
-// helper: 生成全局唯一 msg id（简单递增）
-// -----------------------------------------------------------------------------
-std::string virtual_host::generate_id()
-{
-    static std::atomic<uint64_t> seq{0};
-    uint64_t id_num = ++seq;
-    return std::to_string(id_num);
-}
-
 // -----------------------------------------------------------------------------
 // ctor
 // -----------------------------------------------------------------------------
@@ -35,8 +27,9 @@ virtual_host::virtual_host(const std::string& name,
     }
 
     // 为恢复的所有队列创建 queue_message 容器并恢复持久化消息
-    for (const auto& [qname, _] : __queue_mgr.all()) {
-        auto qm = std::make_shared<queue_message>(__base_dir, qname);
+    for (const auto& [qname, q] : __queue_mgr.all()) {
+        auto qm = std::make_shared<queue_message>(__base_dir, qname, body_codec::from_args(q->args),
+                                                  message_alloc_from_args(q->args));
         qm->recovery();
         __queue_messages[qname] = std::move(qm);
     }
@@ -49,17 +42,20 @@ bool virtual_host::declare_exchange(const std::string& exchange_name, ExchangeTy
                                     bool durable, bool auto_delete,
                                     const std::unordered_map<std::string, std::string>& args)
 {
+    std::unique_lock<std::shared_mutex> lock(__mtx);
     return __exchange_mgr.declare_exchange(exchange_name, type, durable, auto_delete, args);
 }
 
 void virtual_host::delete_exchange(const std::string& exchange_name)
 {
+    std::unique_lock<std::shared_mutex> lock(__mtx);
     __exchange_bindings.erase(exchange_name);
     __exchange_mgr.delete_exchange(exchange_name);
 }
 
 exchange::ptr virtual_host::select_exchange(const std::string& exchange_name)
 {
+    std::shared_lock<std::shared_mutex> lock(__mtx);
     return __exchange_mgr.select_exchange(exchange_name);
 }
 
@@ -70,16 +66,18 @@ bool virtual_host::declare_queue(const std::string& queue_name, bool durable, bo
                                  bool auto_delete,
                                  const std::unordered_map<std::string, std::string>& args)
 {
+    std::unique_lock<std::shared_mutex> lock(__mtx);
     if (!__queue_mgr.declare_queue(queue_name, durable, exclusive, auto_delete, args))
         return false;
 
     if (!__queue_messages.count(queue_name)) {
-        auto qm = std::make_shared<queue_message>(__base_dir, queue_name);
+        auto qm = std::make_shared<queue_message>(__base_dir, queue_name, body_codec::from_args(args),
+                                                  message_alloc_from_args(args));
         if (durable) qm->recovery();
         __queue_messages[queue_name] = std::move(qm);
     }
        /* 与 AMQP 默认直连交换机 "" 建立 <队列名> 绑定，避免显式 bind 的麻烦 */
-    bind("", queue_name, queue_name);
+    bind_locked("", queue_name, queue_name, {});
     return true;
 }
 
@@ -88,11 +86,13 @@ bool virtual_host::declare_queue_with_dlq(const std::string& queue_name, bool du
                                           const std::unordered_map<std::string, std::string>& args,
                                           const dead_letter_config& dlq_config)
 {
+    std::unique_lock<std::shared_mutex> lock(__mtx);
     if (!__queue_mgr.declare_queue_with_dlq(queue_name, durable, exclusive, auto_delete, args, dlq_config))
         return false;
 
     if (!__queue_messages.count(queue_name)) {
-        auto qm = std::make_shared<queue_message>(__base_dir, queue_name);
+        auto qm = std::make_shared<queue_message>(__base_dir, queue_name, body_codec::from_args(args),
+                                                  message_alloc_from_args(args));
         if (durable) qm->recovery();
         __queue_messages[queue_name] = std::move(qm);
     }
@@ -101,6 +101,7 @@ bool virtual_host::declare_queue_with_dlq(const std::string& queue_name, bool du
 
 void virtual_host::delete_queue(const std::string& queue_name)
 {
+    std::unique_lock<std::shared_mutex> lock(__mtx);
     __queue_messages.erase(queue_name);
     __queue_mgr.delete_queue(queue_name);
 
@@ -125,17 +126,21 @@ queue_map virtual_host::all_queues()
 bool virtual_host::bind(const std::string& exchange_name, const std::string& queue_name,
                         const std::string& binding_key)
 {
-    if (!__exchange_mgr.exists(exchange_name) || !__queue_mgr.exists(queue_name))
-        return false;
-
-    auto& binding_map = __exchange_bindings[exchange_name];
-    binding_map[queue_name] = std::make_shared<binding>(exchange_name, queue_name, binding_key);
-    return true;
+    std::unique_lock<std::shared_mutex> lock(__mtx);
+    return bind_locked(exchange_name, queue_name, binding_key, {});
 }
 
 bool virtual_host::bind(const std::string& exchange_name, const std::string& queue_name,
                         const std::string& binding_key,
                         const std::unordered_map<std::string, std::string>& binding_args)
+{
+    std::unique_lock<std::shared_mutex> lock(__mtx);
+    return bind_locked(exchange_name, queue_name, binding_key, binding_args);
+}
+
+bool virtual_host::bind_locked(const std::string& exchange_name, const std::string& queue_name,
+                               const std::string& binding_key,
+                               const std::unordered_map<std::string, std::string>& binding_args)
 {
     if (!__exchange_mgr.exists(exchange_name) || !__queue_mgr.exists(queue_name))
         return false;
@@ -147,32 +152,59 @@ bool virtual_host::bind(const std::string& exchange_name, const std::string& que
 
 void virtual_host::unbind(const std::string& exchange_name, const std::string& queue_name)
 {
+    std::unique_lock<std::shared_mutex> lock(__mtx);
     auto it = __exchange_bindings.find(exchange_name);
     if (it != __exchange_bindings.end()) it->second.erase(queue_name);
 }
 
 msg_queue_binding_map virtual_host::exchange_bindings(const std::string& exchange_name)
 {
+    std::shared_lock<std::shared_mutex> lock(__mtx);
+    return bindings_locked(exchange_name);
+}
+
+const msg_queue_binding_map& virtual_host::bindings_locked(const std::string& exchange_name) const
+{
+    static const msg_queue_binding_map empty;
     auto it = __exchange_bindings.find(exchange_name);
-    return (it == __exchange_bindings.end()) ? msg_queue_binding_map{} : it->second;
+    return it == __exchange_bindings.end() ? empty : it->second;
+}
+
+bool virtual_host::binds_durable_queue(const std::string& exchange_name)
+{
+    std::shared_lock<std::shared_mutex> lock(__mtx);
+    auto it = __exchange_bindings.find(exchange_name);
+    if (it == __exchange_bindings.end()) return false;
+    for (const auto& [qname, _] : it->second) {
+        auto qinfo = __queue_mgr.select_queue(qname);
+        if (qinfo && qinfo->durable) return true;
+    }
+    return false;
 }
 
 // -----------------------------------------------------------------------------
 // Message ops
+// 持读锁只做查表：取出目标队列的存储指针后即释放，入队 / 落盘 / 出队都在锁外进行，
+// 声明 / 绑定的写锁不会被持续的发布流量饿死
 // -----------------------------------------------------------------------------
 bool virtual_host::basic_publish(const std::string& queue_name,
     BasicProperties*   bp,
     const std::string& body)
 {
 // 1) 队列必须存在
+route_target target;
+{
+std::shared_lock<std::shared_mutex> lock(__mtx);
 auto it = __queue_messages.find(queue_name);
 if (it == __queue_messages.end())
 {
 LOG(ERROR) << "publish failed: queue [" << queue_name << "] not exist";
 return false;
 }
-if (bp && bp->id().empty()) {
-        bp->set_id(generate_id());
+target.qm = it->second;
+}
+if (bp && bp->numeric_id() == 0) {
+        bp->set_numeric_id(next_message_id());
     }
 // 2) routing_key 规则（直连交换机 "")：
 //    · 为空        ⇒ 视为 queue_name
@@ -184,31 +216,81 @@ else if (bp->routing_key() != queue_name)   // ★ 这一行是关键
 return false;
 
 // 3) 是否持久化
-bool durable = false;
 if (auto qinfo = __queue_mgr.select_queue(queue_name))
-durable = qinfo->durable;
+target.durable = qinfo->durable;
 
 // 4) 入队
-return it->second->insert(bp, body, durable);
+return target.qm->insert(bp, body, target.durable);
 }
 
 bool virtual_host::publish_to_exchange(const std::string& exchange_name, BasicProperties* bp,
-                                       const std::string& body)
+                                       const std::string& body, std::vector<std::string>* touched)
 {
-    // 检查交换机是否存在
-    auto exchange_ptr = select_exchange(exchange_name);
-    if (!exchange_ptr) {
-        LOG(ERROR) << "publish failed: exchange [" << exchange_name << "] not exist";
-        return false;
+    std::vector<route_target> targets;
+    {
+        std::shared_lock<std::shared_mutex> lock(__mtx);
+        // 检查交换机是否存在
+        auto exchange_ptr = __exchange_mgr.select_exchange(exchange_name);
+        if (!exchange_ptr) {
+            LOG(ERROR) << "publish failed: exchange [" << exchange_name << "] not exist";
+            return false;
+        }
+
+        // 获取交换机的绑定
+        const auto& bindings = bindings_locked(exchange_name);
+        if (bindings.empty()) {
+            LOG(WARNING) << "publish failed: exchange [" << exchange_name << "] has no bindings";
+            return false;
+        }
+        targets = match_targets_locked(exchange_ptr->type, bindings, bp);
     }
+    return store_shared(targets, bp, body, touched);
+}
 
-    // 获取交换机的绑定
-    auto bindings = exchange_bindings(exchange_name);
-    if (bindings.empty()) {
-        LOG(WARNING) << "publish failed: exchange [" << exchange_name << "] has no bindings";
-        return false;
+size_t virtual_host::publish_batch_to_exchange(const std::string& exchange_name,
+                                               google::protobuf::RepeatedPtrField<publishEntry>* entries,
+                                               std::vector<bool>* results,
+                                               std::vector<std::string>* touched)
+{
+    if (results) results->assign(entries->size(), false);
+
+    // 交换机与绑定表整批只查一次，逐条匹配出目标队列后释放读锁再统一入队
+    std::vector<std::vector<route_target>> targets(entries->size());
+    {
+        std::shared_lock<std::shared_mutex> lock(__mtx);
+        auto exchange_ptr = __exchange_mgr.select_exchange(exchange_name);
+        if (!exchange_ptr) {
+            LOG(ERROR) << "publish failed: exchange [" << exchange_name << "] not exist";
+            return 0;
+        }
+        const auto& bindings = bindings_locked(exchange_name);
+        if (bindings.empty()) {
+            LOG(WARNING) << "publish failed: exchange [" << exchange_name << "] has no bindings";
+            return 0;
+        }
+        for (int i = 0; i < entries->size(); ++i) {
+            publishEntry* entry = entries->Mutable(i);
+            BasicProperties* bp = entry->mutable_properties();
+            if (!entry->routing_key().empty()) bp->set_routing_key(entry->routing_key());
+            targets[i] = match_targets_locked(exchange_ptr->type, bindings, bp);
+        }
+    }
+
+    size_t published = 0;
+    for (int i = 0; i < entries->size(); ++i) {
+        publishEntry* entry = entries->Mutable(i);
+        if (store_shared(targets[i], entry->mutable_properties(), entry->body(), touched)) {
+            ++published;
+            if (results) (*results)[i] = true;
+        }
     }
+    return published;
+}
 
+std::vector<virtual_host::route_target>
+virtual_host::match_targets_locked(ExchangeType type, const msg_queue_binding_map& bindings,
+                                   const BasicProperties* bp)
+{
     // 获取路由键
     std::string routing_key;
     if (bp && !bp->routing_key().empty()) {
@@ -224,15 +306,15 @@ bool virtual_host::publish_to_exchange(const std::string& exchange_name, BasicPr
     }
 
     // 遍历所有绑定的队列，根据交换机类型进行匹配
-    bool published = false;
+    std::vector<route_target> matched;
     for (const auto& [qname, bind_ptr] : bindings) {
         bool should_publish = false;
         
-        switch (exchange_ptr->type) {
+        switch (type) {
         case ExchangeType::DIRECT:
         case ExchangeType::FANOUT:
         case ExchangeType::TOPIC:
-            should_publish = router::match_route(exchange_ptr->type, routing_key, bind_ptr->binding_key);
+            should_publish = router::match_route(type, routing_key, bind_ptr->binding_key);
             break;
             
         case ExchangeType::HEADERS:
@@ -243,16 +325,51 @@ bool virtual_host::publish_to_exchange(const std::string& exchange_name, BasicPr
             should_publish = false;
             break;
         }
-        
-        if (should_publish) {
-            // 投递到匹配的队列
-            if (basic_publish(qname, bp, body)) {
-                published = true;
-            }
+        if (!should_publish) continue;
+
+        auto it = __queue_messages.find(qname);
+        if (it == __queue_messages.end()) {
+            LOG(ERROR) << "publish failed: queue [" << qname << "] not exist";
+            continue;
         }
+        // 与 basic_publish 相同的路由键规则：为空或等于队列名；共享消息不改写 routing_key
+        if (!routing_key.empty() && routing_key != qname) continue;
+
+        route_target target;
+        target.name = qname;
+        target.qm   = it->second;
+        if (auto qinfo = __queue_mgr.select_queue(qname))
+            target.durable = qinfo->durable;
+        matched.push_back(std::move(target));
     }
+    return matched;
+}
 
-    return published;
+bool virtual_host::store_shared(const std::vector<route_target>& targets, BasicProperties* bp,
+                                const std::string& body, std::vector<std::string>* touched)
+{
+    if (targets.empty()) return false;
+
+    // 命中的队列共享同一条消息，扇出不随队列数复制消息体；
+    // 分配方式要照顾每个目标队列的 x-message-alloc：任一要求 heap 即用 heap
+    message_alloc alloc = message_alloc::slab;
+    for (const auto& t : targets) {
+        if (t.qm->alloc() == message_alloc::heap) alloc = message_alloc::heap;
+    }
+    if (bp && bp->numeric_id() == 0) bp->set_numeric_id(next_message_id());
+    message_ptr shared = queue_message::make_message(bp, body, alloc);
+
+    bool stored = true;
+    for (const auto& t : targets) {
+        if (!t.qm->insert(shared, t.durable)) {
+            stored = false;
+            continue;
+        }
+        if (touched && std::find(touched->begin(), touched->end(), t.name) == touched->end())
+            touched->push_back(t.name);
+    }
+    // 任一目标队列写盘失败都算发布失败：确认模式据此回 nack
+    return stored;
 }
 
 bool virtual_host::publish_ex(const std::string& exchange_name,
@@ -260,156 +377,222 @@ bool virtual_host::publish_ex(const std::string& exchange_name,
     BasicProperties*   bp,
     const std::string& body)
 {
+// 如果调用方没给 BasicProperties，就临时建一个
+BasicProperties local_bp;
+if (!bp) bp = &local_bp;
+if (bp->routing_key().empty()) bp->set_routing_key(routing_key);
+
+// 所有匹配的队列共享同一条消息，消息体只复制一次
+std::vector<route_target> matched;
+{
+std::shared_lock<std::shared_mutex> lock(__mtx);
 auto ex = __exchange_mgr.select_exchange(exchange_name);
 if (!ex)
 {
 LOG(ERROR) << "publish failed: exchange [" << exchange_name << "] not exist";
 return false;
 }
-
-// 如果调用方没给 BasicProperties，就临时建一个
-BasicProperties local_bp;
-if (!bp) bp = &local_bp;
-if (bp->routing_key().empty()) bp->set_routing_key(routing_key);
-
-bool delivered = false;
-for (auto& [qname, bind] : exchange_bindings(exchange_name))
+for (auto& [qname, bind] : bindings_locked(exchange_name))
 {
-if (!router::match_route(ex->type, bp->routing_key(), bind->binding_key))
+auto it = __queue_messages.find(qname);
+if (!router::match_route(ex->type, bp->routing_key(), bind->binding_key) ||
+    it == __queue_messages.end())
 continue;
-
-bool durable = false;
+route_target target;
+target.name = qname;
+target.qm   = it->second;
 if (auto qinfo = __queue_mgr.select_queue(qname))
-durable = qinfo->durable;
-
-auto qit = __queue_messages.find(qname);
-if (qit != __queue_messages.end())
-delivered |= qit->second->insert(bp, body, durable);
+target.durable = qinfo->durable;
+matched.push_back(std::move(target));
+}
 }
-return delivered;
+return store_shared(matched, bp, body, nullptr);
 }
 
 
 message_ptr virtual_host::basic_consume(const std::string& queue_name)
 {
-    auto it = __queue_messages.find(queue_name);
-    if (it == __queue_messages.end()) {
+    auto qm = select_queue_message(queue_name);
+    if (!qm) {
         LOG(ERROR) << "consume failed: queue [" << queue_name << "] not exist";
         return {};
     }
 
-    auto msg = it->second->front();
-    if (msg)             // ★ 自动确认（符合测试用例预期）
-        it->second->remove(msg->payload().properties().id());
-    return msg;
+    return qm->pop();    // ★ 自动确认（符合测试用例预期）
 }
 
 message_ptr virtual_host::basic_consume_and_remove(const std::string& queue_name)
 {
-    auto it = __queue_messages.find(queue_name);
-    if (it == __queue_messages.end()) {
+    auto qm = select_queue_message(queue_name);
+    if (!qm) {
         LOG(ERROR) << "consume failed: queue [" << queue_name << "] not exist";
         return {};
     }
-    
-    // 获取队首消息
-    auto msg = it->second->front();
-    if (!msg) {
+
+    // 取出并移除队首消息（原子操作，不会与分发器重复出队）
+    return qm->pop();
+}
+
+message_ptr virtual_host::basic_take(const std::string& queue_name)
+{
+    auto qm = select_queue_message(queue_name);
+    if (!qm) {
+        LOG(ERROR) << "consume failed: queue [" << queue_name << "] not exist";
         return {};
     }
-    
-    // 移除队首消息
-    it->second->remove(msg->payload().properties().id());
-    
-    return msg;
+    return qm->take();
 }
 
-void virtual_host::basic_ack(const std::string& queue_name, const std::string& msg_id)
+std::vector<message_ptr> virtual_host::basic_get(const std::string& queue_name,
+                                                size_t max_count, bool auto_ack)
 {
-    auto it = __queue_messages.find(queue_name);
-    if (it == __queue_messages.end()) {
+    auto qm = select_queue_message(queue_name);
+    if (!qm) return {};
+    // 整批在队列锁内取出：与 worker 上的分发器并发时不会重复出队
+    return qm->pop_n(max_count, auto_ack);
+}
+
+bool virtual_host::basic_requeue(const std::string& queue_name, uint64_t msg_id,
+                                 std::vector<std::string>* dead_lettered)
+{
+    auto qm = select_queue_message(queue_name);
+    if (!qm) return false;
+
+    // 毒消息：反复退回超过上限后转入死信队列，不再循环投递
+    auto queue_ptr = __queue_mgr.select_queue(queue_name);
+    if (queue_ptr && queue_ptr->has_dead_letter_config()) {
+        const auto& config = queue_ptr->get_dead_letter_config();
+        message_ptr msg = qm->find(msg_id);
+        if (msg && config.max_retries > 0 && msg->payload().delivery_count() >= config.max_retries) {
+            dead_letter(queue_name, qm, config, msg_id, "max-retries", dead_lettered);
+            return false;
+        }
+    }
+    return qm->requeue(msg_id);
+}
+
+void virtual_host::basic_ack(const std::string& queue_name, uint64_t msg_id)
+{
+    auto qm = select_queue_message(queue_name);
+    if (!qm) {
         LOG(ERROR) << "ack failed: queue [" << queue_name << "] not exist";
         return;
     }
-    it->second->remove(msg_id);
+    qm->ack(msg_id);
 }
 
-oid virtual_host::basic_nack(const std::string& queue_name, const std::string& msg_id, 
-                              bool requeue, const std::string& reason)
+void virtual_host::basic_nack(const std::string& queue_name, uint64_t msg_id,
+                              bool requeue, const std::string& reason,
+                              std::vector<std::string>* dead_lettered)
 {
-    auto it = __queue_messages.find(queue_name);
-    if (it == __queue_messages.end()) return;
+    auto qm = select_queue_message(queue_name);
+    if (!qm) return;
     
     // 获取队列配置
     auto queue_ptr = __queue_mgr.select_queue(queue_name);
     if (!queue_ptr) return;
     
     if (requeue) {
-        // 重新入队，不做任何处理
+        // 已投递未确认的消息放回队首（超过重试上限转入死信）；仍在队列中的消息无需处理
+        basic_requeue(queue_name, msg_id, dead_lettered);
         return;
     }
     
     // 检查是否有死信队列配置
     if (!queue_ptr->has_dead_letter_config()) {
         // 没有死信队列配置，直接删除消息
-        it->second->remove(msg_id);
+        qm->ack(msg_id);
         return;
     }
-    
-    // 获取原始消息
-    auto msg = it->second->front();
-    if (!msg) return;
-    
-    // 查找消息ID匹配的消息
-    auto all_msgs = it->second->get_all_messages();
-    message_ptr target_msg = nullptr;
-    for (const auto& m : all_msgs) {
-        if (m->payload().properties().id() == msg_id) {
-            target_msg = m;
-            break;
-        }
-    }
-    
+    dead_letter(queue_name, qm, queue_ptr->get_dead_letter_config(), msg_id, reason, dead_lettered);
+}
+
+void virtual_host::dead_letter(const std::string& queue_name, const queue_message_ptr& qm,
+                               const dead_letter_config& config, uint64_t msg_id,
+                               const std::string& reason, std::vector<std::string>* touched)
+{
+    // 查找消息ID匹配的消息（含已投递未确认的）
+    message_ptr target_msg = qm->find(msg_id);
     if (!target_msg) {
         return;
     }
     
-    // 创建死信消息
-    auto dead_letter_msg = std::make_shared<Message>();
-    *dead_letter_msg->mutable_payload() = target_msg->payload();
-    
-    // 添加死信队列相关属性
-    auto& dlq_config = queue_ptr->get_dead_letter_config();
-    
-    // 将死信消息投递到死信交换机
+    // 将死信消息投递到死信交换机，附带来源队列、原因与投递次数
     BasicProperties dlq_props;
-    dlq_props.set_id(generate_id());
     dlq_props.set_delivery_mode(DeliveryMode::DURABLE);
-    dlq_props.set_routing_key(dlq_config.routing_key);
+    dlq_props.set_routing_key(config.routing_key);
+    auto& headers = *dlq_props.mutable_headers();
+    headers["x-death-queue"]  = queue_name;
+    headers["x-death-reason"] = reason.empty() ? "rejected" : reason;
+    headers["x-delivery-count"] = std::to_string(target_msg->payload().delivery_count() + 1);
     
     // 投递到死信交换机
-    if (!dlq_config.exchange_name.empty()) {
-        bool dlq_published = publish_to_exchange(dlq_config.exchange_name, &dlq_props, target_msg->payload().body());
+    if (!config.exchange_name.empty()) {
+        publish_to_exchange(config.exchange_name, &dlq_props, target_msg->payload().body(), touched);
     }
     
     // 从原队列中删除消息
-    it->second->remove(msg_id);
+    qm->ack(msg_id);
+}
+
+// 字符串 id 兼容接口：按客户端自带 id 或数值 id 的十进制文本解析后转发
+uint64_t virtual_host::lookup_id(const std::string& queue_name, const std::string& msg_id)
+{
+    auto qm = select_queue_message(queue_name);
+    return qm ? qm->lookup_id(msg_id) : 0;
+}
+
+bool virtual_host::basic_requeue(const std::string& queue_name, const std::string& msg_id)
+{
+    uint64_t id = lookup_id(queue_name, msg_id);
+    return id != 0 && basic_requeue(queue_name, id);
+}
+
+void virtual_host::basic_ack(const std::string& queue_name, const std::string& msg_id)
+{
+    auto qm = select_queue_message(queue_name);
+    if (!qm) {
+        LOG(ERROR) << "ack failed: queue [" << queue_name << "] not exist";
+        return;
+    }
+    qm->ack(msg_id);
+}
+
+void virtual_host::basic_nack(const std::string& queue_name, const std::string& msg_id,
+                              bool requeue, const std::string& reason)
+{
+    if (uint64_t id = lookup_id(queue_name, msg_id))
+        basic_nack(queue_name, id, requeue, reason);
+}
+
+size_t virtual_host::total_depth()
+{
+    std::vector<queue_message_ptr> queues;
+    {
+        std::shared_lock<std::shared_mutex> lock(__mtx);
+        for (auto& [qname, qm] : __queue_messages) queues.push_back(qm);
+    }
+    size_t depth = 0;
+    for (auto& qm : queues) depth += qm->getable_count();
+    return depth;
 }
 
 std::string virtual_host::basic_query()
 {
-    for (auto& [qname, qm] : __queue_messages) {
-        if (qm->getable_count() == 0) continue;
-        if (auto msg = qm->front()) {
-            qm->remove(msg->payload().properties().id());
-            return msg->payload().body();
-        }
+    std::vector<queue_message_ptr> queues;
+    {
+        std::shared_lock<std::shared_mutex> lock(__mtx);
+        for (auto& [qname, qm] : __queue_messages) queues.push_back(qm);
+    }
+    for (auto& qm : queues) {
+        if (auto msg = qm->pop()) return msg->payload().body();
     }
     return {};
 }
 
 queue_message_ptr virtual_host::select_queue_message(const std::string& queue_name)
 {
+    std::shared_lock<std::shared_mutex> lock(__mtx);
     auto it = __queue_messages.find(queue_name);
     if (it == __queue_messages.end()) return nullptr;
     return it->second;
@@ -417,17 +600,13 @@ queue_message_ptr virtual_host::select_queue_message(const std::string& queue_na
 
 queue_message::stats virtual_host::queue_runtime_stats(const std::string& queue_name)
 {
-    auto it = __queue_messages.find(queue_name);
-    if (it == __queue_messages.end()) return {};
-    return it->second->get_stats();
+    auto qm = select_queue_message(queue_name);
+    return qm ? qm->get_stats() : queue_message::stats{};
 }
 
 void virtual_host::compact_queue(const std::string& queue_name)
 {
-    auto it = __queue_messages.find(queue_name);
-    if (it != __queue_messages.end()) {
-        it->second->compact();
-    }
+    if (auto qm = select_queue_message(queue_name)) qm->compact();
 }
 
-} 
+}
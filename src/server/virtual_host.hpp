@@ -4,11 +4,14 @@
 #include <unordered_map>
 #include <memory>
 #include <atomic>
+#include <shared_mutex>
+#include <vector>
 
 #include "exchange.hpp"
 #include "queue.hpp"
 #include "binding.hpp"
 #include "../common/message.hpp"
+#include "../common/snowflake.hpp"   // 数值消息 id
 #include "../common/protocol.pb.h"  // ExchangeType
 #include "../common/msg.pb.h"       // BasicProperties, Message
 
@@ -19,6 +22,8 @@ using queue_message_ptr = std::shared_ptr<queue_message>;
 
 // ==============================================================
 // virtual_host : Broker 核心状态（exchanges / queues / bindings）
+// 多个 I/O 线程与线程池 worker 并发访问：声明 / 删除 / 绑定持写锁；
+// 发布 / 取消息 / 确认只在读锁下查表取出 queue_message，入队与出队在锁外由它自己加锁
 // ==============================================================
 class virtual_host {
 public:
@@ -59,6 +64,8 @@ public:
     void unbind(const std::string& exchange_name, const std::string& queue_name);
 
     msg_queue_binding_map exchange_bindings(const std::string& exchange_name);
+    // 交换机绑定了持久化队列：发布到它的消息可能落盘（是否落盘由队列 durable 决定，与 delivery_mode 无关）
+    bool binds_durable_queue(const std::string& exchange_name);
 
     bool basic_publish_queue(const std::string& queue_name,
         BasicProperties* bp,
@@ -73,13 +80,38 @@ public:
          BasicProperties*   bp,
         const std::string& body);
     message_ptr basic_consume(const std::string& queue_name);
+    // touched 非空时收集投递到的队列，调用方据此唤醒对应的分发器
     bool publish_to_exchange(const std::string& exchange_name, BasicProperties* bp,
-                             const std::string& body);
+                             const std::string& body, std::vector<std::string>* touched = nullptr);
+    // 批量发布：交换机与绑定只查一次，逐条路由（条目非空的 routing_key 覆盖 properties 中的）；
+    // results[i] 表示第 i 条是否投递到至少一个队列，touched 收集投递到的队列，返回成功条数
+    size_t publish_batch_to_exchange(const std::string& exchange_name,
+                                     google::protobuf::RepeatedPtrField<publishEntry>* entries,
+                                     std::vector<bool>* results,
+                                     std::vector<std::string>* touched);
     message_ptr basic_consume_and_remove(const std::string& queue_name);
+    // 手动确认模式：取出队首并登记为未确认，等待 basic_ack / basic_requeue
+    message_ptr basic_take(const std::string& queue_name);
+    // 放回队首；配置了死信队列且退回次数已达 max_retries 时改为投递到死信交换机，
+    // 此时 dead_lettered 收集死信消息投递到的队列（需由调用方 notify 它们的分发器）
+    bool basic_requeue(const std::string& queue_name, uint64_t msg_id,
+                       std::vector<std::string>* dead_lettered = nullptr);
+    // 批量拉取至多 max_count 条：auto_ack 直接出队，否则登记为未确认
+    std::vector<message_ptr> basic_get(const std::string& queue_name, size_t max_count, bool auto_ack);
+    // msg_id 为 properties.numeric_id（publish 时分配）
+    void basic_ack(const std::string& queue_name, uint64_t msg_id);
+    void basic_nack(const std::string& queue_name, uint64_t msg_id,
+                    bool requeue, const std::string& reason,
+                    std::vector<std::string>* dead_lettered = nullptr);
+
+    // 字符串 id 兼容接口（客户端自带的 properties.id 或数值 id 的十进制文本），需线性查找
+    uint64_t lookup_id(const std::string& queue_name, const std::string& msg_id);   // 找不到返回 0
+    bool basic_requeue(const std::string& queue_name, const std::string& msg_id);
     void basic_ack(const std::string& queue_name, const std::string& msg_id);
     void basic_nack(const std::string& queue_name, const std::string& msg_id,
                     bool requeue, const std::string& reason);
-    std::string basic_query();  // 简化的 pull 查询
+    std::string basic_query();  // 旧版 pull 查询：扫描所有队列取一条，新客户端使用 basic_get
+    size_t total_depth();       // 所有队列待投递消息数之和，用作发布背压的积压信号
 
     queue_message::stats queue_runtime_stats(const std::string& queue_name);
     void compact_queue(const std::string& queue_name);
@@ -89,6 +121,7 @@ public:
 private:
     std::string                                   __name;
     std::string                                   __base_dir;
+    mutable std::shared_mutex                     __mtx;   // 保护下面的管理器与两张表
 
     exchange_manager                              __exchange_mgr;
     msg_queue_manager                             __queue_mgr;
@@ -96,7 +129,31 @@ private:
     std::unordered_map<std::string, msg_queue_binding_map> __exchange_bindings; // exchange -> (queue -> binding)
     std::unordered_map<std::string, queue_message_ptr>     __queue_messages;    // queue -> message storage
 
-    static std::string generate_id();  // 若调用方需要自行生成 msg_id
+    // 路由命中的目标队列：持读锁时取出存储指针与 durable 标志，入队 / 落盘在锁外进行
+    struct route_target {
+        std::string       name;
+        queue_message_ptr qm;
+        bool              durable{false};
+    };
+
+    // *_locked 要求调用方已持有 __mtx（bind_locked 需写锁，其余读锁即可）
+    bool bind_locked(const std::string& exchange_name, const std::string& queue_name,
+                     const std::string& binding_key,
+                     const std::unordered_map<std::string, std::string>& binding_args);
+    const msg_queue_binding_map& bindings_locked(const std::string& exchange_name) const;
+    // 按交换机类型匹配绑定；队列不存在或路由键不符（非空且不等于队列名）的跳过
+    std::vector<route_target> match_targets_locked(ExchangeType type,
+                                                   const msg_queue_binding_map& bindings,
+                                                   const BasicProperties* bp);
+    // 不持锁：构造一条共享消息写入全部目标队列，消息体只有一份；
+    // 没有目标或任一队列写盘失败返回 false，touched 收集写入成功的队列
+    bool store_shared(const std::vector<route_target>& targets, BasicProperties* bp,
+                      const std::string& body, std::vector<std::string>* touched);
+
+    // 把消息转投死信交换机并从原队列删除；touched 收集死信投递到的队列
+    void dead_letter(const std::string& queue_name, const queue_message_ptr& qm,
+                     const dead_letter_config& config, uint64_t msg_id,
+                     const std::string& reason, std::vector<std::string>* touched);
 };
 
 } 
\ No newline at end of file
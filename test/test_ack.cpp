@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 #include "../src/server/virtual_host.hpp"
+#include "../src/server/consumer.hpp"
+#include "../src/server/queue_message.hpp"
 #include "../src/common/msg.pb.h"
 
 using namespace hz_mq;
@@ -88,4 +90,145 @@ TEST_F(AckTestFixture, MultiQueueAck) {
     auto msg2 = vh->basic_consume("q2");
     EXPECT_EQ(msg1, nullptr);
     EXPECT_EQ(msg2, nullptr);
-} 
\ No newline at end of file
+} 
+TEST_F(AckTestFixture, TakeThenRequeueKeepsOrder) {
+    BasicProperties p1, p2;
+    p1.set_id("t1");
+    p2.set_id("t2");
+    vh->basic_publish("q1", &p1, "first");
+    vh->basic_publish("q1", &p2, "second");
+
+    auto m1 = vh->basic_take("q1");
+    ASSERT_NE(m1, nullptr);
+    EXPECT_EQ(m1->payload().body(), "first");
+    auto qm = vh->select_queue_message("q1");
+    EXPECT_EQ(qm->unacked_count(), 1u);
+    EXPECT_EQ(qm->getable_count(), 1u);
+
+    // 未确认消息放回队首，并标记 redelivered
+    EXPECT_TRUE(vh->basic_requeue("q1", "t1"));
+    EXPECT_EQ(qm->unacked_count(), 0u);
+    auto again = vh->basic_take("q1");
+    ASSERT_NE(again, nullptr);
+    EXPECT_EQ(again->payload().body(), "first");
+    EXPECT_TRUE(again->payload().properties().redelivered());
+
+    vh->basic_ack("q1", "t1");
+    EXPECT_EQ(qm->unacked_count(), 0u);
+    EXPECT_EQ(qm->getable_count(), 1u);
+}
+
+TEST(PrefetchTest, ChooseRespectsWindow) {
+    auto cmp = std::make_shared<consumer_manager>();
+    cmp->init_queue_consumer("q");
+
+    auto c1 = std::make_shared<consumer>("c1", "q", false, consumer_callback{});
+    c1->window = std::make_shared<prefetch_window>();
+    c1->window->limit = 1;
+    auto c2 = std::make_shared<consumer>("c2", "q", false, consumer_callback{});
+    c2->window = std::make_shared<prefetch_window>();
+    c2->window->limit = 2;
+    ASSERT_NE(cmp->create(c1), nullptr);
+    ASSERT_NE(cmp->create(c2), nullptr);
+
+    // 共 3 个额度，之后选不出消费者
+    int picked_c1 = 0, picked_c2 = 0;
+    for (int i = 0; i < 3; ++i) {
+        auto c = cmp->choose("q");
+        ASSERT_NE(c, nullptr);
+        (c == c1 ? picked_c1 : picked_c2)++;
+    }
+    EXPECT_EQ(picked_c1, 1);
+    EXPECT_EQ(picked_c2, 2);
+    EXPECT_EQ(cmp->choose("q"), nullptr);
+
+    // 确认一条后额度归还
+    c1->release_credit();
+    EXPECT_EQ(cmp->choose("q"), c1);
+}
+
+TEST(PrefetchTest, ChannelWindowIsShared) {
+    auto shared = std::make_shared<prefetch_window>();
+    shared->limit = 1;
+    consumer a("a", "q", false, consumer_callback{});
+    consumer b("b", "q", false, consumer_callback{});
+    a.channel_window = shared;
+    b.channel_window = shared;
+
+    EXPECT_TRUE(a.try_acquire_credit());
+    EXPECT_FALSE(b.try_acquire_credit());
+    a.release_credit();
+    EXPECT_TRUE(b.try_acquire_credit());
+
+    consumer auto_c("x", "q", true, consumer_callback{});
+    auto_c.channel_window = shared;
+    EXPECT_TRUE(auto_c.try_acquire_credit());   // auto_ack 不受预取限制
+}
+
+TEST(FlowCreditTest, MessageAndByteCredit) {
+    consumer c("c", "q", true, consumer_callback{});
+    c.credit = std::make_shared<flow_credit>();
+    EXPECT_FALSE(c.try_acquire_credit());           // 信用模式初始额度为 0
+
+    c.credit->grant(2, 0);
+    EXPECT_TRUE(c.try_acquire_credit());
+    c.on_delivered(100);
+    EXPECT_TRUE(c.try_acquire_credit());
+    c.on_delivered(100);
+    EXPECT_FALSE(c.has_credit());                   // 条数耗尽
+
+    c.credit->grant(10, 150);                       // 开始按字节限制
+    EXPECT_TRUE(c.try_acquire_credit());
+    c.on_delivered(200);                            // 允许透支一条
+    EXPECT_FALSE(c.has_credit());
+    c.credit->grant(0, 100);
+    EXPECT_TRUE(c.has_credit());
+}
+
+TEST(FlowCreditTest, OutputGateBlocksAllConsumers) {
+    auto gate = std::make_shared<output_gate>();
+    consumer manual("m", "q", false, consumer_callback{});
+    consumer autoc("a", "q", true, consumer_callback{});
+    manual.gate = gate;
+    autoc.gate = gate;
+
+    gate->writable = false;                         // 越过高水位
+    EXPECT_FALSE(manual.try_acquire_credit());
+    EXPECT_FALSE(autoc.try_acquire_credit());
+    gate->writable = true;                          // 写空后恢复
+    EXPECT_TRUE(manual.try_acquire_credit());
+    EXPECT_TRUE(autoc.try_acquire_credit());
+}
+
+TEST(RedeliveryTest, DeliveryCountSurvivesRecovery) {
+    const std::string dir = "./test_redelivery_data";
+    {
+        queue_message qm(dir, "rq");
+        BasicProperties bp;
+        bp.set_id("r1");
+        bp.set_delivery_mode(DeliveryMode::DURABLE);
+        ASSERT_TRUE(qm.insert(&bp, "body", true));
+        ASSERT_NE(qm.take(), nullptr);
+        ASSERT_TRUE(qm.requeue("r1"));
+        ASSERT_NE(qm.take(), nullptr);
+        ASSERT_TRUE(qm.requeue("r1"));
+    }
+    {
+        queue_message qm(dir, "rq");
+        qm.recovery();
+        auto msg = qm.front();
+        ASSERT_NE(msg, nullptr);
+        EXPECT_EQ(msg->payload().delivery_count(), 2u);
+        EXPECT_TRUE(msg->payload().properties().redelivered());
+
+        // 原地改写后作废仍然有效：确认后重启不再恢复
+        ASSERT_NE(qm.take(), nullptr);
+        EXPECT_TRUE(qm.ack("r1"));
+    }
+    {
+        queue_message qm(dir, "rq");
+        qm.recovery();
+        EXPECT_EQ(qm.front(), nullptr);
+    }
+    system(("rm -rf " + dir).c_str());
+}
@@ -0,0 +1,499 @@
+#include <gtest/gtest.h>
+#include "../src/server/channel.hpp"
+#include "../src/server/connection.hpp"
+#include "../src/common/protocol.pb.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpConnection.h"
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <google/protobuf/descriptor.h>
+
+using namespace hz_mq;
+using MessageList = std::vector<std::shared_ptr<google::protobuf::Message>>;
+
+// channel 经一条真实的 TcpConnection（socketpair 的一端）发帧，测试从另一端读出并按
+// ProtobufCodec 的帧格式解码；请求处理与生产环境一样跑在连接所属的 EventLoop 上
+class ChannelFixture : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        system("rm -rf ./test_channel_data");
+        loop = loop_thread.startLoop();
+        int fds[2];
+        ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds), 0);
+        peer = fds[1];
+        muduo::net::InetAddress addr("127.0.0.1", 0);
+        conn = std::make_shared<muduo::net::TcpConnection>(loop, "channel-test", fds[0], addr, addr);
+        conn->setConnectionCallback([](const muduo::net::TcpConnectionPtr&) {});
+        conn->setMessageCallback([](const muduo::net::TcpConnectionPtr&, muduo::net::Buffer*, muduo::Timestamp) {});
+        run([this] { conn->connectEstablished(); });
+
+        host  = std::make_shared<virtual_host>("TestHost", "./test_channel_data", "./test_channel_data/meta.db");
+        cmp   = std::make_shared<consumer_manager>();
+        pool  = std::make_shared<thread_pool>(2);
+        codec = std::make_shared<ProtobufCodec>(
+            [](const muduo::net::TcpConnectionPtr&, const MessagePtr&, muduo::Timestamp) {});
+        ch = std::make_shared<channel>("c1", host, cmp, codec, conn, pool);
+
+        auto ex = std::make_shared<declareExchangeRequest>();
+        ex->set_exchange_name("ex");
+        ex->set_exchange_type(ExchangeType::DIRECT);
+        run([&] { ch->declare_exchange(ex); });
+        declare_queue("q1");
+        ASSERT_EQ(read(2).size(), 2u);
+    }
+
+    void TearDown() override
+    {
+        run([this] { ch.reset(); });
+        run([this] { conn->connectDestroyed(); });
+        conn.reset();
+        ::close(peer);
+        system("rm -rf ./test_channel_data");
+    }
+
+    // 在 loop 线程执行并等待完成
+    void run(const std::function<void()>& fn)
+    {
+        std::promise<void> done;
+        loop->runInLoop([&] {
+            fn();
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+
+    void declare_queue(const std::string& qname, bool durable = false)
+    {
+        auto q = std::make_shared<declareQueueRequest>();
+        q->set_queue_name(qname);
+        q->set_durable(durable);
+        run([&] { ch->declare_queue(q); });
+        auto b = std::make_shared<bindRequest>();
+        b->set_exchange_name("ex");
+        b->set_queue_name(qname);
+        b->set_binding_key(qname);
+        run([&] { ch->bind(b); });
+        read(1);   // declare_queue 的响应，bind 的响应由调用方读
+    }
+
+    void publish(const std::string& body, const std::string& key = "q1", bool no_response = true)
+    {
+        auto req = std::make_shared<basicPublishRequest>();
+        req->set_exchange_name("ex");
+        req->set_body(body);
+        req->set_no_response(no_response);
+        req->mutable_properties()->set_routing_key(key);
+        run([&] { ch->basic_publish(req); });
+    }
+
+    void consume(const std::string& tag, bool auto_ack, uint32_t batch = 0)
+    {
+        auto req = std::make_shared<basicConsumeRequest>();
+        req->set_consumer_tag(tag);
+        req->set_queue_name("q1");
+        req->set_auto_ack(auto_ack);
+        req->set_batch_max_count(batch);
+        run([&] { ch->basic_consume(req); });
+    }
+
+    template <class T>
+    static std::vector<std::shared_ptr<T>> only(const MessageList& msgs)
+    {
+        std::vector<std::shared_ptr<T>> out;
+        for (const auto& m : msgs) {
+            if (auto t = std::dynamic_pointer_cast<T>(m)) out.push_back(t);
+        }
+        return out;
+    }
+
+    // 读出 n 帧（或等到超时）；n == 0 时读出 timeout_ms 内到达的全部帧
+    MessageList read(size_t n, int timeout_ms = 2000)
+    {
+        MessageList out;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        while (n == 0 || out.size() < n) {
+            while (parse_one(&out) && (n == 0 || out.size() < n)) {}
+            if (n != 0 && out.size() >= n) break;
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            deadline - std::chrono::steady_clock::now()).count();
+            pollfd pfd{peer, POLLIN, 0};
+            if (left <= 0 || ::poll(&pfd, 1, static_cast<int>(left)) <= 0) break;
+            char tmp[65536];
+            ssize_t got = ::read(peer, tmp, sizeof(tmp));
+            if (got <= 0) break;
+            buf.append(tmp, static_cast<size_t>(got));
+        }
+        return out;
+    }
+
+    muduo::net::EventLoopThread  loop_thread;
+    muduo::net::EventLoop*       loop{nullptr};
+    muduo::net::TcpConnectionPtr conn;
+    int                          peer{-1};
+    std::string                  buf;
+
+    virtual_host::ptr     host;
+    consumer_manager::ptr cmp;
+    thread_pool::ptr      pool;
+    ProtobufCodecPtr      codec;
+    channel::ptr          ch;
+
+private:
+    // 帧格式：len(4) name_len(4) type_name\0 payload adler32(4)
+    bool parse_one(MessageList* out)
+    {
+        if (buf.size() < 4) return false;
+        int32_t len;
+        std::memcpy(&len, buf.data(), 4);
+        len = ntohl(len);
+        if (buf.size() < 4 + static_cast<size_t>(len)) return false;
+        int32_t name_len;
+        std::memcpy(&name_len, buf.data() + 4, 4);
+        name_len = ntohl(name_len);
+        std::string type(buf.data() + 8, static_cast<size_t>(name_len) - 1);
+        const char* payload = buf.data() + 8 + name_len;
+        int payload_len = len - name_len - 8;
+
+        const auto* desc = google::protobuf::DescriptorPool::generated_pool()->FindMessageTypeByName(type);
+        EXPECT_NE(desc, nullptr) << type;
+        if (desc) {
+            std::shared_ptr<google::protobuf::Message> msg(
+                google::protobuf::MessageFactory::generated_factory()->GetPrototype(desc)->New());
+            EXPECT_TRUE(msg->ParseFromArray(payload, payload_len));
+            out->push_back(std::move(msg));
+        }
+        buf.erase(0, 4 + static_cast<size_t>(len));
+        return true;
+    }
+};
+
+TEST_F(ChannelFixture, EveryDeliveryBatchCarriesConsumerTag) {
+    consume("t1", true, 2);
+    read(1);
+    // 四条消息、每批两条：至少发出两帧，每帧都要带 consumer tag
+    for (int i = 0; i < 4; ++i) publish("m" + std::to_string(i));
+
+    std::vector<std::shared_ptr<basicDeliverBatch>> batches;
+    int delivered = 0;
+    while (delivered < 4) {
+        auto got = only<basicDeliverBatch>(read(1));
+        if (got.empty()) break;
+        delivered += got[0]->messages_size();
+        batches.push_back(got[0]);
+    }
+    EXPECT_EQ(delivered, 4);
+    ASSERT_GE(batches.size(), 2u);
+    for (const auto& b : batches) {
+        EXPECT_EQ(b->consumer_tag(), "t1");
+        EXPECT_EQ(b->cid(), "c1");
+    }
+}
+
+TEST_F(ChannelFixture, MessagesWithoutIdAreDeliveredWithNumericIdText) {
+    consume("t1", false);
+    read(1);
+    publish("no-id");
+
+    auto got = only<basicConsumeResponse>(read(1));
+    ASSERT_EQ(got.size(), 1u);
+    const BasicProperties& props = got[0]->properties();
+    ASSERT_NE(props.numeric_id(), 0u);
+    EXPECT_EQ(props.id(), std::to_string(props.numeric_id()));
+
+    // 旧客户端只回传字符串 id 也能确认
+    auto ack = std::make_shared<basicAckRequest>();
+    ack->set_cid("c1");
+    ack->set_queue_name("q1");
+    ack->set_message_id(props.id());
+    ack->set_no_response(true);
+    run([&] { ch->basic_ack(ack); });
+    EXPECT_EQ(host->select_queue_message("q1")->unacked_count(), 0u);
+}
+
+TEST_F(ChannelFixture, PendingGetIsCancelledWhenChannelCloses) {
+    auto get = std::make_shared<basicGetRequest>();
+    get->set_rid("g1");
+    get->set_queue_name("q1");
+    get->set_auto_ack(true);
+    get->set_max_wait_ms(5000);
+    run([&] { ch->basic_get(get); });
+
+    // 等待者完成时才确认：响应发出后消息不再留在队列里
+    publish("first");
+    auto got = only<basicGetResponse>(read(1));
+    ASSERT_EQ(got.size(), 1u);
+    ASSERT_EQ(got[0]->messages_size(), 1);
+    auto qm = host->select_queue_message("q1");
+    for (int i = 0; i < 100 && qm->unacked_count() != 0; ++i)   // 确认在派发线程发出响应之后
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(qm->unacked_count(), 0u);
+    EXPECT_EQ(qm->getable_count(), 0u);
+
+    // 关闭 channel 后到达的消息不能被已失效的等待者取走
+    run([&] { ch->basic_get(get); });
+    run([this] { ch.reset(); });
+    auto other = std::make_shared<channel>("c2", host, cmp, codec, conn, pool);
+    auto req = std::make_shared<basicPublishRequest>();
+    req->set_exchange_name("ex");
+    req->set_body("second");
+    req->set_no_response(true);
+    req->mutable_properties()->set_routing_key("q1");
+    run([&] { other->basic_publish(req); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(qm->getable_count(), 1u);
+    EXPECT_EQ(qm->unacked_count(), 0u);
+    run([&] { other.reset(); });
+}
+
+TEST_F(ChannelFixture, AckAndNackByDeliveryTagRanges) {
+    consume("t1", false);
+    read(1);
+    for (int i = 0; i < 5; ++i) publish("m" + std::to_string(i));
+    auto first = only<basicConsumeResponse>(read(5));
+    ASSERT_EQ(first.size(), 5u);
+    EXPECT_EQ(first[4]->properties().delivery_tag(), 5u);
+    auto qm = host->select_queue_message("q1");
+
+    auto ack = [&](uint64_t tag, bool multiple, bool no_response) {
+        auto req = std::make_shared<basicAckRequest>();
+        req->set_rid("a" + std::to_string(tag));
+        req->set_cid("c1");
+        req->set_delivery_tag(tag);
+        req->set_multiple(multiple);
+        req->set_no_response(no_response);
+        run([&] { ch->basic_ack(req); });
+    };
+
+    // multiple ack 一次确认 1..3，no_response 时不回帧
+    ack(3, true, true);
+    EXPECT_EQ(qm->unacked_count(), 2u);
+    EXPECT_TRUE(read(0, 100).empty());
+
+    // multiple nack 退回 4..5：按原投递顺序重新投递，带新的投递标签
+    auto nack = std::make_shared<basicNackRequest>();
+    nack->set_rid("n5");
+    nack->set_cid("c1");
+    nack->set_delivery_tag(5);
+    nack->set_multiple(true);
+    nack->set_requeue(true);
+    run([&] { ch->basic_nack(nack); });
+    auto got = read(3);
+    auto resp = only<basicCommonResponse>(got);
+    auto again = only<basicConsumeResponse>(got);
+    ASSERT_EQ(resp.size(), 1u);
+    EXPECT_EQ(resp[0]->rid(), "n5");
+    EXPECT_TRUE(resp[0]->ok());
+    ASSERT_EQ(again.size(), 2u);
+    EXPECT_EQ(again[0]->body(), "m3");
+    EXPECT_EQ(again[1]->body(), "m4");
+    EXPECT_TRUE(again[0]->properties().redelivered());
+    EXPECT_EQ(again[0]->properties().delivery_tag(), 6u);
+    EXPECT_EQ(again[1]->properties().delivery_tag(), 7u);
+
+    // 已确认过的标签：响应 ok = false；单条 ack 只确认该标签
+    ack(1, false, false);
+    ack(7, false, false);
+    auto acks = only<basicCommonResponse>(read(2));
+    ASSERT_EQ(acks.size(), 2u);
+    EXPECT_FALSE(acks[0]->ok());
+    EXPECT_TRUE(acks[1]->ok());
+    EXPECT_EQ(qm->unacked_count(), 1u);
+}
+
+TEST_F(ChannelFixture, ConfirmsCoalesceAndSplitAroundNack) {
+    auto sel = std::make_shared<confirmSelectRequest>();
+    sel->set_rid("sel");
+    sel->set_cid("c1");
+    run([&] { ch->confirm_select(sel); });
+    read(1);
+
+    auto request = [](const std::string& exchange) {
+        auto req = std::make_shared<basicPublishRequest>();
+        req->set_cid("c1");
+        req->set_exchange_name(exchange);
+        req->set_body("x");
+        req->mutable_properties()->set_routing_key("q1");
+        return req;
+    };
+    auto confirms = [this](size_t n) { return only<basicConfirm>(read(n)); };
+
+    // 同一轮事件循环内完成的发布合并确认；失败的一条单独 nack，把 ack 区间切成两段
+    run([&] {
+        for (const char* ex : {"ex", "ex", "missing", "ex", "ex"}) ch->basic_publish_async(request(ex));
+    });
+    auto got = confirms(3);
+    ASSERT_EQ(got.size(), 3u);
+    EXPECT_EQ(got[0]->delivery_tag(), 2u);
+    EXPECT_TRUE(got[0]->multiple());
+    EXPECT_FALSE(got[0]->nack());
+    EXPECT_EQ(got[1]->delivery_tag(), 3u);
+    EXPECT_TRUE(got[1]->nack());
+    EXPECT_FALSE(got[1]->multiple());
+    EXPECT_EQ(got[2]->delivery_tag(), 5u);
+    EXPECT_TRUE(got[2]->multiple());
+    EXPECT_TRUE(read(0, 100).empty());   // 确认模式下发布不再回 basicCommonResponse
+
+    // 绑定持久化队列后发布改走 strand，回到 loop 的时机晚于发起时：确认仍按编号顺序发出
+    declare_queue("dq", true);
+    read(1);
+    run([&] {
+        ch->basic_publish_async(request("ex"));
+        ch->basic_publish_async(request("missing"));
+    });
+    got = confirms(2);
+    ASSERT_EQ(got.size(), 2u);
+    EXPECT_EQ(got[0]->delivery_tag(), 6u);
+    EXPECT_FALSE(got[0]->nack());
+    EXPECT_EQ(got[1]->delivery_tag(), 7u);
+    EXPECT_TRUE(got[1]->nack());
+}
+
+TEST_F(ChannelFixture, PublisherPausedOnArrivalIsResumed) {
+    auto mgr = std::make_shared<connection_manager>();
+    run([&] { mgr->new_connection(host, cmp, codec, conn, pool); });
+    connection::ptr ctx = mgr->select_connection(conn);
+    ASSERT_NE(ctx, nullptr);
+
+    // 过载期间才出现的发布连接：与 on_basicPublish 一样经 connection 暂停读取
+    run([&] { mgr->pause_publishers(); });
+    run([&] {
+        ctx->mark_publisher();
+        if (mgr->publishers_paused()) ctx->pause_read();
+    });
+    EXPECT_FALSE(conn->isReading());
+
+    // 线程池回落到低水位：这条连接也要被恢复
+    run([&] { mgr->resume_publishers(); });
+    EXPECT_TRUE(conn->isReading());
+    run([&] { mgr->delete_connection(conn); });
+}
+
+TEST_F(ChannelFixture, PublishersResumeOnlyWhenAllPauseReasonsClear) {
+    auto mgr = std::make_shared<connection_manager>();
+    run([&] { mgr->new_connection(host, cmp, codec, conn, pool); });
+    connection::ptr ctx = mgr->select_connection(conn);
+    ASSERT_NE(ctx, nullptr);
+    run([&] { ctx->mark_publisher(); });
+
+    run([&] { mgr->pause_publishers(connection_manager::PAUSE_TASK_BACKLOG); });
+    run([&] { mgr->pause_publishers(connection_manager::PAUSE_QUEUE_DEPTH); });
+    EXPECT_FALSE(conn->isReading());
+
+    // 线程池已回落，但队列深度仍超标：继续暂停
+    run([&] { mgr->resume_publishers(connection_manager::PAUSE_TASK_BACKLOG); });
+    EXPECT_TRUE(mgr->publishers_paused());
+    EXPECT_FALSE(conn->isReading());
+
+    run([&] { mgr->resume_publishers(connection_manager::PAUSE_QUEUE_DEPTH); });
+    EXPECT_FALSE(mgr->publishers_paused());
+    EXPECT_TRUE(conn->isReading());
+    run([&] { mgr->delete_connection(conn); });
+}
+
+TEST_F(ChannelFixture, DeadLetteredMessageReachesDlqConsumer) {
+    declare_queue("dlq");
+    read(1);
+    auto wq = std::make_shared<declareQueueWithDLQRequest>();
+    wq->set_queue_name("work");
+    wq->mutable_dlq_config()->set_exchange_name("ex");
+    wq->mutable_dlq_config()->set_routing_key("dlq");
+    wq->mutable_dlq_config()->set_max_retries(1);
+    run([&] { ch->declare_queue_with_dlq(wq); });
+    read(1);
+    auto b = std::make_shared<bindRequest>();
+    b->set_exchange_name("ex");
+    b->set_queue_name("work");
+    b->set_binding_key("work");
+    run([&] { ch->bind(b); });
+    read(1);
+
+    auto subscribe = [&](const std::string& tag, const std::string& qname, bool auto_ack) {
+        auto req = std::make_shared<basicConsumeRequest>();
+        req->set_consumer_tag(tag);
+        req->set_queue_name(qname);
+        req->set_auto_ack(auto_ack);
+        run([&] { ch->basic_consume(req); });
+        read(1);
+    };
+    subscribe("dead", "dlq", true);
+    subscribe("w", "work", false);
+    publish("poison", "work");
+
+    auto nack = [&](uint64_t tag) {
+        auto req = std::make_shared<basicNackRequest>();
+        req->set_cid("c1");
+        req->set_delivery_tag(tag);
+        req->set_requeue(true);
+        req->set_no_response(true);
+        run([&] { ch->basic_nack(req); });
+    };
+    auto first = only<basicConsumeResponse>(read(1));
+    ASSERT_EQ(first.size(), 1u);
+    EXPECT_EQ(first[0]->consumer_tag(), "w");
+    nack(first[0]->properties().delivery_tag());   // 第一次退回：重新投递
+
+    auto second = only<basicConsumeResponse>(read(1));
+    ASSERT_EQ(second.size(), 1u);
+    EXPECT_EQ(second[0]->consumer_tag(), "w");
+    nack(second[0]->properties().delivery_tag());  // 达到 max_retries：转入死信队列
+
+    // 死信队列的分发器要被唤醒，其消费者才能收到
+    auto dead = only<basicConsumeResponse>(read(1));
+    ASSERT_EQ(dead.size(), 1u);
+    EXPECT_EQ(dead[0]->consumer_tag(), "dead");
+    EXPECT_EQ(dead[0]->body(), "poison");
+}
+
+TEST_F(ChannelFixture, ConfirmNacksUnroutableAndUnpersistedPublishes) {
+    // 持久化队列的数据文件位置被目录占住：打不开文件，写盘必然失败
+    std::filesystem::create_directories("./test_channel_data/dq.mqd");
+    declare_queue("dq", true);
+    read(1);
+
+    auto sel = std::make_shared<confirmSelectRequest>();
+    sel->set_rid("sel");
+    sel->set_cid("c1");
+    run([&] { ch->confirm_select(sel); });
+    read(1);
+
+    auto request = [](const std::string& key) {
+        auto req = std::make_shared<basicPublishRequest>();
+        req->set_cid("c1");
+        req->set_exchange_name("ex");
+        req->set_body("x");
+        req->mutable_properties()->set_routing_key(key);
+        return req;
+    };
+    run([&] { ch->basic_publish_async(request("nowhere")); });   // 交换机存在但没有队列命中
+    auto got = only<basicConfirm>(read(1));
+    ASSERT_EQ(got.size(), 1u);
+    EXPECT_EQ(got[0]->delivery_tag(), 1u);
+    EXPECT_TRUE(got[0]->nack());
+
+    run([&] { ch->basic_publish_async(request("dq")); });
+    got = only<basicConfirm>(read(1));
+    ASSERT_EQ(got.size(), 1u);
+    EXPECT_EQ(got[0]->delivery_tag(), 2u);
+    EXPECT_TRUE(got[0]->nack());
+    EXPECT_EQ(host->select_queue_message("dq")->getable_count(), 0u);   // 写盘失败的消息不入队
+
+    run([&] { ch->basic_publish_async(request("q1")); });
+    got = only<basicConfirm>(read(1));
+    ASSERT_EQ(got.size(), 1u);
+    EXPECT_EQ(got[0]->delivery_tag(), 3u);
+    EXPECT_FALSE(got[0]->nack());
+}
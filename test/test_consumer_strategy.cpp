@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+#include "../src/server/consumer.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace hz_mq;
+
+/* ---------- 消费者选择策略 ---------- */
+static consumer::ptr make_consumer(const std::string& tag, uint32_t weight = 1)
+{
+    auto c = std::make_shared<consumer>(tag, "q", false, consumer_callback{});
+    c->window = std::make_shared<prefetch_window>();
+    c->weight = weight;
+    return c;
+}
+
+TEST(ConsumerStrategy, ParseFromArgs)
+{
+    EXPECT_EQ(strategy_from_args({}), select_strategy::round_robin);
+    EXPECT_EQ(strategy_from_args({{"x-consumer-strategy", "weighted"}}), select_strategy::weighted);
+    EXPECT_EQ(strategy_from_args({{"x-consumer-strategy", "least-unacked"}}), select_strategy::least_unacked);
+    EXPECT_EQ(strategy_from_args({{"x-consumer-strategy", "p2c"}}), select_strategy::power_of_two);
+    EXPECT_EQ(strategy_from_args({{"x-consumer-strategy", "bogus"}}), select_strategy::round_robin);
+}
+
+TEST(ConsumerStrategy, WeightedRoundRobin)
+{
+    queue_consumer qc("q", select_strategy::weighted);
+    auto a = make_consumer("a", 3);
+    auto b = make_consumer("b", 1);
+    qc.create(a);
+    qc.create(b);
+
+    int ca = 0, cb = 0;
+    for (int i = 0; i < 400; ++i) {
+        auto c = qc.choose();
+        ASSERT_NE(c, nullptr);
+        (c == a ? ca : cb)++;
+        c->release_credit();
+    }
+    EXPECT_EQ(ca, 300);
+    EXPECT_EQ(cb, 100);
+}
+
+TEST(ConsumerStrategy, LeastUnackedPrefersIdle)
+{
+    queue_consumer qc("q", select_strategy::least_unacked);
+    auto busy = make_consumer("busy");
+    auto idle = make_consumer("idle");
+    qc.create(busy);
+    qc.create(idle);
+    for (int i = 0; i < 5; ++i) ASSERT_TRUE(busy->try_acquire_credit());   // 模拟 5 条未确认
+
+    for (int i = 0; i < 5; ++i) EXPECT_EQ(qc.choose(), idle);
+    // 两者都有 5 条未确认后轮流
+    auto next = qc.choose();
+    EXPECT_TRUE(next == busy || next == idle);
+}
+
+TEST(ConsumerStrategy, PowerOfTwoSkipsFullWindow)
+{
+    queue_consumer qc("q", select_strategy::power_of_two);
+    auto full = make_consumer("full");
+    full->window->limit = 1;
+    ASSERT_TRUE(full->try_acquire_credit());
+    auto free1 = make_consumer("f1");
+    qc.create(full);
+    qc.create(free1);
+
+    for (int i = 0; i < 20; ++i) {
+        auto c = qc.choose();
+        EXPECT_EQ(c, free1);
+        c->release_credit();
+    }
+}
+
+TEST(ConsumerPriority, HigherPriorityFirstUntilFull)
+{
+    queue_consumer qc("q");
+    auto low  = make_consumer("low");
+    auto high = make_consumer("high");
+    high->priority = 10;
+    high->window->limit = 2;
+    qc.create(low);
+    qc.create(high);
+
+    EXPECT_EQ(qc.choose(), high);
+    EXPECT_EQ(qc.choose(), high);
+    // 高优先级窗口占满后才落到低优先级
+    EXPECT_EQ(qc.choose(), low);
+    high->release_credit();
+    EXPECT_EQ(qc.choose(), high);
+}
+
+TEST(ConsumerPriority, SingleActiveFailover)
+{
+    std::unordered_map<std::string, std::string> args{{"x-single-active-consumer", "true"}};
+    ASSERT_TRUE(single_active_from_args(args));
+    queue_consumer qc("q", strategy_from_args(args), single_active_from_args(args));
+    auto first  = make_consumer("first");
+    auto second = make_consumer("second");
+    first->window->limit = 1;
+    qc.create(first);
+    qc.create(second);
+
+    EXPECT_EQ(qc.active(), first);
+    EXPECT_EQ(qc.choose(), first);
+    // 活跃消费者窗口满时不会投递给其他消费者
+    EXPECT_EQ(qc.choose(), nullptr);
+
+    qc.remove("first");
+    EXPECT_EQ(qc.active(), second);
+    EXPECT_EQ(qc.choose(), second);
+
+    // 更高优先级的消费者加入后不抢占，当前活跃消费者移除后才接管
+    auto vip = make_consumer("vip");
+    vip->priority = 5;
+    auto late = make_consumer("late");
+    qc.create(vip);
+    qc.create(late);
+    EXPECT_EQ(qc.active(), second);
+    EXPECT_EQ(qc.choose(), second);
+
+    qc.remove("second");
+    EXPECT_EQ(qc.active(), vip);
+    EXPECT_EQ(qc.choose(), vip);
+}
@@ -33,7 +33,7 @@ TEST(DeadLetterQueueTest, BasicDLQFunctionality) {
     EXPECT_EQ(msg->payload().body(), testMsg);
 
     // 拒绝消息（NACK），不重新入队
-    vh.basic_nack("test_queue", msg->payload().properties().id(), false, "Processing failed");
+    vh.basic_nack("test_queue", msg->payload().properties().numeric_id(), false, "Processing failed");
 
     // 验证原队列中没有消息了
     message_ptr remaining_msg = vh.basic_consume("test_queue");
@@ -64,7 +64,7 @@ TEST(DeadLetterQueueTest, NACKWithRequeue) {
     ASSERT_NE(msg, nullptr);
 
     // 拒绝消息但重新入队
-    vh.basic_nack("test_queue", msg->payload().properties().id(), true, "Temporary failure");
+    vh.basic_nack("test_queue", msg->payload().properties().numeric_id(), true, "Temporary failure");
 
     // 验证消息仍在队列中
     message_ptr requeued_msg = vh.basic_consume("test_queue");
@@ -91,7 +91,7 @@ TEST(DeadLetterQueueTest, QueueWithoutDLQConfig) {
     ASSERT_NE(msg, nullptr);
 
     // 拒绝消息，不重新入队（但没有死信队列配置）
-    vh.basic_nack("test_queue", msg->payload().properties().id(), false, "Processing failed");
+    vh.basic_nack("test_queue", msg->payload().properties().numeric_id(), false, "Processing failed");
 
     // 验证消息被删除
     message_ptr remaining_msg = vh.basic_consume("test_queue");
@@ -137,7 +137,7 @@ TEST(DeadLetterQueueTest, ExchangeOperations) {
     ASSERT_NE(msg, nullptr);
 
     // 测试消息确认
-    vh.basic_ack("test_queue", msg->payload().properties().id());
+    vh.basic_ack("test_queue", msg->payload().properties().numeric_id());
 }
 
 TEST(DeadLetterQueueTest, ErrorHandling) {
@@ -302,7 +302,7 @@ TEST(DeadLetterQueueTest, DeadLetterQueueAdvanced) {
     for (int i = 0; i < 3; ++i) {
         message_ptr msg = vh.basic_consume("test_queue");
         ASSERT_NE(msg, nullptr);
-        vh.basic_nack("test_queue", msg->payload().properties().id(), false, "Processing failed");
+        vh.basic_nack("test_queue", msg->payload().properties().numeric_id(), false, "Processing failed");
     }
 
     // 验证原队列为空
@@ -378,7 +378,7 @@ TEST(DeadLetterQueueTest, QueueMessageFunctions) {
     // 测试remove函数（通过basic_ack）
     message_ptr msg1 = vh.basic_consume("test_queue");
     ASSERT_NE(msg1, nullptr);
-    vh.basic_ack("test_queue", msg1->payload().properties().id());
+    vh.basic_ack("test_queue", msg1->payload().properties().numeric_id());
 
     // 再插入一条消息，保证队列有消息
     ASSERT_TRUE(vh.basic_publish("test_queue", &props, "message3"));
@@ -386,7 +386,7 @@ TEST(DeadLetterQueueTest, QueueMessageFunctions) {
     // 测试remove函数（通过basic_nack）
     message_ptr msg2 = vh.basic_consume("test_queue");
     ASSERT_NE(msg2, nullptr);
-    vh.basic_nack("test_queue", msg2->payload().properties().id(), false, "test");
+    vh.basic_nack("test_queue", msg2->payload().properties().numeric_id(), false, "test");
 
     // 测试get_all_messages函数（通过basic_nack中的死信队列处理）
     ASSERT_TRUE(vh.declare_exchange("test_exchange", ExchangeType::DIRECT, false, false, {}));
@@ -396,7 +396,7 @@ TEST(DeadLetterQueueTest, QueueMessageFunctions) {
     
     message_ptr dlq_msg = vh.basic_consume("dlq_test_queue");
     ASSERT_NE(dlq_msg, nullptr);
-    vh.basic_nack("dlq_test_queue", dlq_msg->payload().properties().id(), false, "test");
+    vh.basic_nack("dlq_test_queue", dlq_msg->payload().properties().numeric_id(), false, "test");
 }
 
 TEST(DeadLetterQueueTest, EdgeCases) {
@@ -676,7 +676,49 @@ TEST(DeadLetterQueueTest, ComplexRoutingScenarios) {
     ASSERT_NE(msg3, nullptr);
 }
 
+TEST(DeadLetterQueueTest, MaxRetriesDeadLettersPoisonMessage) {
+    std::string baseDir = "./testdata_retry";
+    virtual_host vh("TestHost", baseDir, baseDir + "/meta.db");
+
+    ASSERT_TRUE(vh.declare_exchange("retry_dlx", ExchangeType::DIRECT, false, false, {}));
+    ASSERT_TRUE(vh.declare_queue("retry_dlq", false, false, false, {}));
+    // 经交换机投递到队列时路由键须与队列名一致
+    ASSERT_TRUE(vh.bind("retry_dlx", "retry_dlq", "retry_dlq"));
+    dead_letter_config dlq_config("retry_dlx", "retry_dlq", 2);
+    ASSERT_TRUE(vh.declare_queue_with_dlq("work", false, false, false, {}, dlq_config));
+
+    BasicProperties props;
+    props.set_id("p1");
+    ASSERT_TRUE(vh.basic_publish("work", &props, "poison"));
+
+    // 前 max_retries 次退回：放回队首，delivery_count 递增
+    for (uint32_t i = 1; i <= 2; ++i) {
+        message_ptr msg = vh.basic_take("work");
+        ASSERT_NE(msg, nullptr);
+        vh.basic_nack("work", "p1", true, "fail");
+        message_ptr again = vh.select_queue_message("work")->front();
+        ASSERT_NE(again, nullptr);
+        EXPECT_EQ(again->payload().delivery_count(), i);
+        EXPECT_TRUE(again->payload().properties().redelivered());
+    }
+
+    // 再次退回：超过上限，转入死信队列
+    message_ptr last = vh.basic_take("work");
+    ASSERT_NE(last, nullptr);
+    std::vector<std::string> dead_lettered;   // 调用方据此唤醒死信队列的分发器
+    vh.basic_nack("work", last->payload().properties().numeric_id(), true, "fail", &dead_lettered);
+    EXPECT_EQ(dead_lettered, std::vector<std::string>{"retry_dlq"});
+    EXPECT_EQ(vh.basic_consume("work"), nullptr);
+    message_ptr dead = vh.basic_consume("retry_dlq");
+    ASSERT_NE(dead, nullptr);
+    EXPECT_EQ(dead->payload().body(), "poison");
+    EXPECT_EQ(dead->payload().properties().headers().at("x-death-reason"), "max-retries");
+    EXPECT_EQ(dead->payload().properties().headers().at("x-delivery-count"), "3");
+
+    system(("rm -rf " + baseDir).c_str());
+}
+
 int main(int argc, char** argv) {
     testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
-} 
\ No newline at end of file
+}
\ No newline at end of file
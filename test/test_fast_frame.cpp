@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include "../src/common/fast_frame.hpp"
+
+#include <string>
+
+using namespace hz_mq;
+
+TEST(FastFrame, RoundTripAndPartial)
+{
+    fast_frame f;
+    f.opcode  = fast_op::DELIVER;
+    f.flags   = FAST_FLAG_REDELIVERED;
+    f.channel = 7;
+    f.tag     = 0x0102030405060708ULL;
+    f.name    = "ctag";
+    f.key     = "q1";
+    f.id      = "m-1";
+    f.body    = std::string("hello\0world", 11);
+
+    std::string wire;
+    encode_fast_frame(f, wire);
+    encode_fast_frame(f, wire);                       // 两帧连续
+    ASSERT_TRUE(is_fast_frame(wire.data(), wire.size()));
+    size_t one = wire.size() / 2;
+
+    fast_frame out;
+    EXPECT_EQ(decode_fast_frame(wire.data(), FAST_HEADER_LEN - 1, &out), 0);   // 头不完整
+    EXPECT_EQ(decode_fast_frame(wire.data(), one - 1, &out), 0);               // 体不完整
+    ASSERT_EQ(decode_fast_frame(wire.data(), wire.size(), &out), static_cast<long>(one));
+    EXPECT_EQ(out.opcode, fast_op::DELIVER);
+    EXPECT_TRUE(out.has(FAST_FLAG_REDELIVERED));
+    EXPECT_EQ(out.channel, 7u);
+    EXPECT_EQ(out.tag, f.tag);
+    EXPECT_EQ(out.name, "ctag");
+    EXPECT_EQ(out.key, "q1");
+    EXPECT_EQ(out.id, "m-1");
+    EXPECT_EQ(out.body, f.body);
+}
+
+TEST(FastFrame, RejectsBadOpcodeAndProtobufFrames)
+{
+    fast_frame f;
+    f.opcode = fast_op::ACK;
+    std::string wire;
+    encode_fast_frame(f, wire);
+    wire[1] = 9;                                      // 未知 opcode
+    fast_frame out;
+    EXPECT_EQ(decode_fast_frame(wire.data(), wire.size(), &out), -1);
+
+    // ProtobufCodec 帧以大端长度开头，首字节不可能是 FAST_MAGIC
+    const char codec_frame[] = {0x00, 0x00, 0x00, 0x20};
+    EXPECT_FALSE(is_fast_frame(codec_frame, sizeof(codec_frame)));
+}
+
+TEST(FastFrame, RejectsFieldsLongerThanLengthPrefix)
+{
+    fast_frame f;
+    f.opcode = fast_op::PUBLISH;
+    std::string key(FAST_MAX_FIELD, 'k');               // 恰好 65535 仍可编码
+    f.name   = "ex";
+    f.key    = key;
+    std::string wire;
+    ASSERT_TRUE(encode_fast_frame(f, wire));
+    fast_frame out;
+    ASSERT_GT(decode_fast_frame(wire.data(), wire.size(), &out), 0);
+    EXPECT_EQ(out.key.size(), FAST_MAX_FIELD);
+
+    // 超长字段不截断：不写入 out，调用方改走 protobuf
+    key.push_back('k');
+    f.key = key;
+    EXPECT_FALSE(fast_frame_fits(f));
+    std::string before = wire;
+    EXPECT_FALSE(encode_fast_frame(f, wire));
+    EXPECT_FALSE(encode_fast_header(f, wire));
+    EXPECT_EQ(wire, before);
+
+    f.key = "k";
+    std::string id(FAST_MAX_FIELD + 1, 'i');
+    f.id  = id;
+    EXPECT_FALSE(encode_fast_frame(f, wire));
+    EXPECT_EQ(wire, before);
+}
@@ -478,7 +478,7 @@ TEST_F(MessageFilterTest, VirtualHostMessageOperations) {
     EXPECT_EQ(msg->payload().body(), "test message");
 
     // 测试消息确认
-    vh.basic_ack("test_queue", msg->payload().properties().id());
+    vh.basic_ack("test_queue", msg->payload().properties().numeric_id());
 
     // 测试消费不存在的队列
     auto msg2 = vh.basic_consume("nonexistent_queue");
@@ -629,7 +629,7 @@ TEST_F(MessageFilterTest, VirtualHostMessageIdGeneration) {
     BasicProperties props1;
     props1.set_routing_key("key1");
     ASSERT_TRUE(vh.basic_publish("test_queue", &props1, "message1"));
-    EXPECT_FALSE(props1.id().empty());
+    EXPECT_NE(props1.numeric_id(), 0u);
 
     // 测试手动设置消息ID
     BasicProperties props2;
@@ -729,7 +729,7 @@ TEST_F(MessageFilterTest, VirtualHostBasicNackWithDLQ) {
     ASSERT_NE(msg, nullptr);
 
     // 拒绝消息，不重新入队
-    vh.basic_nack("test_queue", msg->payload().properties().id(), false, "Processing failed");
+    vh.basic_nack("test_queue", msg->payload().properties().numeric_id(), false, "Processing failed");
 
     // 验证消息被投递到死信队列
     auto dlq_msg = vh.basic_consume("dlq_queue");
@@ -757,7 +757,7 @@ TEST_F(MessageFilterTest, VirtualHostBasicNackRequeue) {
     ASSERT_NE(msg, nullptr);
 
     // 拒绝消息，重新入队
-    vh.basic_nack("test_queue", msg->payload().properties().id(), true, "Temporary failure");
+    vh.basic_nack("test_queue", msg->payload().properties().numeric_id(), true, "Temporary failure");
 
     // 验证消息重新入队
     auto requeued_msg = vh.basic_consume("test_queue");
@@ -785,7 +785,7 @@ TEST_F(MessageFilterTest, VirtualHostBasicNackNoDLQ) {
     ASSERT_NE(msg, nullptr);
 
     // 拒绝消息，不重新入队
-    vh.basic_nack("test_queue", msg->payload().properties().id(), false, "Processing failed");
+    vh.basic_nack("test_queue", msg->payload().properties().numeric_id(), false, "Processing failed");
 
     // 验证消息被删除
     auto remaining_msg = vh.basic_consume("test_queue");
@@ -927,12 +927,9 @@ TEST_F(MessageFilterTest, VirtualHostMessageIdGenerationMultiple) {
     ASSERT_TRUE(vh.basic_publish("test_queue", &props3, "message3"));
 
     // 验证每个消息都有唯一的ID
-    EXPECT_FALSE(props1.id().empty());
-    EXPECT_FALSE(props2.id().empty());
-    EXPECT_FALSE(props3.id().empty());
-    EXPECT_NE(props1.id(), props2.id());
-    EXPECT_NE(props2.id(), props3.id());
-    EXPECT_NE(props1.id(), props3.id());
+    EXPECT_NE(props1.numeric_id(), 0u);
+    EXPECT_LT(props1.numeric_id(), props2.numeric_id());
+    EXPECT_LT(props2.numeric_id(), props3.numeric_id());
 
     // 清理
     system("rm -rf ./test_vh_msgid_multiple_data");
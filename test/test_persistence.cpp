@@ -109,6 +109,110 @@ TEST(Persistence, RemoveHeadAfterRecovery) {
     std::filesystem::remove_all("./persist_data7");
 }
 
+TEST(Persistence, LegacyRecordsInvalidateInPlace) {
+    std::filesystem::remove_all("./persist_legacy");
+    std::filesystem::create_directories("./persist_legacy");
+    {
+        // 旧格式记录：没有 delivery_count / numeric_id
+        std::ofstream out("./persist_legacy/lq.mqd", std::ios::binary);
+        for (const char* id : {"old1", "old2"}) {
+            MessagePayload p;
+            p.mutable_properties()->set_id(id);
+            p.set_body(std::string("body-") + id);
+            p.set_valid("1");
+            std::string data = p.SerializeAsString();
+            uint32_t len = static_cast<uint32_t>(data.size());
+            out.write(reinterpret_cast<const char*>(&len), sizeof(len));
+            out.write(data.data(), data.size());
+        }
+    }
+    {
+        queue_message qm("./persist_legacy", "lq");
+        qm.recovery();
+        ASSERT_EQ(qm.getable_count(), 2u);
+        qm.take();
+        qm.take();
+        EXPECT_TRUE(qm.ack("old1"));       // 只改 valid 字节
+        EXPECT_TRUE(qm.requeue("old2"));   // 长度变化：追加新记录并作废旧记录
+    }
+    queue_message qm2("./persist_legacy", "lq");
+    qm2.recovery();
+    ASSERT_EQ(qm2.getable_count(), 1u);
+    EXPECT_EQ(qm2.front()->payload().properties().id(), "old2");
+    EXPECT_EQ(qm2.front()->payload().delivery_count(), 1u);
+    std::filesystem::remove_all("./persist_legacy");
+}
+
+TEST(Persistence, CompressedRecordsRecoverAndShrinkFile) {
+    std::filesystem::remove_all("./persist_zip");
+    std::string json;
+    for (int i = 0; i < 64; ++i) json += R"({"user":"alice","action":"login","ok":true},)";
+
+    body_codec codec;
+    codec.enabled = true;
+    codec.dict    = R"({"user":"","action":"","ok":true})";
+    {
+        queue_message qm("./persist_zip", "zq", codec);
+        BasicProperties bp;
+        bp.set_delivery_mode(DeliveryMode::DURABLE);
+        bp.set_id("big");
+        qm.insert(&bp, json, true);
+        bp.set_id("small");
+        qm.insert(&bp, "tiny", true);                      // 低于阈值：原样落盘
+        qm.take();
+        ASSERT_TRUE(qm.requeue("big"));                    // 改写压缩记录：长度不变、原地完成
+    }
+    EXPECT_LT(std::filesystem::file_size("./persist_zip/zq.mqd"), json.size() / 4);
+
+    queue_message qm2("./persist_zip", "zq", codec);
+    qm2.recovery();
+    ASSERT_EQ(qm2.getable_count(), 2u);
+    EXPECT_EQ(qm2.front()->payload().body(), json);
+    EXPECT_TRUE(qm2.front()->payload().body_encoding().empty());
+    EXPECT_EQ(qm2.front()->payload().delivery_count(), 1u);
+
+    // 字典不匹配：无法解压的记录不会被当作原文恢复
+    queue_message qm3("./persist_zip", "zq", body_codec{true, COMPRESS_MIN_BYTES, "other"});
+    qm3.recovery();
+    EXPECT_EQ(qm3.getable_count(), 0u);
+    std::filesystem::remove_all("./persist_zip");
+}
+
+TEST(BodyCodec, ThresholdAndDictionary) {
+    body_codec c;
+    c.enabled   = true;
+    c.min_bytes = 16;
+    std::string out;
+    EXPECT_FALSE(c.encode("short", &out));                 // 低于阈值
+    EXPECT_FALSE(c.encode("0123456789abcdefghij", &out));  // 不可压缩
+
+    std::string body(1024, 'a');
+    ASSERT_TRUE(c.encode(body, &out));
+    std::string back;
+    ASSERT_TRUE(c.decode(out, &back));
+    EXPECT_EQ(back, body);
+    EXPECT_FALSE(c.decode(out.substr(0, out.size() / 2), &back));   // 截断
+
+    body_codec with_dict = c;
+    with_dict.dict = std::string(64, 'a');
+    ASSERT_TRUE(with_dict.encode(body, &out));
+    EXPECT_FALSE(c.decode(out, &back));                    // 缺字典
+    ASSERT_TRUE(with_dict.decode(out, &back));
+    EXPECT_EQ(back, body);
+
+    // 解压炸弹：输出超过上限即失败，不会把整段解出来
+    std::string zeros(4 * 1024 * 1024, '\0');
+    ASSERT_TRUE(c.encode(zeros, &out));
+    EXPECT_LT(out.size(), 8u * 1024);
+    EXPECT_FALSE(c.decode(out, &back, 1024 * 1024));
+    ASSERT_TRUE(c.decode(out, &back, zeros.size()));
+    EXPECT_EQ(back.size(), zeros.size());
+
+    body_codec from = body_codec::from_args({{"x-compress", "deflate"}, {"x-compress-min-bytes", "bad"}});
+    EXPECT_TRUE(from.enabled);
+    EXPECT_EQ(from.min_bytes, COMPRESS_MIN_BYTES);
+}
+
 TEST(Persistence, DiskFullSimulation)          /* —— P8 —— */
 {
     const std::string dir = "./persist_full";
@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include "../src/client/request_pipeline.hpp"
+#include "../src/common/protocol.pb.h"
+
+#include <thread>
+#include <vector>
+
+using namespace hz_mq;
+
+// 记录发出的请求，由测试决定何时、以何种顺序回响应
+class PipelineFixture : public ::testing::Test {
+protected:
+    PipelineFixture()
+        : pipe([this](const google::protobuf::Message& req) {
+              std::lock_guard<std::mutex> lk(mtx);
+              sent.push_back(static_cast<const basicPublishRequest&>(req).rid());
+              return connected;
+          }, 4) {}
+
+    response_ptr reply(const std::string& rid, bool ok = true)
+    {
+        auto resp = std::make_shared<basicCommonResponse>();
+        resp->set_rid(rid);
+        resp->set_ok(ok);
+        return resp;
+    }
+
+    std::mutex               mtx;
+    std::vector<std::string> sent;
+    bool                     connected{true};
+    request_pipeline         pipe;
+};
+
+TEST_F(PipelineFixture, OutOfOrderResponsesReachTheirCallers) {
+    basicPublishRequest req;
+    auto f1 = pipe.call(req);
+    auto f2 = pipe.call(req);
+    auto f3 = pipe.call(req);
+    ASSERT_EQ(sent.size(), 3u);
+    EXPECT_EQ(pipe.outstanding(), 3u);
+
+    EXPECT_TRUE(pipe.on_response(reply(sent[2], false)));
+    EXPECT_TRUE(pipe.on_response(reply(sent[0])));
+    EXPECT_TRUE(pipe.on_response(reply(sent[1])));
+    EXPECT_FALSE(pipe.on_response(reply(sent[1])));          // 重复响应不再匹配
+    EXPECT_FALSE(pipe.on_response(reply("cli-open-c1")));    // 非流水线 rid 交给调用方
+    EXPECT_FALSE(pipe.on_response(std::make_shared<basicConsumeResponse>()));   // 无 rid 字段
+
+    auto r1 = std::dynamic_pointer_cast<basicCommonResponse>(f1.get());
+    auto r3 = std::dynamic_pointer_cast<basicCommonResponse>(f3.get());
+    ASSERT_NE(r1, nullptr);
+    ASSERT_NE(r3, nullptr);
+    EXPECT_TRUE(r1->ok());
+    EXPECT_FALSE(r3->ok());
+    EXPECT_NE(f2.get(), nullptr);
+    EXPECT_EQ(pipe.outstanding(), 0u);
+}
+
+TEST_F(PipelineFixture, WindowBlocksUntilResponseAndFailAllReleases) {
+    basicPublishRequest req;
+    std::vector<std::future<response_ptr>> futs;
+    for (int i = 0; i < 4; ++i) futs.push_back(pipe.call(req));
+
+    // 窗口已满：第 5 个请求等到有响应才发出
+    std::thread producer([&] { futs.push_back(pipe.call(req)); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        EXPECT_EQ(sent.size(), 4u);
+    }
+    EXPECT_TRUE(pipe.on_response(reply(sent[0])));
+    producer.join();
+    EXPECT_EQ(sent.size(), 5u);
+
+    // 连接断开：剩余请求以空响应完成
+    pipe.fail_all();
+    for (size_t i = 1; i < futs.size(); ++i) EXPECT_EQ(futs[i].get(), nullptr);
+    EXPECT_EQ(pipe.outstanding(), 0u);
+
+    connected = false;
+    EXPECT_EQ(pipe.call(req).get(), nullptr);                // 发送失败立即完成
+    EXPECT_EQ(pipe.outstanding(), 0u);
+}
+
+TEST_F(PipelineFixture, ExpiredRequestsReleaseWindowSlots) {
+    basicPublishRequest req;
+    std::vector<std::future<response_ptr>> futs;
+    for (int i = 0; i < 4; ++i) futs.push_back(pipe.call(req));
+    auto now = std::chrono::steady_clock::now();
+    EXPECT_EQ(pipe.expire(now), 0u);                          // 尚未到期
+
+    // 响应一直不来：到期后以空响应完成，窗口腾出
+    EXPECT_EQ(pipe.expire(now + DEFAULT_PIPELINE_TIMEOUT + std::chrono::seconds(1)), 4u);
+    for (auto& f : futs) EXPECT_EQ(f.get(), nullptr);
+    EXPECT_EQ(pipe.outstanding(), 0u);
+    EXPECT_FALSE(pipe.on_response(reply(sent[0])));           // 迟到的响应不再匹配
+
+    auto next = pipe.call(req);
+    ASSERT_EQ(sent.size(), 5u);
+    EXPECT_TRUE(pipe.on_response(reply(sent[4])));
+    EXPECT_NE(next.get(), nullptr);
+}
+
+TEST(RequestPipeline, ExpireWakesBlockedSubmit) {
+    request_pipeline pipe([](const google::protobuf::Message&) { return true; }, 1,
+                          std::chrono::milliseconds(10));
+    basicPublishRequest req;
+    auto first = pipe.call(req);
+    std::thread producer([&] { pipe.call(req); });           // 窗口已满，阻塞
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(pipe.expire(), 1u);
+    producer.join();
+    EXPECT_EQ(first.get(), nullptr);
+    EXPECT_EQ(pipe.outstanding(), 1u);
+}
+
+TEST(RequestPipeline, ParseRidAcceptsOnlyPlainNumbers) {
+    uint64_t id = 0;
+    EXPECT_TRUE(request_pipeline::parse_rid("42", &id));
+    EXPECT_EQ(id, 42u);
+    EXPECT_FALSE(request_pipeline::parse_rid("hb", &id));
+    EXPECT_FALSE(request_pipeline::parse_rid("42x", &id));
+    EXPECT_FALSE(request_pipeline::parse_rid("0", &id));
+    EXPECT_FALSE(request_pipeline::parse_rid("", &id));
+}
@@ -5,7 +5,14 @@
 #include "../server/channel.hpp"
 #include "../server/route.hpp"          // 直接覆盖 match_route
 #include "../server/queue_message.hpp"  // 测 queue_message::remove()
-#include "../common/thread_pool.hpp"    // 测线程池
+#include "../server/arena_codec.hpp"    // 测解码 Arena 复用
+#include "../server/scatter_send.hpp"   // 测分段发送的帧格式
+#include "../common/snowflake.hpp"      // 测数值消息 id
+#include "../common/slab_pool.hpp"      // 测 slab 池
+#include <arpa/inet.h>
+#include <zlib.h>
+#include <thread>
+#include <unordered_set>
 
 
 
@@ -71,7 +78,8 @@ TEST_F(PtpFixture, AckRemove)
     publish("m1");
     auto m = host->basic_consume("q1");
     ASSERT_NE(m, nullptr);
-    std::string id = m->payload().properties().id();   // ! insert() 里暂未赋值，可自行生成
+    uint64_t id = m->payload().properties().numeric_id();
+    EXPECT_NE(id, 0u);
     host->basic_ack("q1", id);
     EXPECT_EQ(host->basic_consume("q1"), nullptr);
 }
@@ -106,7 +114,7 @@ TEST_F(PtpFixture, AutoAck)
     // 模拟 channel::consume()  (不走线程池简化)
     message_ptr mp = host->basic_consume("q1");
     ASSERT_NE(mp,nullptr);
-    host->basic_ack("q1", mp->payload().properties().id());
+    host->basic_ack("q1", mp->payload().properties().numeric_id());
     EXPECT_EQ( host->basic_consume("q1"), nullptr );
 }
 
@@ -165,6 +173,56 @@ TEST(VHostPublishEx, TopicRouting)
     EXPECT_EQ( vh->basic_consume("diskq")->payload().body(), "disk-io" );
 }
 
+/* ---------- E4b 发布是否可能落盘看绑定队列的 durable，不看 delivery_mode ---------- */
+TEST(VHostPublishEx, DurabilityFollowsBoundQueues)
+{
+    auto vh = std::make_shared<virtual_host>("vh","./durable_probe","./durable_probe/meta.db");
+    vh->declare_exchange("mem", ExchangeType::FANOUT,false,false,{});
+    vh->declare_exchange("disk", ExchangeType::FANOUT,false,false,{});
+    vh->declare_queue("volatile_q",false,false,false,{});
+    vh->declare_queue("durable_q",true,false,false,{});
+    vh->bind("mem","volatile_q","");
+    vh->bind("disk","volatile_q","");
+    vh->bind("disk","durable_q","");
+
+    EXPECT_FALSE(vh->binds_durable_queue("mem"));
+    EXPECT_TRUE (vh->binds_durable_queue("disk"));
+    EXPECT_FALSE(vh->binds_durable_queue("missing"));
+    vh->unbind("disk","durable_q");
+    EXPECT_FALSE(vh->binds_durable_queue("disk"));
+    std::filesystem::remove_all("./durable_probe");
+}
+
+/* ---------- 多个 I/O 线程同时声明 / 绑定与发布 ---------- */
+TEST(VHostPublishEx, BindWhilePublishingFromOtherThreads)
+{
+    auto vh = std::make_shared<virtual_host>("vh","./bind_race","./bind_race/meta.db");
+    vh->declare_exchange("fan", ExchangeType::FANOUT,false,false,{});
+    vh->declare_queue("base",false,false,false,{});
+    vh->bind("fan","base","");
+
+    std::vector<std::thread> publishers;
+    for (int t = 0; t < 3; ++t) {
+        publishers.emplace_back([&] {
+            for (int i = 0; i < 2000; ++i) {
+                BasicProperties bp;
+                EXPECT_TRUE(vh->publish_to_exchange("fan", &bp, "x"));
+            }
+        });
+    }
+    // 声明 / 绑定 / 解绑 / 删除与发布并发进行：绑定表与队列表不能在遍历中被改写
+    for (int i = 0; i < 200; ++i) {
+        std::string q = "q" + std::to_string(i % 8);
+        vh->declare_queue(q,false,false,false,{});
+        vh->bind("fan",q,"");
+        if (i % 3 == 0) vh->unbind("fan",q);
+        if (i % 5 == 0) vh->delete_queue(q);
+    }
+    for (auto& th : publishers) th.join();
+    EXPECT_EQ(vh->select_queue_message("base")->getable_count(), 6000u);
+    std::filesystem::remove_all("./bind_race");
+}
+
 /* ---------- E5 declare_queue 的幂等、防重 ---------- */
 TEST(VHostQueue, DeclareIdempotent)
 {
@@ -174,15 +232,51 @@ TEST(VHostQueue, DeclareIdempotent)
     EXPECT_EQ( vh->all_queues().size(), 1u ); // 包括默认绑定 ""->dup
 }
 
-/* ---------- E6 thread_pool ★ push / 并发执行 ---------- */
-TEST(ThreadPool, PushAndRun)
+TEST(VHostQueue, ConcurrentGetAndConsumeNeverDuplicate)
+{
+    auto vh = std::make_shared<virtual_host>("vh","./get_race","./get_race/tmp.db");
+    vh->declare_queue("gq",false,false,false,{});
+    const int N = 20000;
+    BasicProperties bp;
+    bp.set_routing_key("gq");
+    for (int i = 0; i < N; ++i) {
+        bp.clear_numeric_id();
+        vh->basic_publish("gq", &bp, "m");
+    }
+
+    // 两个线程模拟 loop 上的 basic_get（auto_ack / 手动确认各一），一个模拟分发器
+    std::mutex mtx;
+    std::vector<uint64_t> ids;
+    auto collect = [&](const std::vector<message_ptr>& got) {
+        std::lock_guard<std::mutex> g(mtx);
+        for (auto& m : got) ids.push_back(m->payload().properties().numeric_id());
+    };
+    std::thread g1([&]{ while (true) { auto v = vh->basic_get("gq", 8, true);  if (v.empty()) break; collect(v); } });
+    std::thread g2([&]{ while (true) { auto v = vh->basic_get("gq", 8, false); if (v.empty()) break; collect(v); } });
+    std::thread d([&]{ while (auto m = vh->basic_consume("gq")) collect({m}); });
+    g1.join(); g2.join(); d.join();
+
+    EXPECT_EQ(ids.size(), static_cast<size_t>(N));
+    std::unordered_set<uint64_t> uniq(ids.begin(), ids.end());
+    EXPECT_EQ(uniq.size(), ids.size());            // 同一条消息只投递一次
+    std::filesystem::remove_all("./get_race");
+}
+
+TEST(VHostQueue, TotalDepthSumsPendingMessages)
 {
-    thread_pool pool(4);
-    std::atomic<int> sum{0};
-    for(int i=0;i<100;i++)
-        pool.push([&]{ sum.fetch_add(1,std::memory_order_relaxed); });
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));
-    EXPECT_EQ(sum.load(), 100);
+    auto vh = std::make_shared<virtual_host>("vh","./depth","./depth/tmp.db");
+    vh->declare_queue("d1",false,false,false,{});
+    vh->declare_queue("d2",false,false,false,{});
+    EXPECT_EQ(vh->total_depth(), 0u);
+    BasicProperties bp;
+    bp.set_routing_key("d1");
+    for (int i = 0; i < 3; ++i) vh->basic_publish("d1", &bp, "x");
+    bp.set_routing_key("d2");
+    vh->basic_publish("d2", &bp, "y");
+    EXPECT_EQ(vh->total_depth(), 4u);
+    vh->basic_consume_and_remove("d1");
+    EXPECT_EQ(vh->total_depth(), 3u);
+    std::filesystem::remove_all("./depth");
 }
 
 
@@ -206,14 +300,178 @@ TEST(RouteMatchEdge, CornerCases)
     EXPECT_TRUE (match_route(ExchangeType::TOPIC , "a.b",   "#"));       // 单 # 全匹配
 }
 
-/* ---------- C4 thread_pool 析构路径 ---------------- */
-TEST(ThreadPool, GracefulDestruct)
+TEST(VHostPublishEx, BatchRoutesEachEntry)
 {
-    std::atomic<int> counter{0};
-    {
-        thread_pool pool(2);
-        for(int i=0;i<20;i++)
-            pool.push([&]{ counter.fetch_add(1,std::memory_order_relaxed); });
-    }   // 作用域结束触发析构，必须把 20 个任务都跑完
-    EXPECT_EQ(counter.load(), 20);
-}
\ No newline at end of file
+    auto vh = std::make_shared<virtual_host>("vh",".","./tmp.db");
+    vh->declare_exchange("dx", ExchangeType::DIRECT,false,false,{});
+    vh->declare_queue("bq1",false,false,false,{});
+    vh->declare_queue("bq2",false,false,false,{});
+    vh->bind("dx","bq1","bq1");
+    vh->bind("dx","bq2","bq2");
+
+    basicPublishBatchRequest batch;
+    batch.set_exchange_name("dx");
+    for (const char* key : {"bq1", "bq2", "nowhere", "bq1"}) {
+        publishEntry* e = batch.add_entries();
+        e->set_routing_key(key);
+        e->set_body(std::string("to-") + key);
+    }
+
+    std::vector<bool> results;
+    std::vector<std::string> touched;
+    EXPECT_EQ(vh->publish_batch_to_exchange("dx", batch.mutable_entries(), &results, &touched), 3u);
+    EXPECT_EQ(results, (std::vector<bool>{true, true, false, true}));
+    EXPECT_EQ(touched.size(), 2u);                     // 每个队列只记一次
+    EXPECT_EQ(vh->basic_consume("bq1")->payload().body(), "to-bq1");
+    EXPECT_EQ(vh->basic_consume("bq2")->payload().body(), "to-bq2");
+    EXPECT_EQ(vh->basic_consume("bq1")->payload().body(), "to-bq1");
+
+    EXPECT_EQ(vh->publish_batch_to_exchange("missing", batch.mutable_entries(), &results, nullptr), 0u);
+    EXPECT_EQ(results, (std::vector<bool>(4, false)));
+}
+
+TEST(VHostPublishEx, FanoutSharesBody)
+{
+    auto vh = std::make_shared<virtual_host>("vh",".","./tmp.db");
+    vh->declare_exchange("share", ExchangeType::FANOUT,false,false,{});
+    for (const char* q : {"s1", "s2", "s3"}) {
+        vh->declare_queue(q,false,false,false,{});
+        vh->bind("share", q, "");
+    }
+
+    BasicProperties bp;
+    EXPECT_TRUE( vh->publish_to_exchange("share", &bp, std::string(64 * 1024, 'z')) );
+    auto m1 = vh->select_queue_message("s1")->front();
+    auto m2 = vh->select_queue_message("s2")->front();
+    auto m3 = vh->select_queue_message("s3")->front();
+    ASSERT_NE(m1, nullptr);
+    EXPECT_EQ(m1, m2);                                 // 三个队列引用同一条消息
+    EXPECT_EQ(m1, m3);
+    EXPECT_EQ(m1->payload().body().data(), m3->payload().body().data());
+
+    // 一个队列退回消息时写时复制，不影响其他队列
+    const uint64_t id = m1->payload().properties().numeric_id();
+    ASSERT_EQ(vh->basic_take("s1"), m1);
+    EXPECT_TRUE(vh->basic_requeue("s1", id));
+    auto again = vh->select_queue_message("s1")->front();
+    EXPECT_NE(again, m2);
+    EXPECT_TRUE(again->payload().properties().redelivered());
+    EXPECT_FALSE(m2->payload().properties().redelivered());
+    EXPECT_EQ(m2->payload().delivery_count(), 0u);
+}
+
+TEST(FrameArena, ReusedOnlyAfterRequestsReleased)
+{
+    frame_arena::ptr a = acquire_decode_arena();
+    frame_arena* first = a.get();
+    basicCommonResponse* held = google::protobuf::Arena::CreateMessage<basicCommonResponse>(a->get());
+    held->set_rid("r1");
+    std::shared_ptr<google::protobuf::Message> req(a, held);   // 模拟被协程持有的请求
+    a.reset();
+
+    frame_arena::ptr b = acquire_decode_arena();
+    EXPECT_NE(b.get(), first);          // 仍被持有：另建 Arena，不能 Reset
+    EXPECT_EQ(held->rid(), "r1");
+
+    frame_arena* second = b.get();
+    b.reset();
+    frame_arena::ptr c = acquire_decode_arena();
+    EXPECT_EQ(c.get(), second);         // 已全部释放：Reset 后复用
+}
+
+TEST(ScatterSend, BodyFrameMatchesCodecFormat)
+{
+    basicConsumeResponse resp;
+    resp.set_cid("c1");
+    resp.set_consumer_tag("t1");
+    resp.mutable_properties()->set_delivery_tag(42);
+    std::string body(SCATTER_MIN_BODY + 7, 'x');
+
+    std::string head, tail;
+    build_body_frame(resp, basicConsumeResponse::kBodyFieldNumber, body, &head, &tail);
+    std::string frame = head + body + tail;
+
+    auto rd32 = [&](size_t off) {
+        uint32_t v;
+        std::memcpy(&v, frame.data() + off, 4);
+        return static_cast<int32_t>(ntohl(v));
+    };
+    int32_t len = rd32(0);
+    ASSERT_EQ(static_cast<size_t>(len) + 4, frame.size());
+    int32_t name_len = rd32(4);
+    EXPECT_EQ(std::string(frame.data() + 8), "hz_mq.basicConsumeResponse");
+
+    const char* data = frame.data() + 4;
+    EXPECT_EQ(rd32(frame.size() - 4),
+              static_cast<int32_t>(adler32(1, reinterpret_cast<const Bytef*>(data), len - 4)));
+
+    basicConsumeResponse parsed;
+    ASSERT_TRUE(parsed.ParseFromArray(data + 4 + name_len, len - 8 - name_len));
+    EXPECT_EQ(parsed.cid(), "c1");
+    EXPECT_EQ(parsed.properties().delivery_tag(), 42u);
+    EXPECT_EQ(parsed.body(), body);
+}
+
+/* ---------- 数值消息 id：唯一、单调、带节点号 ---------- */
+TEST(Snowflake, UniqueMonotonicAndEncodesNode)
+{
+    snowflake gen(7);
+    std::vector<uint64_t> ids(20000);              // 超过单毫秒序号容量，覆盖借用下一毫秒
+    for (auto& id : ids) id = gen.next();
+    for (size_t i = 1; i < ids.size(); ++i) ASSERT_LT(ids[i - 1], ids[i]);
+    EXPECT_EQ(snowflake::node_of(ids.front()), 7u);
+    EXPECT_GE(snowflake::timestamp_of(ids.front()), SNOWFLAKE_EPOCH_MS);
+
+    // 多线程并发分配不重复
+    std::vector<std::vector<uint64_t>> per(4);
+    std::vector<std::thread> ths;
+    for (auto& v : per) ths.emplace_back([&gen, &v] { for (int i = 0; i < 5000; ++i) v.push_back(gen.next()); });
+    for (auto& t : ths) t.join();
+    std::unordered_set<uint64_t> seen;
+    for (auto& v : per) for (uint64_t id : v) EXPECT_TRUE(seen.insert(id).second);
+}
+
+/* ---------- 客户端字符串 id 与数值 id 均可确认 ---------- */
+TEST(QueueMessage, AckByNumericOrClientId)
+{
+    std::filesystem::remove_all("./numeric_id_q");
+    queue_message qm("./numeric_id_q", "q");
+    BasicProperties a;  a.set_id("client-a");
+    BasicProperties b;
+    ASSERT_TRUE(qm.insert(&a, "A", false));
+    ASSERT_TRUE(qm.insert(&b, "B", false));
+
+    auto ma = qm.take();
+    auto mb = qm.take();
+    ASSERT_NE(ma, nullptr);
+    ASSERT_NE(mb, nullptr);
+    EXPECT_NE(ma->payload().properties().numeric_id(), 0u);
+    EXPECT_EQ(qm.lookup_id("client-a"), ma->payload().properties().numeric_id());
+    EXPECT_EQ(qm.lookup_id(std::to_string(mb->payload().properties().numeric_id())),
+              mb->payload().properties().numeric_id());
+
+    EXPECT_TRUE(qm.ack("client-a"));
+    EXPECT_TRUE(qm.ack(mb->payload().properties().numeric_id()));
+    EXPECT_EQ(qm.unacked_count(), 0u);
+    std::filesystem::remove_all("./numeric_id_q");
+}
+
+/* ---------- slab 池：跨线程释放批量归还所属线程 ---------- */
+TEST(SlabPool, RemoteFreesReturnToOwner)
+{
+    std::vector<void*> blocks(2000);
+    for (auto& p : blocks) p = slab::allocate(64);
+    size_t slabs = slab::slab_count();
+
+    // 另一线程释放；线程退出时冲刷未满一批的剩余块
+    std::thread([&blocks] { for (void* p : blocks) slab::deallocate(p, 64); }).join();
+
+    for (auto& p : blocks) p = slab::allocate(64);   // 从远端链收回，不再切新 slab
+    EXPECT_EQ(slab::slab_count(), slabs);
+    for (void* p : blocks) slab::deallocate(p, 64);
+
+    auto m = new_message(message_alloc::slab);
+    m->mutable_payload()->set_body("x");
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(m.get()) % alignof(Message), 0u);
+    EXPECT_EQ(new_message(message_alloc::slab, *m)->payload().body(), "x");
+}
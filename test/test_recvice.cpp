@@ -4,6 +4,11 @@
 #include <gtest/gtest.h>
 #include "../server/virtual_host.hpp"
 #include "../server/consumer.hpp"
+#include "../server/dispatcher.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
 
 using namespace hz_mq;
 
@@ -22,7 +27,7 @@ static void push_once(const virtual_host::ptr& host,
                  mp->mutable_payload()->mutable_properties(),
                  mp->payload().body());
     if (cp->auto_ack)
-        host->basic_ack(qname, mp->payload().properties().id());
+        host->basic_ack(qname, mp->payload().properties().numeric_id());
 }
 
 /* ======================== 公用夹具 ======================== */
@@ -56,7 +61,7 @@ TEST_F(ReceiveFixture, PullSingleMessage)          /* 有消息 */
     ASSERT_NE(msg, nullptr);
     EXPECT_EQ(msg->payload().body(), "one");
 
-    host->basic_ack("q1", msg->payload().properties().id());
+    host->basic_ack("q1", msg->payload().properties().numeric_id());
     EXPECT_EQ(host->basic_consume("q1"), nullptr);   // 被 ack 删除
 }
 
@@ -132,7 +137,7 @@ TEST_F(ReceiveFixture, PullThenPushSequence)       /* 模式切换序列 */
     pub("first");
     auto m = host->basic_consume("q1");
     ASSERT_NE(m,nullptr);
-    host->basic_ack("q1", m->payload().properties().id());   // pull-ack
+    host->basic_ack("q1", m->payload().properties().numeric_id());   // pull-ack
 
     std::string got;
     cmp->create("t","q1",true,[&](auto,auto,const std::string& b){ got=b; });
@@ -141,3 +146,162 @@ TEST_F(ReceiveFixture, PullThenPushSequence)       /* 模式切换序列 */
 
     EXPECT_EQ(got,"second");
 }
+
+/* ------------------------------------------------------------------
+ *  持续派发（queue_dispatcher）
+ * ----------------------------------------------------------------*/
+static bool wait_until(const std::function<bool()>& pred)
+{
+    for (int i = 0; i < 2000 && !pred(); ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return pred();
+}
+
+TEST_F(ReceiveFixture, DispatcherDrainsBacklog)    /* 订阅前的积压消息也会推送 */
+{
+    for (int i = 0; i < 200; ++i) pub("m" + std::to_string(i));
+
+    std::atomic<int> got{0};
+    std::vector<std::string> order;
+    cmp->create("t","q1",true,[&](auto,auto,const std::string& b){
+        order.push_back(b); ++got; });
+
+    auto pool = std::make_shared<thread_pool>(2);
+    auto disp = std::make_shared<queue_dispatcher>(host, cmp, pool);
+    disp->notify("q1");                                // 模拟订阅触发
+
+    ASSERT_TRUE(wait_until([&]{ return got.load() == 200; }));
+    EXPECT_EQ(order.front(), "m0");
+    EXPECT_EQ(order.back(),  "m199");                  // 单队列串行派发，保持 FIFO
+}
+
+TEST_F(ReceiveFixture, DispatcherStopsAtPrefetch)  /* 额度用尽暂停，ack 后继续 */
+{
+    for (int i = 0; i < 5; ++i) pub("m");
+
+    std::atomic<int> got{0};
+    auto c = std::make_shared<consumer>("t","q1",false,
+        [&](const std::string&,const BasicProperties*,const std::string&){ ++got; });
+    c->window = std::make_shared<prefetch_window>();
+    c->window->limit = 2;
+    ASSERT_NE(cmp->create(c), nullptr);
+
+    auto pool = std::make_shared<thread_pool>(2);
+    auto disp = std::make_shared<queue_dispatcher>(host, cmp, pool);
+    disp->notify("q1");
+    ASSERT_TRUE(wait_until([&]{ return got.load() == 2; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(got.load(), 2);
+
+    c->release_credit();                               // 模拟 ack 归还额度
+    disp->notify("q1");
+    ASSERT_TRUE(wait_until([&]{ return got.load() == 3; }));
+}
+
+TEST_F(ReceiveFixture, DispatcherFlushesOncePerRound) /* 批量投递：一轮派发只成帧一次 */
+{
+    for (int i = 0; i < 10; ++i) pub("m");
+
+    std::atomic<int> delivered{0}, flushes{0};
+    auto c = std::make_shared<consumer>("t","q1",true, consumer_callback{});
+    c->deliver = [&](const consumer::ptr&, const message_ptr&){ ++delivered; };
+    c->flush   = [&](const consumer::ptr&){ ++flushes; };
+    ASSERT_NE(cmp->create(c), nullptr);
+
+    auto pool = std::make_shared<thread_pool>(1);
+    auto disp = std::make_shared<queue_dispatcher>(host, cmp, pool);
+    disp->notify("q1");
+    ASSERT_TRUE(wait_until([&]{ return flushes.load() >= 1; }));
+    EXPECT_EQ(delivered.load(), 10);
+    EXPECT_EQ(flushes.load(), 1);
+}
+
+/* ------------------------------------------------------------------
+ *  basic.get 批量拉取 / 长轮询
+ * ----------------------------------------------------------------*/
+TEST_F(ReceiveFixture, BatchGetReturnsUpToMax)
+{
+    for (int i = 0; i < 5; ++i) pub("g" + std::to_string(i));
+    auto got = host->basic_get("q1", 3, true);
+    ASSERT_EQ(got.size(), 3u);
+    EXPECT_EQ(got[0]->payload().body(), "g0");
+    EXPECT_EQ(got[2]->payload().body(), "g2");
+    EXPECT_EQ(host->basic_get("q1", 10, true).size(), 2u);
+    EXPECT_TRUE(host->basic_get("q1", 10, true).empty());
+    EXPECT_TRUE(host->basic_get("missing", 1, true).empty());
+}
+
+TEST_F(ReceiveFixture, ParkedGetCompletedOnPublish)   /* 等待者先于推送消费者得到消息 */
+{
+    std::atomic<int> pushed{0};
+    cmp->create("t","q1",true,[&](auto,auto,auto){ ++pushed; });
+
+    auto qc = cmp->select("q1");
+    auto w  = std::make_shared<pull_waiter>();
+    w->max_count = 2;
+    w->auto_ack  = true;
+    std::vector<std::string> bodies;
+    std::atomic<bool> completed{false};
+    w->complete = [&](std::vector<message_ptr>&& got) {
+        for (auto& m : got) bodies.push_back(m->payload().body());
+        completed = true;
+    };
+    qc->add_waiter(w);
+
+    auto pool = std::make_shared<thread_pool>(2);
+    auto disp = std::make_shared<queue_dispatcher>(host, cmp, pool);
+    disp->notify("q1");                                // 空队列：继续挂起
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_FALSE(completed.load());
+
+    pub("a"); pub("b"); pub("c");
+    disp->notify("q1");
+    ASSERT_TRUE(wait_until([&]{ return completed.load() && pushed.load() == 1; }));
+    EXPECT_EQ(bodies, (std::vector<std::string>{"a", "b"}));
+    EXPECT_EQ(qc->front_waiter(), nullptr);
+}
+
+TEST_F(ReceiveFixture, TimedOutWaiterIsSkipped)
+{
+    auto qc = cmp->select("q1");
+    auto stale = std::make_shared<pull_waiter>();
+    int stale_calls = 0;
+    stale->complete = [&](std::vector<message_ptr>&&) { ++stale_calls; };
+    qc->add_waiter(stale);
+    ASSERT_TRUE(stale->try_finish());                  // 模拟超时
+    EXPECT_FALSE(stale->try_finish());                 // 只能完成一次
+
+    auto live = std::make_shared<pull_waiter>();
+    live->auto_ack = true;
+    std::atomic<int> live_got{0};
+    live->complete = [&](std::vector<message_ptr>&& got) { live_got = static_cast<int>(got.size()); };
+    qc->add_waiter(live);
+
+    pub("x");
+    auto pool = std::make_shared<thread_pool>(1);
+    auto disp = std::make_shared<queue_dispatcher>(host, cmp, pool);
+    disp->notify("q1");
+    ASSERT_TRUE(wait_until([&]{ return live_got.load() == 1; }));
+    EXPECT_EQ(stale_calls, 0);
+}
+
+TEST_F(ReceiveFixture, DispatcherStopsWhenCreditRunsOut)
+{
+    for (int i = 0; i < 10; ++i) pub("c" + std::to_string(i));
+
+    std::atomic<int> got{0};
+    auto cp = cmp->create("t","q1",true,[&](auto,auto,auto){ ++got; });
+    cp->credit = std::make_shared<flow_credit>();
+    cp->credit->grant(3, 0);
+
+    auto pool = std::make_shared<thread_pool>(2);
+    auto disp = std::make_shared<queue_dispatcher>(host, cmp, pool);
+    disp->notify("q1");
+    ASSERT_TRUE(wait_until([&]{ return got.load() == 3; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(got.load(), 3);                          // 额度耗尽，其余留在队列
+
+    cp->credit->grant(7, 0);                           // basic.credit 后重新 notify
+    disp->notify("q1");
+    ASSERT_TRUE(wait_until([&]{ return got.load() == 10; }));
+}
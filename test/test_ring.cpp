@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+#include "../src/common/mpsc_ring.hpp"
+#include "../src/server/queue_message.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace hz_mq;
+
+/* ---------- 满时 try_push 失败，drain 按入队顺序取出 ---------- */
+TEST(MpscRing, FullThenDrainInOrder)
+{
+    mpsc_ring<int> ring(3);                         // 向上取整到 4
+    ASSERT_EQ(ring.capacity(), 4u);
+    for (int i = 0; i < 4; ++i) EXPECT_TRUE(ring.try_push(int(i)));
+    EXPECT_FALSE(ring.try_push(4));
+
+    std::vector<int> got;
+    EXPECT_EQ(ring.drain([&](int&& v) { got.push_back(v); }, 2), 2u);
+    EXPECT_TRUE(ring.try_push(4));                  // 腾出的槽位可以复用
+    ring.drain([&](int&& v) { got.push_back(v); });
+    EXPECT_EQ(got, (std::vector<int>{0, 1, 2, 3, 4}));
+    EXPECT_TRUE(ring.empty());
+}
+
+/* ---------- 多生产者并发写入：不丢、不重，单个生产者内保持顺序 ---------- */
+TEST(MpscRing, ConcurrentProducersKeepPerProducerOrder)
+{
+    constexpr int T = 4, N = 20000;
+    mpsc_ring<long> ring(256);
+    std::vector<std::thread> producers;
+    for (int t = 0; t < T; ++t) {
+        producers.emplace_back([&, t] {
+            for (int i = 0; i < N; ++i) {
+                while (!ring.try_push(long(t) * N + i)) std::this_thread::yield();
+            }
+        });
+    }
+
+    std::vector<int> next(T, 0);
+    int total = 0;
+    bool ordered = true;
+    while (total < T * N) {
+        ring.drain([&](long&& v) {
+            int t = static_cast<int>(v / N);
+            if (v % N != next[t]) ordered = false;
+            next[t] = static_cast<int>(v % N) + 1;
+            ++total;
+        });
+    }
+    for (auto& p : producers) p.join();
+    EXPECT_TRUE(ordered);
+    EXPECT_EQ(total, T * N);
+    EXPECT_TRUE(ring.empty());
+}
+
+/* ---------- E2b queue_message ★ 多线程并发 insert 不丢消息 ---------- */
+TEST(QueueMessage, ConcurrentInsert)
+{
+    queue_message qm(".", "cq");
+    constexpr int T = 8, N = 2000;
+    std::vector<std::thread> ths;
+    for(int t=0;t<T;++t)
+        ths.emplace_back([&,t]{
+            for(int i=0;i<N;++i){
+                BasicProperties bp; bp.set_id(std::to_string(t*N+i));
+                qm.insert(&bp, "x", false);
+            }
+        });
+    for(auto& th:ths) th.join();
+    EXPECT_EQ(qm.getable_count(), static_cast<size_t>(T*N));   // 超过入口环容量也不丢
+}
@@ -0,0 +1,301 @@
+#include <gtest/gtest.h>
+#include "../src/common/shm_ring.hpp"
+#include "../src/common/fast_frame.hpp"
+#include "../src/server/shm_endpoint.hpp"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace hz_mq;
+
+namespace {
+
+// 进程内的一个方向：控制字 + 数据区，不经 memfd；写端与读端各一个对象
+struct local_ring {
+    explicit local_ring(size_t cap)
+        : data(cap), writer(&ctl, data.data(), cap), ring(&ctl, data.data(), cap) {}
+    shm_ring_ctl      ctl{};
+    std::vector<char> data;
+    shm_ring          writer;
+    shm_ring          ring;     // 读端
+};
+
+std::vector<std::string> drain_all(shm_ring& ring)
+{
+    std::vector<std::string> out;
+    ring.drain([&](const char* p, size_t n) { out.emplace_back(p, n); });
+    return out;
+}
+
+} // namespace
+
+TEST(ShmRing, PushDrainWrapsAndRejectsWhenFull) {
+    local_ring r(256);
+    EXPECT_TRUE(r.ring.empty());
+    EXPECT_FALSE(r.writer.push(std::string(r.writer.max_record() + 1, 'x')));
+
+    // 每条 4 + 52 = 56 字节：四条占 224，第五条放不下
+    std::string rec(52, 'a');
+    for (int i = 0; i < 4; ++i) {
+        rec[0] = static_cast<char>('0' + i);
+        EXPECT_TRUE(r.writer.push(rec.substr(0, 20), rec.substr(20)));
+    }
+    EXPECT_FALSE(r.writer.push(rec));
+    auto got = drain_all(r.ring);
+    ASSERT_EQ(got.size(), 4u);
+    EXPECT_EQ(got[3][0], '3');
+    EXPECT_EQ(got[3].size(), 52u);
+    EXPECT_TRUE(r.ring.empty());
+
+    // 环尾只剩 32 字节：下一条写 wrap 标记回到开头
+    EXPECT_TRUE(r.writer.push(std::string(52, 'w')));
+    got = drain_all(r.ring);
+    ASSERT_EQ(got.size(), 1u);
+    EXPECT_EQ(got[0], std::string(52, 'w'));
+    EXPECT_EQ(r.ctl.head.load() % 256, 56u);
+    EXPECT_FALSE(r.ring.broken());
+}
+
+TEST(ShmRing, CorruptLengthStopsReader) {
+    local_ring r(256);
+    ASSERT_TRUE(r.writer.push("hello"));
+    uint32_t bogus = 10000;
+    std::memcpy(r.data.data(), &bogus, sizeof(bogus));   // 对端写坏了长度字段
+    EXPECT_TRUE(drain_all(r.ring).empty());
+    EXPECT_TRUE(r.ring.broken());
+
+    local_ring r2(256);
+    r2.ctl.tail.store(4096);                              // 索引越过容量
+    EXPECT_TRUE(drain_all(r2.ring).empty());
+    EXPECT_TRUE(r2.ring.broken());
+}
+
+TEST(ShmRing, UnalignedPeerIndicesNeverEscapeTheRing) {
+    // 写端：对端把 head 改成未对齐的值，写端不信任它，也不会据此写出数据区
+    local_ring w(256);
+    ASSERT_TRUE(w.writer.push(std::string(52, 'a')));
+    w.ctl.head.store(3);
+    EXPECT_FALSE(w.writer.push("x"));
+    EXPECT_TRUE(w.writer.broken());
+
+    // 写端：对端把自己发布的 tail 改掉，写端仍按本地位置继续
+    local_ring w2(256);
+    ASSERT_TRUE(w2.writer.push("one"));
+    w2.ctl.tail.store(253);
+    ASSERT_TRUE(w2.writer.push("two"));
+    EXPECT_EQ(w2.ctl.tail.load(), 16u);
+    EXPECT_FALSE(w2.writer.broken());
+
+    // 读端：未对齐的 tail
+    local_ring r(256);
+    ASSERT_TRUE(r.writer.push("hello"));
+    r.ctl.tail.store(13);
+    EXPECT_TRUE(drain_all(r.ring).empty());
+    EXPECT_TRUE(r.ring.broken());
+
+    // 读端：对端把 head 改成未对齐的值，读端按本地位置读
+    local_ring r2(256);
+    ASSERT_TRUE(r2.writer.push("hello"));
+    r2.ctl.head.store(251);
+    auto got = drain_all(r2.ring);
+    ASSERT_EQ(got.size(), 1u);
+    EXPECT_EQ(got[0], "hello");
+    EXPECT_EQ(r2.ctl.head.load(), 16u);
+
+    // 读端：对端 tail 回退
+    ASSERT_TRUE(r2.writer.push("again"));
+    ASSERT_EQ(drain_all(r2.ring).size(), 1u);
+    r2.ctl.tail.store(8);
+    EXPECT_TRUE(drain_all(r2.ring).empty());
+    EXPECT_TRUE(r2.ring.broken());
+}
+
+TEST(ShmRing, DoorbellOnlyWhileReaderIdle) {
+    local_ring r(256);
+    EXPECT_FALSE(r.writer.reader_sleeping());     // 读端在忙：写端不用敲门铃
+
+    EXPECT_TRUE(r.ring.prepare_sleep());
+    EXPECT_TRUE(r.writer.reader_sleeping());
+    r.ring.wake_up();
+    EXPECT_FALSE(r.writer.reader_sleeping());
+
+    // 置空闲标记前已有数据：撤销标记，读端继续读
+    ASSERT_TRUE(r.writer.push("x"));
+    EXPECT_FALSE(r.ring.prepare_sleep());
+    EXPECT_FALSE(r.writer.reader_sleeping());
+}
+
+TEST(ShmRegion, HandoffSharesRingsAndDoorbells) {
+    auto server = shm_region::create(100 * 1000);
+    ASSERT_NE(server, nullptr);
+    EXPECT_EQ(server->ring_bytes() % 4096, 0u);
+    EXPECT_FALSE(server->peer_attached());
+
+    std::string name, token;
+    ASSERT_TRUE(shm_offer(*server, &name, &token));
+    int fds[3] = {-1, -1, -1};
+    EXPECT_FALSE(shm_collect(name + "x", token, fds));    // 名字不对连不上
+    ASSERT_TRUE(shm_collect(name, token, fds));
+    auto client = shm_region::attach(fds[0], fds[1], fds[2]);
+    ASSERT_NE(client, nullptr);
+    EXPECT_TRUE(server->peer_attached());
+    EXPECT_EQ(client->ring_bytes(), server->ring_bytes());
+
+    // 客户端写 PUBLISH 帧，broker 从同一块内存读出
+    fast_frame pub;
+    pub.opcode  = fast_op::PUBLISH;
+    pub.channel = 7;
+    pub.name    = "ex";
+    pub.key     = "rk";
+    pub.body    = "payload";
+    std::string frame;
+    encode_fast_frame(pub, frame);
+
+    shm_ring out = client->ring(SHM_C2S);
+    shm_ring in  = server->ring(SHM_C2S);
+    ASSERT_TRUE(in.prepare_sleep());
+    ASSERT_TRUE(out.push(frame));
+    ASSERT_TRUE(out.reader_sleeping());
+    shm_region::notify(client->event_fd(SHM_C2S));
+
+    uint64_t bell = 0;
+    ASSERT_EQ(::read(server->event_fd(SHM_C2S), &bell, sizeof(bell)), static_cast<ssize_t>(sizeof(bell)));
+    EXPECT_EQ(bell, 1u);
+    in.wake_up();
+
+    int seen = 0;
+    in.drain([&](const char* p, size_t n) {
+        fast_frame f;
+        ASSERT_EQ(decode_fast_frame(p, n, &f), static_cast<long>(n));
+        EXPECT_EQ(f.opcode, fast_op::PUBLISH);
+        EXPECT_EQ(f.channel, 7u);
+        EXPECT_EQ(f.body, "payload");
+        ++seen;
+    });
+    EXPECT_EQ(seen, 1);
+    EXPECT_TRUE(in.empty());
+}
+
+// broker 侧端点跑在真实的 EventLoop 上，客户端一侧直接操作共享区
+class ShmEndpointFixture : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        loop = loop_thread.startLoop();
+        ep = shm_endpoint::create(
+            loop, SHM_MIN_RING,
+            [this](const fast_frame& f) {
+                std::lock_guard<std::mutex> lk(mtx);
+                tags.push_back(f.tag);
+                if (pause_after && tags.size() == pause_after) ep->pause();
+            },
+            [this] { errors++; });
+        ASSERT_NE(ep, nullptr);
+    }
+
+    void TearDown() override
+    {
+        ep->close();
+        wait_for([] { return true; }, 50);   // 让 loop 处理完 close
+    }
+
+    void attach_client()
+    {
+        std::string name, token;
+        ASSERT_TRUE(shm_offer(ep->region(), &name, &token));
+        int fds[3] = {-1, -1, -1};
+        ASSERT_TRUE(shm_collect(name, token, fds));
+        client = shm_region::attach(fds[0], fds[1], fds[2]);
+        ASSERT_NE(client, nullptr);
+    }
+
+    static std::string ack_frame(uint64_t tag)
+    {
+        fast_frame f;
+        f.opcode  = fast_op::ACK;
+        f.channel = 1;
+        f.tag     = tag;
+        std::string out;
+        encode_fast_frame(f, out);
+        return out;
+    }
+
+    size_t seen()
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        return tags.size();
+    }
+
+    // 等 pred 成立或超时；返回 pred 的最终结果
+    template <class P>
+    static bool wait_for(P pred, int ms = 2000)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+        while (!pred()) {
+            if (std::chrono::steady_clock::now() > deadline) return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    muduo::net::EventLoopThread loop_thread;
+    muduo::net::EventLoop*      loop{nullptr};
+    shm_endpoint::ptr           ep;
+    shm_region::ptr             client;
+    std::mutex                  mtx;
+    std::vector<uint64_t>       tags;
+    size_t                      pause_after{0};
+    std::atomic<int>            errors{0};
+};
+
+TEST_F(ShmEndpointFixture, PauseInsideFrameCallbackLeavesRestInRing) {
+    attach_client();
+    shm_ring out = client->ring(SHM_C2S);
+    for (uint64_t t = 1; t <= 3; ++t) ASSERT_TRUE(out.push(ack_frame(t)));
+
+    // 第一帧触发背压：同一次读取里不再处理后面的帧
+    pause_after = 1;
+    ep->start();
+    ASSERT_TRUE(wait_for([this] { return seen() == 1; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(seen(), 1u);
+
+    pause_after = 0;
+    ep->resume();
+    ASSERT_TRUE(wait_for([this] { return seen() == 3; }));
+    std::lock_guard<std::mutex> lk(mtx);
+    EXPECT_EQ(tags, (std::vector<uint64_t>{1, 2, 3}));
+    EXPECT_EQ(errors.load(), 0);
+}
+
+TEST_F(ShmEndpointFixture, MalformedFrameShutsTransportDown) {
+    attach_client();
+    shm_ring out = client->ring(SHM_C2S);
+    ASSERT_TRUE(out.push(ack_frame(1)));
+    ASSERT_TRUE(out.push("definitely not a frame"));
+    ASSERT_TRUE(out.push(ack_frame(2)));
+
+    ep->start();
+    ASSERT_TRUE(wait_for([this] { return errors.load() == 1; }));
+    EXPECT_EQ(seen(), 1u);                    // 坏帧之后的帧不再处理
+    EXPECT_FALSE(ep->send("head", "body"));   // 关闭后不再写 S2C 环
+}
+
+TEST_F(ShmEndpointFixture, SendWaitsUntilPeerAttached) {
+    ep->start();
+    EXPECT_FALSE(ep->send("head", "body"));   // 客户端还没取走 fd：调用方改走 TCP
+
+    attach_client();
+    ASSERT_TRUE(ep->send("head", "body"));
+    shm_ring in = client->ring(SHM_S2C);
+    auto got = drain_all(in);
+    ASSERT_EQ(got.size(), 1u);
+    EXPECT_EQ(got[0], "headbody");
+}
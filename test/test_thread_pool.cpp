@@ -0,0 +1,216 @@
+#include <gtest/gtest.h>
+#include "../src/common/thread_pool.hpp"
+#include "../src/common/thread_affinity.hpp"
+#include "../src/server/loop_task.hpp"     // strand 积压计入线程池水位
+
+#include <sched.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace hz_mq;
+
+/* ---------- E6 thread_pool ★ push / 并发执行 ---------- */
+TEST(ThreadPool, PushAndRun)
+{
+    thread_pool pool(4);
+    std::atomic<int> sum{0};
+    for(int i=0;i<100;i++)
+        pool.push([&]{ sum.fetch_add(1,std::memory_order_relaxed); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(sum.load(), 100);
+}
+
+/* ---------- C4 thread_pool 析构路径 ---------------- */
+TEST(ThreadPool, GracefulDestruct)
+{
+    std::atomic<int> counter{0};
+    {
+        thread_pool pool(2);
+        for(int i=0;i<20;i++)
+            pool.push([&]{ counter.fetch_add(1,std::memory_order_relaxed); });
+    }   // 作用域结束触发析构，必须把 20 个任务都跑完
+    EXPECT_EQ(counter.load(), 20);
+}
+
+/* ---------- C5 thread_pool 高 / 低水位回调 ---------- */
+TEST(ThreadPool, WatermarkCallbacks)
+{
+    thread_pool pool(1);
+    std::atomic<int> high{0}, low{0};
+    pool.set_watermark(4, 1, [&]{ high++; }, [&]{ low++; });
+
+    std::mutex gate;
+    gate.lock();                                   // 堵住唯一的 worker
+    pool.push([&]{ std::lock_guard<std::mutex> g(gate); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    for(int i=0;i<6;i++) pool.push([]{});
+    EXPECT_EQ(high.load(), 1);                     // 越过高水位只触发一次
+    EXPECT_TRUE(pool.overloaded());
+
+    gate.unlock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(low.load(), 1);
+    EXPECT_FALSE(pool.overloaded());
+    EXPECT_EQ(pool.pending(), 0u);
+}
+
+/* ---------- C6 thread_pool 有界提交：满时阻塞提交方 ---------- */
+TEST(ThreadPool, BoundedPushBlocks)
+{
+    thread_pool pool(1, 2);
+    std::mutex gate;
+    gate.lock();
+    pool.push([&]{ std::lock_guard<std::mutex> g(gate); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    pool.push([]{});
+    pool.push([]{});                               // 队列已满 (2)
+
+    std::atomic<bool> pushed{false};
+    std::thread producer([&]{ pool.push([]{}); pushed = true; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(pushed.load());                   // 被阻塞
+    EXPECT_LE(pool.pending(), 2u);
+
+    gate.unlock();
+    producer.join();
+    EXPECT_TRUE(pushed.load());
+}
+
+TEST(ThreadPool, TryPushAndLoopThreadNeverBlock)
+{
+    thread_pool pool(1, 2);
+    std::mutex gate;
+    gate.lock();
+    pool.push([&]{ std::lock_guard<std::mutex> g(gate); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_TRUE(pool.try_push([]{}));
+    EXPECT_TRUE(pool.try_push([]{}));
+    EXPECT_FALSE(pool.try_push([]{}));             // 满了立即失败
+
+    // EventLoop 线程上的 push 不等空位，超出容量照常入队
+    std::atomic<bool> pushed{false};
+    std::thread loop([&]{
+        thread_pool::mark_event_loop_thread();
+        pool.push([]{});
+        pushed = true;
+    });
+    loop.join();
+    EXPECT_TRUE(pushed.load());
+    EXPECT_EQ(pool.pending(), 3u);
+    gate.unlock();
+}
+
+TEST(ThreadPool, WatermarkCallbacksAlternateUnderRace)
+{
+    thread_pool pool(4);
+    std::mutex mtx;
+    std::vector<int> events;                       // 1 = high, 0 = low
+    pool.set_watermark(2, 1,
+        [&]{ std::lock_guard<std::mutex> g(mtx); events.push_back(1); },
+        [&]{ std::lock_guard<std::mutex> g(mtx); events.push_back(0); });
+
+    std::vector<std::thread> producers;
+    for (int t = 0; t < 4; ++t) {
+        producers.emplace_back([&]{
+            for (int i = 0; i < 5000; ++i) pool.push([]{});
+        });
+    }
+    for (auto& p : producers) p.join();
+    while (pool.pending() != 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    std::lock_guard<std::mutex> g(mtx);
+    ASSERT_FALSE(events.empty());
+    for (size_t i = 0; i < events.size(); ++i)
+        EXPECT_EQ(events[i], i % 2 == 0 ? 1 : 0) << "at " << i;
+    EXPECT_EQ(events.back(), 0);                   // 排空后一定停在“已恢复”
+}
+
+TEST(ThreadPool, StrandBacklogCountsAgainstWatermark)
+{
+    auto pool = std::make_shared<thread_pool>(1);
+    std::atomic<int> highs{0}, lows{0};
+    pool->set_watermark(4, 1, [&]{ ++highs; }, [&]{ ++lows; });
+
+    auto s = std::make_shared<coro::strand>(pool);
+    std::mutex gate;
+    gate.lock();
+    s->post([&]{ std::lock_guard<std::mutex> g(gate); });
+    for (int i = 0; i < 5; ++i) s->post([]{});
+    EXPECT_EQ(highs.load(), 1);                    // strand 积压照样触发背压
+    EXPECT_TRUE(pool->overloaded());
+
+    gate.unlock();
+    while (!s->idle()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    EXPECT_EQ(lows.load(), 1);
+    EXPECT_FALSE(pool->overloaded());
+}
+
+/* ---------- C7 绑核配置解析 ---------- */
+TEST(ThreadAffinity, ParseCpuList)
+{
+    using affinity::parse_cpu_list;
+    EXPECT_EQ(parse_cpu_list("0-3,8"), (std::vector<int>{0,1,2,3,8}));
+    EXPECT_EQ(parse_cpu_list("5"),     (std::vector<int>{5}));
+    EXPECT_TRUE(parse_cpu_list("").empty());
+    EXPECT_EQ(parse_cpu_list("x,2"),   (std::vector<int>{2}));    // 非法片段忽略
+    EXPECT_EQ(parse_cpu_list("a-3,4"), (std::vector<int>{4}));    // 区间两端同样校验
+    EXPECT_TRUE(parse_cpu_list("1-x").empty());
+    EXPECT_TRUE(parse_cpu_list("-3").empty());
+    auto clamped = parse_cpu_list("0-2000000000");                 // 上界截断到 CPU_SETSIZE
+    ASSERT_EQ(clamped.size(), static_cast<size_t>(CPU_SETSIZE));
+    EXPECT_EQ(clamped.back(), CPU_SETSIZE - 1);
+    EXPECT_FALSE(affinity::pin_current_thread(-1));
+}
+
+/* ---------- C8 thread_pool 唤醒合并 & 计数 ---------- */
+TEST(ThreadPool, WakeupCoalescingStats)
+{
+    thread_pool pool(2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));   // 让 worker 自旋落空后 park
+    auto before = pool.get_stats();
+    EXPECT_GE(before.parks, 2u);
+
+    std::atomic<int> done{0};
+    constexpr int N = 1000;
+    for(int i=0;i<N;i++) pool.push([&]{ done++; });
+    while(done.load() < N) std::this_thread::yield();
+
+    auto after = pool.get_stats();
+    // 一串 push 对每个睡眠 worker 至多唤醒一次，远少于任务数
+    EXPECT_LT(after.wakeups - before.wakeups, static_cast<uint64_t>(N));
+    EXPECT_EQ(pool.pending(), 0u);
+}
+
+/* ---------- C9 thread_pool 自旋 worker 抢走任务后，被通知的 worker 不会把通知额度占着不放 ---------- */
+TEST(ThreadPool, PushAfterIdleAndAfterSpinSteal)
+{
+    thread_pool pool(2);
+    for (int round = 0; round < 20; ++round) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));   // 两个 worker 都 park
+
+        // 池内提交：通知另一个 worker，但刚跑完 A 的 worker 在自旋中多半先抢到 B
+        std::atomic<bool> b_done{false};
+        pool.push([&] { pool.push([&] { b_done = true; }); });
+        while (!b_done.load()) std::this_thread::yield();
+
+        // C 占住一个 worker 等 D：D 必须由另一个（正在睡眠的）worker 执行
+        std::atomic<bool> d_done{false};
+        std::atomic<bool> c_saw_d{false};
+        std::atomic<bool> c_done{false};
+        pool.push([&] {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+            while (!d_done.load() && std::chrono::steady_clock::now() < deadline) std::this_thread::yield();
+            c_saw_d = d_done.load();
+            c_done = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));   // 另一个 worker 自旋落空后 park
+        pool.push([&] { d_done = true; });
+        while (!c_done.load()) std::this_thread::yield();
+        ASSERT_TRUE(c_saw_d.load()) << "round " << round;
+    }
+}